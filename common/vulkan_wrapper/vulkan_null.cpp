@@ -0,0 +1,965 @@
+// In-process null Vulkan driver, see vulkan_null.h.
+//
+// Every handle is a heap object cast to the handle type, so the usual
+// create/destroy pairing (and leaks) behave as with a real driver. Nothing is
+// ever executed: submitting signals the fence right away, command buffer
+// recording only bumps the call counters, and timestamps are taken from the
+// host clock when the write is recorded.
+#include "vulkan_null.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// Call counters
+
+struct CallCounter {
+  const char* name;
+  std::atomic<uint64_t> count;
+  explicit CallCounter(const char* n);
+};
+
+std::mutex& CounterMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::vector<CallCounter*>& Counters() {
+  static std::vector<CallCounter*> counters;
+  return counters;
+}
+
+CallCounter::CallCounter(const char* n) : name(n), count(0) {
+  std::lock_guard<std::mutex> lock(CounterMutex());
+  Counters().push_back(this);
+}
+
+// A counter is registered the first time its entry point is called, so the
+// cost per call is one guard check and one relaxed increment.
+#define NULL_CALL(func)                    \
+  static CallCounter callCounter(#func);   \
+  callCounter.count.fetch_add(1, std::memory_order_relaxed)
+
+// ---------------------------------------------------------------------------
+// Fake objects
+
+const uint32_t kVendorId = 0x10005;  // VK_VENDOR_ID_MESA, never a real GPU
+const uint32_t kDeviceId = 0x4e554c4c;  // "NULL"
+const uint32_t kMaxMemoryAllocationCount = 4096;
+const VkDeviceSize kBufferAlignment = 256;
+const VkDeviceSize kImageAlignment = 4096;
+const uint32_t kHostVisibleTypeBit = 1u << 1;
+
+struct NullObject {};
+
+struct NullMemory {
+  VkDeviceSize size;
+  uint32_t memoryTypeIndex;
+  void* data;  // Host RAM for HOST_VISIBLE types, nullptr otherwise.
+};
+
+struct NullBuffer {
+  VkDeviceSize size;
+};
+
+struct NullImage {
+  VkDeviceSize size;
+  bool linear;
+};
+
+struct NullFence {
+  std::atomic<bool> signaled;
+};
+
+struct NullQueryPool {
+  std::vector<uint64_t> values;
+  std::vector<bool> available;
+};
+
+struct NullCommandBuffer {};
+
+struct NullCommandPool {
+  std::unordered_set<NullCommandBuffer*> commandBuffers;
+};
+
+NullObject g_instance;
+NullObject g_physicalDevice;
+NullObject g_device;
+NullObject g_queue;
+std::atomic<uint32_t> g_memoryAllocationCount(0);
+
+template <typename H>
+H ToHandle(void* object) {
+  return (H)(uintptr_t)object;
+}
+
+template <typename T, typename H>
+T* FromHandle(H handle) {
+  return (T*)(uintptr_t)handle;
+}
+
+template <typename H>
+VkResult CreateObject(H* handle) {
+  *handle = ToHandle<H>(new NullObject());
+  return VK_SUCCESS;
+}
+
+template <typename H>
+void DestroyObject(H handle) {
+  delete FromHandle<NullObject>(handle);
+}
+
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+uint64_t HostNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void FillProperties(VkPhysicalDeviceProperties* properties) {
+  memset(properties, 0, sizeof(*properties));
+  properties->apiVersion = VK_MAKE_VERSION(1, 1, 0);
+  properties->driverVersion = VK_MAKE_VERSION(1, 0, 0);
+  properties->vendorID = kVendorId;
+  properties->deviceID = kDeviceId;
+  properties->deviceType = VK_PHYSICAL_DEVICE_TYPE_CPU;
+  strncpy(properties->deviceName, "prf null device",
+          VK_MAX_PHYSICAL_DEVICE_NAME_SIZE - 1);
+  memcpy(properties->pipelineCacheUUID, "prf-null-driver", VK_UUID_SIZE);
+  properties->limits.maxImageDimension2D = 16384;
+  properties->limits.maxPushConstantsSize = 128;
+  properties->limits.maxMemoryAllocationCount = kMaxMemoryAllocationCount;
+  properties->limits.bufferImageGranularity = 1;
+  properties->limits.optimalBufferCopyOffsetAlignment = 1;
+  properties->limits.nonCoherentAtomSize = 1;
+  properties->limits.timestampComputeAndGraphics = VK_TRUE;
+  properties->limits.timestampPeriod = 1.0f;  // Host nanoseconds.
+}
+
+// ---------------------------------------------------------------------------
+// Instance and device
+
+VKAPI_ATTR VkResult VKAPI_CALL NullCreateInstance(
+    const VkInstanceCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkInstance* pInstance) {
+  NULL_CALL(vkCreateInstance);
+  // No window system is emulated, so no extension can be honored.
+  if (pCreateInfo->enabledExtensionCount != 0)
+    return VK_ERROR_EXTENSION_NOT_PRESENT;
+  *pInstance = ToHandle<VkInstance>(&g_instance);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullDestroyInstance(
+    VkInstance instance, const VkAllocationCallbacks* pAllocator) {
+  NULL_CALL(vkDestroyInstance);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullEnumeratePhysicalDevices(
+    VkInstance instance, uint32_t* pPhysicalDeviceCount,
+    VkPhysicalDevice* pPhysicalDevices) {
+  NULL_CALL(vkEnumeratePhysicalDevices);
+  if (pPhysicalDevices == nullptr) {
+    *pPhysicalDeviceCount = 1;
+    return VK_SUCCESS;
+  }
+  if (*pPhysicalDeviceCount == 0) return VK_INCOMPLETE;
+  *pPhysicalDeviceCount = 1;
+  pPhysicalDevices[0] = ToHandle<VkPhysicalDevice>(&g_physicalDevice);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetPhysicalDeviceProperties(
+    VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties* pProperties) {
+  NULL_CALL(vkGetPhysicalDeviceProperties);
+  FillProperties(pProperties);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetPhysicalDeviceFormatProperties(
+    VkPhysicalDevice physicalDevice, VkFormat format,
+    VkFormatProperties* pFormatProperties) {
+  NULL_CALL(vkGetPhysicalDeviceFormatProperties);
+  // Claim everything; nothing is ever sampled anyway.
+  memset(pFormatProperties, 0xff, sizeof(*pFormatProperties));
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetPhysicalDeviceQueueFamilyProperties(
+    VkPhysicalDevice physicalDevice, uint32_t* pQueueFamilyPropertyCount,
+    VkQueueFamilyProperties* pQueueFamilyProperties) {
+  NULL_CALL(vkGetPhysicalDeviceQueueFamilyProperties);
+  if (pQueueFamilyProperties == nullptr) {
+    *pQueueFamilyPropertyCount = 1;
+    return;
+  }
+  if (*pQueueFamilyPropertyCount == 0) return;
+  *pQueueFamilyPropertyCount = 1;
+  memset(pQueueFamilyProperties, 0, sizeof(*pQueueFamilyProperties));
+  pQueueFamilyProperties->queueFlags =
+      VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+  pQueueFamilyProperties->queueCount = 1;
+  pQueueFamilyProperties->timestampValidBits = 64;
+  pQueueFamilyProperties->minImageTransferGranularity.width = 1;
+  pQueueFamilyProperties->minImageTransferGranularity.height = 1;
+  pQueueFamilyProperties->minImageTransferGranularity.depth = 1;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetPhysicalDeviceMemoryProperties(
+    VkPhysicalDevice physicalDevice,
+    VkPhysicalDeviceMemoryProperties* pMemoryProperties) {
+  NULL_CALL(vkGetPhysicalDeviceMemoryProperties);
+  // Type 0 is device local (never backed), type 1 is host visible.
+  memset(pMemoryProperties, 0, sizeof(*pMemoryProperties));
+  pMemoryProperties->memoryTypeCount = 2;
+  pMemoryProperties->memoryTypes[0].propertyFlags =
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  pMemoryProperties->memoryTypes[0].heapIndex = 0;
+  pMemoryProperties->memoryTypes[1].propertyFlags =
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  pMemoryProperties->memoryTypes[1].heapIndex = 1;
+  pMemoryProperties->memoryHeapCount = 2;
+  pMemoryProperties->memoryHeaps[0].size = 1ull << 32;
+  pMemoryProperties->memoryHeaps[0].flags = 1;  // VK_MEMORY_HEAP_DEVICE_LOCAL_BIT
+  pMemoryProperties->memoryHeaps[1].size = 1ull << 32;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullCreateDevice(
+    VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkDevice* pDevice) {
+  NULL_CALL(vkCreateDevice);
+  if (pCreateInfo->enabledExtensionCount != 0)
+    return VK_ERROR_EXTENSION_NOT_PRESENT;
+  *pDevice = ToHandle<VkDevice>(&g_device);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullDestroyDevice(
+    VkDevice device, const VkAllocationCallbacks* pAllocator) {
+  NULL_CALL(vkDestroyDevice);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetDeviceQueue(VkDevice device,
+                                              uint32_t queueFamilyIndex,
+                                              uint32_t queueIndex,
+                                              VkQueue* pQueue) {
+  NULL_CALL(vkGetDeviceQueue);
+  *pQueue = ToHandle<VkQueue>(&g_queue);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullQueueSubmit(VkQueue queue,
+                                               uint32_t submitCount,
+                                               const VkSubmitInfo* pSubmits,
+                                               VkFence fence) {
+  NULL_CALL(vkQueueSubmit);
+  // The work is "complete" as soon as it is submitted.
+  if (fence != VK_NULL_HANDLE)
+    FromHandle<NullFence>(fence)->signaled.store(true,
+                                                 std::memory_order_release);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullQueueWaitIdle(VkQueue queue) {
+  NULL_CALL(vkQueueWaitIdle);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullDeviceWaitIdle(VkDevice device) {
+  NULL_CALL(vkDeviceWaitIdle);
+  return VK_SUCCESS;
+}
+
+// ---------------------------------------------------------------------------
+// Memory
+
+VKAPI_ATTR VkResult VKAPI_CALL NullAllocateMemory(
+    VkDevice device, const VkMemoryAllocateInfo* pAllocateInfo,
+    const VkAllocationCallbacks* pAllocator, VkDeviceMemory* pMemory) {
+  NULL_CALL(vkAllocateMemory);
+  if (g_memoryAllocationCount.fetch_add(1) >= kMaxMemoryAllocationCount) {
+    g_memoryAllocationCount.fetch_sub(1);
+    return VK_ERROR_TOO_MANY_OBJECTS;
+  }
+  NullMemory* memory = new NullMemory();
+  memory->size = pAllocateInfo->allocationSize;
+  memory->memoryTypeIndex = pAllocateInfo->memoryTypeIndex;
+  memory->data = nullptr;
+  if ((1u << memory->memoryTypeIndex) & kHostVisibleTypeBit) {
+    memory->data = malloc(memory->size);
+    if (memory->data == nullptr) {
+      delete memory;
+      g_memoryAllocationCount.fetch_sub(1);
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+  }
+  *pMemory = ToHandle<VkDeviceMemory>(memory);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullFreeMemory(
+    VkDevice device, VkDeviceMemory memory,
+    const VkAllocationCallbacks* pAllocator) {
+  NULL_CALL(vkFreeMemory);
+  if (memory == VK_NULL_HANDLE) return;
+  NullMemory* object = FromHandle<NullMemory>(memory);
+  free(object->data);
+  delete object;
+  g_memoryAllocationCount.fetch_sub(1);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullMapMemory(VkDevice device,
+                                             VkDeviceMemory memory,
+                                             VkDeviceSize offset,
+                                             VkDeviceSize size,
+                                             VkMemoryMapFlags flags,
+                                             void** ppData) {
+  NULL_CALL(vkMapMemory);
+  NullMemory* object = FromHandle<NullMemory>(memory);
+  if (object->data == nullptr) return VK_ERROR_MEMORY_MAP_FAILED;
+  *ppData = static_cast<char*>(object->data) + offset;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullUnmapMemory(VkDevice device,
+                                           VkDeviceMemory memory) {
+  NULL_CALL(vkUnmapMemory);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullFlushMappedMemoryRanges(
+    VkDevice device, uint32_t memoryRangeCount,
+    const VkMappedMemoryRange* pMemoryRanges) {
+  NULL_CALL(vkFlushMappedMemoryRanges);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullInvalidateMappedMemoryRanges(
+    VkDevice device, uint32_t memoryRangeCount,
+    const VkMappedMemoryRange* pMemoryRanges) {
+  NULL_CALL(vkInvalidateMappedMemoryRanges);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullBindBufferMemory(VkDevice device,
+                                                    VkBuffer buffer,
+                                                    VkDeviceMemory memory,
+                                                    VkDeviceSize memoryOffset) {
+  NULL_CALL(vkBindBufferMemory);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullBindImageMemory(VkDevice device,
+                                                   VkImage image,
+                                                   VkDeviceMemory memory,
+                                                   VkDeviceSize memoryOffset) {
+  NULL_CALL(vkBindImageMemory);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetBufferMemoryRequirements(
+    VkDevice device, VkBuffer buffer,
+    VkMemoryRequirements* pMemoryRequirements) {
+  NULL_CALL(vkGetBufferMemoryRequirements);
+  pMemoryRequirements->size =
+      AlignUp(FromHandle<NullBuffer>(buffer)->size, kBufferAlignment);
+  pMemoryRequirements->alignment = kBufferAlignment;
+  pMemoryRequirements->memoryTypeBits = 0x3;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullGetImageMemoryRequirements(
+    VkDevice device, VkImage image,
+    VkMemoryRequirements* pMemoryRequirements) {
+  NULL_CALL(vkGetImageMemoryRequirements);
+  NullImage* object = FromHandle<NullImage>(image);
+  pMemoryRequirements->size = AlignUp(object->size, kImageAlignment);
+  pMemoryRequirements->alignment = kImageAlignment;
+  // Optimal tiling images cannot be host visible, like on most GPUs.
+  pMemoryRequirements->memoryTypeBits = object->linear ? 0x3 : 0x1;
+}
+
+// ---------------------------------------------------------------------------
+// Synchronization
+
+VKAPI_ATTR VkResult VKAPI_CALL NullCreateFence(
+    VkDevice device, const VkFenceCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkFence* pFence) {
+  NULL_CALL(vkCreateFence);
+  NullFence* fence = new NullFence();
+  fence->signaled.store((pCreateInfo->flags & VK_FENCE_CREATE_SIGNALED_BIT) != 0);
+  *pFence = ToHandle<VkFence>(fence);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullDestroyFence(
+    VkDevice device, VkFence fence, const VkAllocationCallbacks* pAllocator) {
+  NULL_CALL(vkDestroyFence);
+  delete FromHandle<NullFence>(fence);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullResetFences(VkDevice device,
+                                               uint32_t fenceCount,
+                                               const VkFence* pFences) {
+  NULL_CALL(vkResetFences);
+  for (uint32_t i = 0; i < fenceCount; i++)
+    FromHandle<NullFence>(pFences[i])->signaled.store(false);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullGetFenceStatus(VkDevice device,
+                                                  VkFence fence) {
+  NULL_CALL(vkGetFenceStatus);
+  return FromHandle<NullFence>(fence)->signaled.load(std::memory_order_acquire)
+             ? VK_SUCCESS
+             : VK_NOT_READY;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullWaitForFences(VkDevice device,
+                                                 uint32_t fenceCount,
+                                                 const VkFence* pFences,
+                                                 VkBool32 waitAll,
+                                                 uint64_t timeout) {
+  NULL_CALL(vkWaitForFences);
+  // Submitted work completes immediately, so an unsignaled fence here was
+  // never submitted and a real driver would block until the timeout.
+  uint32_t signaled = 0;
+  for (uint32_t i = 0; i < fenceCount; i++) {
+    if (FromHandle<NullFence>(pFences[i])->signaled.load(
+            std::memory_order_acquire))
+      signaled++;
+  }
+  if (waitAll ? signaled == fenceCount : signaled != 0) return VK_SUCCESS;
+  return VK_TIMEOUT;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullCreateSemaphore(
+    VkDevice device, const VkSemaphoreCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkSemaphore* pSemaphore) {
+  NULL_CALL(vkCreateSemaphore);
+  return CreateObject(pSemaphore);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullDestroySemaphore(
+    VkDevice device, VkSemaphore semaphore,
+    const VkAllocationCallbacks* pAllocator) {
+  NULL_CALL(vkDestroySemaphore);
+  DestroyObject(semaphore);
+}
+
+// ---------------------------------------------------------------------------
+// Queries
+
+VKAPI_ATTR VkResult VKAPI_CALL NullCreateQueryPool(
+    VkDevice device, const VkQueryPoolCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkQueryPool* pQueryPool) {
+  NULL_CALL(vkCreateQueryPool);
+  NullQueryPool* pool = new NullQueryPool();
+  pool->values.resize(pCreateInfo->queryCount, 0);
+  pool->available.resize(pCreateInfo->queryCount, false);
+  *pQueryPool = ToHandle<VkQueryPool>(pool);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullDestroyQueryPool(
+    VkDevice device, VkQueryPool queryPool,
+    const VkAllocationCallbacks* pAllocator) {
+  NULL_CALL(vkDestroyQueryPool);
+  delete FromHandle<NullQueryPool>(queryPool);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullGetQueryPoolResults(
+    VkDevice device, VkQueryPool queryPool, uint32_t firstQuery,
+    uint32_t queryCount, size_t dataSize, void* pData, VkDeviceSize stride,
+    VkQueryResultFlags flags) {
+  NULL_CALL(vkGetQueryPoolResults);
+  NullQueryPool* pool = FromHandle<NullQueryPool>(queryPool);
+  bool is64 = (flags & VK_QUERY_RESULT_64_BIT) != 0;
+  bool withAvailability = (flags & VK_QUERY_RESULT_WITH_AVAILABILITY_BIT) != 0;
+  VkResult result = VK_SUCCESS;
+  for (uint32_t i = 0; i < queryCount; i++) {
+    uint32_t query = firstQuery + i;
+    char* slot = static_cast<char*>(pData) + i * stride;
+    bool available = pool->available[query];
+    if (!available) result = VK_NOT_READY;
+    uint64_t values[2] = {pool->values[query], available ? 1u : 0u};
+    for (uint32_t j = 0; j < (withAvailability ? 2u : 1u); j++) {
+      if (j == 0 && !available) continue;  // Left untouched, as per spec.
+      if (is64)
+        memcpy(slot + j * 8, &values[j], 8);
+      else {
+        uint32_t value32 = static_cast<uint32_t>(values[j]);
+        memcpy(slot + j * 4, &value32, 4);
+      }
+    }
+  }
+  (void)dataSize;
+  return result;
+}
+
+// ---------------------------------------------------------------------------
+// Resources
+
+VKAPI_ATTR VkResult VKAPI_CALL NullCreateBuffer(
+    VkDevice device, const VkBufferCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkBuffer* pBuffer) {
+  NULL_CALL(vkCreateBuffer);
+  NullBuffer* buffer = new NullBuffer();
+  buffer->size = pCreateInfo->size;
+  *pBuffer = ToHandle<VkBuffer>(buffer);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullDestroyBuffer(
+    VkDevice device, VkBuffer buffer, const VkAllocationCallbacks* pAllocator) {
+  NULL_CALL(vkDestroyBuffer);
+  delete FromHandle<NullBuffer>(buffer);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullCreateImage(
+    VkDevice device, const VkImageCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkImage* pImage) {
+  NULL_CALL(vkCreateImage);
+  NullImage* image = new NullImage();
+  // Assume at most 4 bytes per texel, which covers every format in use.
+  image->size = VkDeviceSize(pCreateInfo->extent.width) *
+                pCreateInfo->extent.height * pCreateInfo->extent.depth *
+                pCreateInfo->arrayLayers * 4;
+  if (pCreateInfo->mipLevels > 1) image->size += image->size / 3;
+  image->linear = pCreateInfo->tiling == VK_IMAGE_TILING_LINEAR;
+  *pImage = ToHandle<VkImage>(image);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullDestroyImage(
+    VkDevice device, VkImage image, const VkAllocationCallbacks* pAllocator) {
+  NULL_CALL(vkDestroyImage);
+  delete FromHandle<NullImage>(image);
+}
+
+// Objects whose only state is their identity.
+#define NULL_OBJECT_ENTRY_POINTS(Type, CreateInfo)                          \
+  VKAPI_ATTR VkResult VKAPI_CALL NullCreate##Type(                          \
+      VkDevice device, const CreateInfo* pCreateInfo,                       \
+      const VkAllocationCallbacks* pAllocator, Vk##Type* pObject) {         \
+    NULL_CALL(vkCreate##Type);                                              \
+    return CreateObject(pObject);                                           \
+  }                                                                         \
+  VKAPI_ATTR void VKAPI_CALL NullDestroy##Type(                             \
+      VkDevice device, Vk##Type object,                                     \
+      const VkAllocationCallbacks* pAllocator) {                            \
+    NULL_CALL(vkDestroy##Type);                                             \
+    if (object != VK_NULL_HANDLE) DestroyObject(object);                    \
+  }
+
+NULL_OBJECT_ENTRY_POINTS(ImageView, VkImageViewCreateInfo)
+NULL_OBJECT_ENTRY_POINTS(Sampler, VkSamplerCreateInfo)
+NULL_OBJECT_ENTRY_POINTS(ShaderModule, VkShaderModuleCreateInfo)
+NULL_OBJECT_ENTRY_POINTS(PipelineLayout, VkPipelineLayoutCreateInfo)
+NULL_OBJECT_ENTRY_POINTS(DescriptorSetLayout, VkDescriptorSetLayoutCreateInfo)
+NULL_OBJECT_ENTRY_POINTS(Framebuffer, VkFramebufferCreateInfo)
+NULL_OBJECT_ENTRY_POINTS(RenderPass, VkRenderPassCreateInfo)
+
+#undef NULL_OBJECT_ENTRY_POINTS
+
+VKAPI_ATTR VkResult VKAPI_CALL NullCreatePipelineCache(
+    VkDevice device, const VkPipelineCacheCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkPipelineCache* pPipelineCache) {
+  NULL_CALL(vkCreatePipelineCache);
+  return CreateObject(pPipelineCache);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullDestroyPipelineCache(
+    VkDevice device, VkPipelineCache pipelineCache,
+    const VkAllocationCallbacks* pAllocator) {
+  NULL_CALL(vkDestroyPipelineCache);
+  if (pipelineCache != VK_NULL_HANDLE) DestroyObject(pipelineCache);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullGetPipelineCacheData(
+    VkDevice device, VkPipelineCache pipelineCache, size_t* pDataSize,
+    void* pData) {
+  NULL_CALL(vkGetPipelineCacheData);
+  // A bare header, so that a cache saved by the null driver is recognized
+  // as compatible when loaded back by it.
+  VkPhysicalDeviceProperties properties;
+  FillProperties(&properties);
+  VkPipelineCacheHeaderVersionOne header;
+  header.headerSize = sizeof(header);
+  header.headerVersion = VK_PIPELINE_CACHE_HEADER_VERSION_ONE;
+  header.vendorID = properties.vendorID;
+  header.deviceID = properties.deviceID;
+  memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+  if (pData == nullptr) {
+    *pDataSize = sizeof(header);
+    return VK_SUCCESS;
+  }
+  if (*pDataSize < sizeof(header)) {
+    *pDataSize = 0;
+    return VK_INCOMPLETE;
+  }
+  memcpy(pData, &header, sizeof(header));
+  *pDataSize = sizeof(header);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullCreateGraphicsPipelines(
+    VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount,
+    const VkGraphicsPipelineCreateInfo* pCreateInfos,
+    const VkAllocationCallbacks* pAllocator, VkPipeline* pPipelines) {
+  NULL_CALL(vkCreateGraphicsPipelines);
+  for (uint32_t i = 0; i < createInfoCount; i++) CreateObject(&pPipelines[i]);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullDestroyPipeline(
+    VkDevice device, VkPipeline pipeline,
+    const VkAllocationCallbacks* pAllocator) {
+  NULL_CALL(vkDestroyPipeline);
+  if (pipeline != VK_NULL_HANDLE) DestroyObject(pipeline);
+}
+
+// ---------------------------------------------------------------------------
+// Command buffers
+
+VKAPI_ATTR VkResult VKAPI_CALL NullCreateCommandPool(
+    VkDevice device, const VkCommandPoolCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkCommandPool* pCommandPool) {
+  NULL_CALL(vkCreateCommandPool);
+  *pCommandPool = ToHandle<VkCommandPool>(new NullCommandPool());
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullDestroyCommandPool(
+    VkDevice device, VkCommandPool commandPool,
+    const VkAllocationCallbacks* pAllocator) {
+  NULL_CALL(vkDestroyCommandPool);
+  if (commandPool == VK_NULL_HANDLE) return;
+  // Destroying a pool frees the command buffers still allocated from it.
+  NullCommandPool* pool = FromHandle<NullCommandPool>(commandPool);
+  for (NullCommandBuffer* commandBuffer : pool->commandBuffers)
+    delete commandBuffer;
+  delete pool;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullResetCommandPool(
+    VkDevice device, VkCommandPool commandPool, VkCommandPoolResetFlags flags) {
+  NULL_CALL(vkResetCommandPool);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullAllocateCommandBuffers(
+    VkDevice device, const VkCommandBufferAllocateInfo* pAllocateInfo,
+    VkCommandBuffer* pCommandBuffers) {
+  NULL_CALL(vkAllocateCommandBuffers);
+  NullCommandPool* pool =
+      FromHandle<NullCommandPool>(pAllocateInfo->commandPool);
+  for (uint32_t i = 0; i < pAllocateInfo->commandBufferCount; i++) {
+    NullCommandBuffer* commandBuffer = new NullCommandBuffer();
+    pool->commandBuffers.insert(commandBuffer);
+    pCommandBuffers[i] = ToHandle<VkCommandBuffer>(commandBuffer);
+  }
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullFreeCommandBuffers(
+    VkDevice device, VkCommandPool commandPool, uint32_t commandBufferCount,
+    const VkCommandBuffer* pCommandBuffers) {
+  NULL_CALL(vkFreeCommandBuffers);
+  NullCommandPool* pool = FromHandle<NullCommandPool>(commandPool);
+  for (uint32_t i = 0; i < commandBufferCount; i++) {
+    if (pCommandBuffers[i] == VK_NULL_HANDLE) continue;
+    NullCommandBuffer* commandBuffer =
+        FromHandle<NullCommandBuffer>(pCommandBuffers[i]);
+    pool->commandBuffers.erase(commandBuffer);
+    delete commandBuffer;
+  }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullBeginCommandBuffer(
+    VkCommandBuffer commandBuffer, const VkCommandBufferBeginInfo* pBeginInfo) {
+  NULL_CALL(vkBeginCommandBuffer);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullEndCommandBuffer(
+    VkCommandBuffer commandBuffer) {
+  NULL_CALL(vkEndCommandBuffer);
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL NullResetCommandBuffer(
+    VkCommandBuffer commandBuffer, VkCommandBufferResetFlags flags) {
+  NULL_CALL(vkResetCommandBuffer);
+  return VK_SUCCESS;
+}
+
+// Commands are dropped: only the call counts are kept.
+
+VKAPI_ATTR void VKAPI_CALL NullCmdBindPipeline(
+    VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint,
+    VkPipeline pipeline) {
+  NULL_CALL(vkCmdBindPipeline);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullCmdSetViewport(VkCommandBuffer commandBuffer,
+                                              uint32_t firstViewport,
+                                              uint32_t viewportCount,
+                                              const VkViewport* pViewports) {
+  NULL_CALL(vkCmdSetViewport);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullCmdSetScissor(VkCommandBuffer commandBuffer,
+                                             uint32_t firstScissor,
+                                             uint32_t scissorCount,
+                                             const VkRect2D* pScissors) {
+  NULL_CALL(vkCmdSetScissor);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullCmdBindDescriptorSets(
+    VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint,
+    VkPipelineLayout layout, uint32_t firstSet, uint32_t descriptorSetCount,
+    const VkDescriptorSet* pDescriptorSets, uint32_t dynamicOffsetCount,
+    const uint32_t* pDynamicOffsets) {
+  NULL_CALL(vkCmdBindDescriptorSets);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullCmdBindIndexBuffer(VkCommandBuffer commandBuffer,
+                                                  VkBuffer buffer,
+                                                  VkDeviceSize offset,
+                                                  VkIndexType indexType) {
+  NULL_CALL(vkCmdBindIndexBuffer);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullCmdBindVertexBuffers(
+    VkCommandBuffer commandBuffer, uint32_t firstBinding, uint32_t bindingCount,
+    const VkBuffer* pBuffers, const VkDeviceSize* pOffsets) {
+  NULL_CALL(vkCmdBindVertexBuffers);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullCmdDraw(VkCommandBuffer commandBuffer,
+                                       uint32_t vertexCount,
+                                       uint32_t instanceCount,
+                                       uint32_t firstVertex,
+                                       uint32_t firstInstance) {
+  NULL_CALL(vkCmdDraw);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullCmdDrawIndexed(VkCommandBuffer commandBuffer,
+                                              uint32_t indexCount,
+                                              uint32_t instanceCount,
+                                              uint32_t firstIndex,
+                                              int32_t vertexOffset,
+                                              uint32_t firstInstance) {
+  NULL_CALL(vkCmdDrawIndexed);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullCmdCopyBuffer(VkCommandBuffer commandBuffer,
+                                             VkBuffer srcBuffer,
+                                             VkBuffer dstBuffer,
+                                             uint32_t regionCount,
+                                             const VkBufferCopy* pRegions) {
+  NULL_CALL(vkCmdCopyBuffer);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullCmdCopyBufferToImage(
+    VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkImage dstImage,
+    VkImageLayout dstImageLayout, uint32_t regionCount,
+    const VkBufferImageCopy* pRegions) {
+  NULL_CALL(vkCmdCopyBufferToImage);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullCmdCopyImage(VkCommandBuffer commandBuffer,
+                                            VkImage srcImage,
+                                            VkImageLayout srcImageLayout,
+                                            VkImage dstImage,
+                                            VkImageLayout dstImageLayout,
+                                            uint32_t regionCount,
+                                            const VkImageCopy* pRegions) {
+  NULL_CALL(vkCmdCopyImage);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullCmdCopyImageToBuffer(
+    VkCommandBuffer commandBuffer, VkImage srcImage,
+    VkImageLayout srcImageLayout, VkBuffer dstBuffer, uint32_t regionCount,
+    const VkBufferImageCopy* pRegions) {
+  NULL_CALL(vkCmdCopyImageToBuffer);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullCmdPipelineBarrier(
+    VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask,
+    VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlags,
+    uint32_t memoryBarrierCount, const VkMemoryBarrier* pMemoryBarriers,
+    uint32_t bufferMemoryBarrierCount,
+    const VkBufferMemoryBarrier* pBufferMemoryBarriers,
+    uint32_t imageMemoryBarrierCount,
+    const VkImageMemoryBarrier* pImageMemoryBarriers) {
+  NULL_CALL(vkCmdPipelineBarrier);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullCmdResetQueryPool(VkCommandBuffer commandBuffer,
+                                                 VkQueryPool queryPool,
+                                                 uint32_t firstQuery,
+                                                 uint32_t queryCount) {
+  NULL_CALL(vkCmdResetQueryPool);
+  NullQueryPool* pool = FromHandle<NullQueryPool>(queryPool);
+  for (uint32_t i = 0; i < queryCount; i++)
+    pool->available[firstQuery + i] = false;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullCmdWriteTimestamp(
+    VkCommandBuffer commandBuffer, VkPipelineStageFlagBits pipelineStage,
+    VkQueryPool queryPool, uint32_t query) {
+  NULL_CALL(vkCmdWriteTimestamp);
+  NullQueryPool* pool = FromHandle<NullQueryPool>(queryPool);
+  pool->values[query] = HostNanoseconds();
+  pool->available[query] = true;
+}
+
+VKAPI_ATTR void VKAPI_CALL NullCmdPushConstants(
+    VkCommandBuffer commandBuffer, VkPipelineLayout layout,
+    VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size,
+    const void* pValues) {
+  NULL_CALL(vkCmdPushConstants);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullCmdBeginRenderPass(
+    VkCommandBuffer commandBuffer,
+    const VkRenderPassBeginInfo* pRenderPassBegin,
+    VkSubpassContents contents) {
+  NULL_CALL(vkCmdBeginRenderPass);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullCmdEndRenderPass(VkCommandBuffer commandBuffer) {
+  NULL_CALL(vkCmdEndRenderPass);
+}
+
+VKAPI_ATTR void VKAPI_CALL NullCmdExecuteCommands(
+    VkCommandBuffer commandBuffer, uint32_t commandBufferCount,
+    const VkCommandBuffer* pCommandBuffers) {
+  NULL_CALL(vkCmdExecuteCommands);
+}
+
+}  // namespace
+
+int InitVulkanNull(void) {
+  vkCreateInstance = NullCreateInstance;
+  vkDestroyInstance = NullDestroyInstance;
+  vkEnumeratePhysicalDevices = NullEnumeratePhysicalDevices;
+  vkGetPhysicalDeviceProperties = NullGetPhysicalDeviceProperties;
+  vkGetPhysicalDeviceFormatProperties = NullGetPhysicalDeviceFormatProperties;
+  vkGetPhysicalDeviceQueueFamilyProperties =
+      NullGetPhysicalDeviceQueueFamilyProperties;
+  vkGetPhysicalDeviceMemoryProperties = NullGetPhysicalDeviceMemoryProperties;
+  vkCreateDevice = NullCreateDevice;
+  vkDestroyDevice = NullDestroyDevice;
+  vkGetDeviceQueue = NullGetDeviceQueue;
+  vkQueueSubmit = NullQueueSubmit;
+  vkQueueWaitIdle = NullQueueWaitIdle;
+  vkDeviceWaitIdle = NullDeviceWaitIdle;
+
+  vkAllocateMemory = NullAllocateMemory;
+  vkFreeMemory = NullFreeMemory;
+  vkMapMemory = NullMapMemory;
+  vkUnmapMemory = NullUnmapMemory;
+  vkFlushMappedMemoryRanges = NullFlushMappedMemoryRanges;
+  vkInvalidateMappedMemoryRanges = NullInvalidateMappedMemoryRanges;
+  vkBindBufferMemory = NullBindBufferMemory;
+  vkBindImageMemory = NullBindImageMemory;
+  vkGetBufferMemoryRequirements = NullGetBufferMemoryRequirements;
+  vkGetImageMemoryRequirements = NullGetImageMemoryRequirements;
+
+  vkCreateFence = NullCreateFence;
+  vkDestroyFence = NullDestroyFence;
+  vkResetFences = NullResetFences;
+  vkGetFenceStatus = NullGetFenceStatus;
+  vkWaitForFences = NullWaitForFences;
+  vkCreateSemaphore = NullCreateSemaphore;
+  vkDestroySemaphore = NullDestroySemaphore;
+  vkCreateQueryPool = NullCreateQueryPool;
+  vkDestroyQueryPool = NullDestroyQueryPool;
+  vkGetQueryPoolResults = NullGetQueryPoolResults;
+
+  vkCreateBuffer = NullCreateBuffer;
+  vkDestroyBuffer = NullDestroyBuffer;
+  vkCreateImage = NullCreateImage;
+  vkDestroyImage = NullDestroyImage;
+  vkCreateImageView = NullCreateImageView;
+  vkDestroyImageView = NullDestroyImageView;
+  vkCreateSampler = NullCreateSampler;
+  vkDestroySampler = NullDestroySampler;
+  vkCreateShaderModule = NullCreateShaderModule;
+  vkDestroyShaderModule = NullDestroyShaderModule;
+  vkCreatePipelineCache = NullCreatePipelineCache;
+  vkDestroyPipelineCache = NullDestroyPipelineCache;
+  vkGetPipelineCacheData = NullGetPipelineCacheData;
+  vkCreateGraphicsPipelines = NullCreateGraphicsPipelines;
+  vkDestroyPipeline = NullDestroyPipeline;
+  vkCreatePipelineLayout = NullCreatePipelineLayout;
+  vkDestroyPipelineLayout = NullDestroyPipelineLayout;
+  vkCreateDescriptorSetLayout = NullCreateDescriptorSetLayout;
+  vkDestroyDescriptorSetLayout = NullDestroyDescriptorSetLayout;
+  vkCreateFramebuffer = NullCreateFramebuffer;
+  vkDestroyFramebuffer = NullDestroyFramebuffer;
+  vkCreateRenderPass = NullCreateRenderPass;
+  vkDestroyRenderPass = NullDestroyRenderPass;
+
+  vkCreateCommandPool = NullCreateCommandPool;
+  vkDestroyCommandPool = NullDestroyCommandPool;
+  vkResetCommandPool = NullResetCommandPool;
+  vkAllocateCommandBuffers = NullAllocateCommandBuffers;
+  vkFreeCommandBuffers = NullFreeCommandBuffers;
+  vkBeginCommandBuffer = NullBeginCommandBuffer;
+  vkEndCommandBuffer = NullEndCommandBuffer;
+  vkResetCommandBuffer = NullResetCommandBuffer;
+  vkCmdBindPipeline = NullCmdBindPipeline;
+  vkCmdSetViewport = NullCmdSetViewport;
+  vkCmdSetScissor = NullCmdSetScissor;
+  vkCmdBindDescriptorSets = NullCmdBindDescriptorSets;
+  vkCmdBindIndexBuffer = NullCmdBindIndexBuffer;
+  vkCmdBindVertexBuffers = NullCmdBindVertexBuffers;
+  vkCmdDraw = NullCmdDraw;
+  vkCmdDrawIndexed = NullCmdDrawIndexed;
+  vkCmdCopyBuffer = NullCmdCopyBuffer;
+  vkCmdCopyBufferToImage = NullCmdCopyBufferToImage;
+  vkCmdCopyImage = NullCmdCopyImage;
+  vkCmdCopyImageToBuffer = NullCmdCopyImageToBuffer;
+  vkCmdPipelineBarrier = NullCmdPipelineBarrier;
+  vkCmdResetQueryPool = NullCmdResetQueryPool;
+  vkCmdWriteTimestamp = NullCmdWriteTimestamp;
+  vkCmdPushConstants = NullCmdPushConstants;
+  vkCmdBeginRenderPass = NullCmdBeginRenderPass;
+  vkCmdEndRenderPass = NullCmdEndRenderPass;
+  vkCmdExecuteCommands = NullCmdExecuteCommands;
+
+  VulkanNullResetCallCounts();
+  return 1;
+}
+
+uint64_t VulkanNullGetCallCount(const char* name) {
+  std::lock_guard<std::mutex> lock(CounterMutex());
+  for (CallCounter* counter : Counters()) {
+    if (strcmp(counter->name, name) == 0)
+      return counter->count.load(std::memory_order_relaxed);
+  }
+  return 0;
+}
+
+uint64_t VulkanNullGetTotalCallCount(void) {
+  std::lock_guard<std::mutex> lock(CounterMutex());
+  uint64_t total = 0;
+  for (CallCounter* counter : Counters())
+    total += counter->count.load(std::memory_order_relaxed);
+  return total;
+}
+
+void VulkanNullResetCallCounts(void) {
+  std::lock_guard<std::mutex> lock(CounterMutex());
+  for (CallCounter* counter : Counters())
+    counter->count.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,34 @@
+// In-process null Vulkan driver for vulkan_wrapper.
+//
+// InitVulkanNull() fills the function pointers declared in vulkan_wrapper.h
+// with a fake device that hands out handles, backs host-visible memory with
+// host RAM, signals fences on submit and counts calls, without rendering
+// anything. It lets the CPU side of the engine (buffer management, command
+// recording, the frame loop) run and be measured on any Linux box, with no
+// GPU and no ICD installed.
+//
+// Only the core 1.0 entry points the engine uses (plus their obvious
+// relatives) are provided; the others are left null, as if dlsym had failed.
+#ifndef VULKAN_NULL_H
+#define VULKAN_NULL_H
+
+#include "vulkan_wrapper.h"
+
+#include <stdint.h>
+
+/* Initialize the Vulkan function pointer variables with the null driver.
+ * Returns non-zero on success. Call instead of InitVulkan().
+ */
+int InitVulkanNull(void);
+
+/* Number of calls made to the entry point |name| (e.g. "vkCmdDrawIndexed")
+ * since InitVulkanNull() or the last reset.
+ */
+uint64_t VulkanNullGetCallCount(const char* name);
+
+/* Total number of calls made to all entry points. */
+uint64_t VulkanNullGetTotalCallCount(void);
+
+void VulkanNullResetCallCounts(void);
+
+#endif  // VULKAN_NULL_H
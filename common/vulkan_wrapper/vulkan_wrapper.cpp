@@ -16,7 +16,12 @@
 #include <dlfcn.h>
 
 int InitVulkan(void) {
+#ifdef __ANDROID__
     void* libvulkan = dlopen("libvulkan.so", RTLD_NOW | RTLD_LOCAL);
+#else
+    // Desktop Linux only ships the versioned loader without the -dev package
+    void* libvulkan = dlopen("libvulkan.so.1", RTLD_NOW | RTLD_LOCAL);
+#endif
     if (!libvulkan)
         return 0;
 
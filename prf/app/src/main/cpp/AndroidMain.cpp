@@ -25,6 +25,11 @@ void handle_cmd(android_app* app, int32_t cmd) {
       // The window is being hidden or closed, clean it up.
       DeleteVulkan();
       break;
+    case APP_CMD_WINDOW_RESIZED:
+    case APP_CMD_CONFIG_CHANGED:
+      // Size or orientation changed, the swapchain has to be recreated.
+      if (IsVulkanReady()) VulkanWindowResized();
+      break;
     default:
       __android_log_print(ANDROID_LOG_INFO, "prf-android",
                           "event not handled: %d", cmd);
@@ -0,0 +1,238 @@
+//
+// Created by richardwu on 11/5/24.
+//
+// headless后端：不依赖窗口系统，渲染到离屏图像，用于在没有设备的机器上（如lavapipe）测量engine2d的性能
+// 与设备无关的部分由Engine2D完成，这里只有离屏图像、fence与提交，对应VulkanMain.cpp中的交换链部分
+
+#include "HeadlessMain.hpp"
+
+#include "log.h"
+
+#include "vulkan/utils.h"
+#include "vulkan/instance.h"
+#include "vulkan/physical_device.h"
+#include "vulkan/queue_family_index.h"
+#include "vulkan/device.h"
+#include "vulkan/queue.h"
+#include "vulkan/render_pass.h"
+#include "vulkan/offscreen.h"
+#include "vulkan/command_pool.h"
+#include "vulkan/command_buffers.h"
+#include "vulkan/sync_objects.h"
+#include "vulkan/pipeline_cache.h"
+
+#include "engine2d/Engine2D.h"
+#include "engine2d/Trace.h"
+
+#include <vulkan_wrapper.h>
+#include <vulkan_null.h>
+
+#include <cassert>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+VulkanDeviceInfo deviceInfo;
+VulkanOffscreenInfo offscreenInfo;
+VulkanRenderInfo renderInfo;
+
+/* 管线缓存保存在assetDir下，重复运行时跳过编译 */
+std::string pipelineCachePath;
+
+/* 在途帧数，每个在途帧一个离屏图像 */
+const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+
+/* 2d引擎：资源管理器、管线与每帧的录制 */
+Engine2D *engine2d;
+
+/* 帧时间统计由调用者决定何时读取与重置 */
+std::chrono::steady_clock::time_point lastFrameBegin;
+bool hasLastFrameBegin;
+
+bool InitVulkanHeadless(uint32_t width, uint32_t height, const std::string &assetDir, bool useNullDriver) {
+
+    if (useNullDriver) {
+        // 使用进程内的空驱动，只测量CPU侧的开销
+        InitVulkanNull();
+        LOGI("using the null vulkan driver, nothing is rendered");
+    } else if (!InitVulkan()) {
+        // 获取libvulkan.so中含有的vulkan函数
+        LOGE("Vulkan is unavailable, install a vulkan driver (e.g. lavapipe) and re-start");
+        return false;
+    }
+
+    // 依次创建vulkan全局数据结构（不需要surface与交换链扩展）
+    deviceInfo.instance_ = getInstance(true);
+    deviceInfo.surface_ = VK_NULL_HANDLE;
+    deviceInfo.physicalDevice_ = getPhysicalDevice(deviceInfo.instance_, deviceInfo.surface_);
+    deviceInfo.queueFamilyIndex_ = getQueueFamilyIndex(deviceInfo.physicalDevice_);
+    deviceInfo.transferQueueFamilyIndex_ = getTransferQueueFamilyIndex(deviceInfo.physicalDevice_,
+                                                                       deviceInfo.queueFamilyIndex_);
+    deviceInfo.device_ = getDevice(deviceInfo.physicalDevice_, deviceInfo.queueFamilyIndex_,
+                                   deviceInfo.transferQueueFamilyIndex_, true);
+    deviceInfo.queue_ = getQueue(deviceInfo.device_, deviceInfo.queueFamilyIndex_);
+    deviceInfo.transferQueue_ = getQueue(deviceInfo.device_, deviceInfo.transferQueueFamilyIndex_);
+
+    // 创建render pass，渲染结束后图像转为TRANSFER_SRC以便读回
+    renderInfo.renderPass_ = getRenderPass(deviceInfo.device_, VK_FORMAT_R8G8B8A8_UNORM,
+                                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+    // 在途帧数，每个在途帧一个离屏图像
+    renderInfo.framesInFlight_ = MAX_FRAMES_IN_FLIGHT;
+    renderInfo.currentFrame_ = 0;
+    getOffscreenTargets(deviceInfo.physicalDevice_, deviceInfo.device_, renderInfo.renderPass_,
+                        VK_FORMAT_R8G8B8A8_UNORM, VkExtent2D{width, height}, renderInfo.framesInFlight_,
+                        &offscreenInfo);
+
+    // 创建指令池与指令缓冲（为每个在途帧）
+    renderInfo.cmdPool_ = getCommandPool(deviceInfo.device_, deviceInfo.queueFamilyIndex_);
+    getCommandBuffers(deviceInfo.device_, renderInfo.framesInFlight_, renderInfo.cmdPool_, &renderInfo);
+
+    // 没有交换链，只需要每个在途帧的fence
+    getInFlightFences(deviceInfo.device_, &renderInfo);
+
+    // 空驱动的缓存与真实驱动的不兼容，分开保存以免互相覆盖
+    pipelineCachePath = assetDir + (useNullDriver ? "/pipeline_cache_null.bin" : "/pipeline_cache.bin");
+    renderInfo.pipelineCache_ = getPipelineCache(deviceInfo.device_, deviceInfo.physicalDevice_, pipelineCachePath);
+
+
+// ============================ 以下为2d引擎资源管理器 ============================
+
+    // 测量时每一帧的内容都要完整，同步等待静态数据的上传与所有管线的编译
+    engine2d = new Engine2D(deviceInfo, renderInfo.renderPass_, renderInfo.pipelineCache_,
+                            renderInfo.framesInFlight_, getAssetReader(assetDir), true);
+    hasLastFrameBegin = false;
+
+    deviceInfo.initialized_ = true;
+    return true;
+}
+
+bool IsVulkanHeadlessReady() {
+    return deviceInfo.initialized_;
+}
+
+void HeadlessWaitIdle() {
+    vkDeviceWaitIdle(deviceInfo.device_);
+}
+
+uint32_t HeadlessGetDeviceAllocationCount() {
+    return engine2d->getMemoryArena()->getAllocationCount();
+}
+
+bool HeadlessGetGpuProfile(GpuFrameProfile *profile) {
+    return engine2d->getGpuProfiler()->getLatestProfile(profile);
+}
+
+void HeadlessGetFrameStats(FrameStatsSummary *summary) {
+    engine2d->getFrameStats()->getSummary(summary);
+}
+
+void HeadlessResetFrameStats() {
+    engine2d->getFrameStats()->reset();
+    hasLastFrameBegin = false;
+}
+
+static double elapsedMs(std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+void DeleteVulkanHeadless() {
+
+    // 等待所有在途帧执行完毕
+    vkDeviceWaitIdle(deviceInfo.device_);
+
+    DeleteSyncObjects(deviceInfo.device_, &renderInfo);
+
+    vkFreeCommandBuffers(deviceInfo.device_, renderInfo.cmdPool_, renderInfo.cmdBuffer_.size(),
+                         renderInfo.cmdBuffer_.data());
+    renderInfo.cmdBuffer_.clear();
+
+    vkDestroyCommandPool(deviceInfo.device_, renderInfo.cmdPool_, nullptr);
+    DeleteOffscreenTargets(deviceInfo.device_, &offscreenInfo);
+    vkDestroyRenderPass(deviceInfo.device_, renderInfo.renderPass_, nullptr);
+
+    // 引擎中的编译任务使用管线缓存，先于其销毁
+    delete engine2d;
+    savePipelineCache(deviceInfo.device_, renderInfo.pipelineCache_, pipelineCachePath);
+    vkDestroyPipelineCache(deviceInfo.device_, renderInfo.pipelineCache_, nullptr);
+
+    vkDestroyDevice(deviceInfo.device_, nullptr);
+    vkDestroyInstance(deviceInfo.instance_, nullptr);
+
+    deviceInfo.initialized_ = false;
+}
+
+bool HeadlessDrawFrame(const HeadlessSceneFunc &scene, HeadlessFrameStats *stats) {
+    TRACE_SCOPE("HeadlessDrawFrame");
+
+    // 当前在途帧，也是本帧渲染的离屏图像
+    uint32_t frame = renderInfo.currentFrame_;
+    VkCommandBuffer cmdBuffer = renderInfo.cmdBuffer_[frame];
+
+    // 等待该在途帧上一次的提交执行完毕，之后才能复用它的指令缓冲、临时资源与离屏图像
+    auto waitBegin = std::chrono::steady_clock::now();
+    double frameMs = hasLastFrameBegin ? elapsedMs(lastFrameBegin, waitBegin) : -1;
+    lastFrameBegin = waitBegin;
+    hasLastFrameBegin = true;
+    TRACE_BEGIN("fence wait");
+    CALL_VK(vkWaitForFences(deviceInfo.device_, 1, &renderInfo.inFlightFences_[frame], VK_TRUE, UINT64_MAX));
+    TRACE_END("fence wait");
+    auto recordBegin = std::chrono::steady_clock::now();
+    CALL_VK(vkResetFences(deviceInfo.device_, 1, &renderInfo.inFlightFences_[frame]));
+    TRACE_BEGIN("record");
+
+    engine2d->beginFrame(frame, cmdBuffer, offscreenInfo.displaySize_);
+
+    VkClearValue clearVals = {{{1.0f, 1.0f, 1.0f, 0.0f}}};
+    VkRenderPassBeginInfo renderPassBeginInfo{
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            .pNext = nullptr,
+            .renderPass = renderInfo.renderPass_,
+            .framebuffer = offscreenInfo.framebuffers_[frame],
+            .renderArea = {.offset {.x = 0, .y = 0,},
+                    .extent = offscreenInfo.displaySize_},
+            .clearValueCount = 1,
+            .pClearValues = &clearVals};
+
+    // 本帧场景，屏幕外的矩形在提交时被丢弃
+    scene(engine2d->getFrame());
+
+    engine2d->recordRenderPass(cmdBuffer, renderPassBeginInfo, VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR);
+    engine2d->endFrame(cmdBuffer);
+    TRACE_END("record");
+    auto submitBegin = std::chrono::steady_clock::now();
+
+    // 没有交换链，不需要等待或signal信号量，只用fence跟踪该在途帧
+    VkSubmitInfo submit_info = {.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = nullptr,
+            .waitSemaphoreCount = 0,
+            .pWaitSemaphores = nullptr,
+            .pWaitDstStageMask = nullptr,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &cmdBuffer,
+            .signalSemaphoreCount = 0,
+            .pSignalSemaphores = nullptr};
+    // 本帧新建的静态缓冲先提交复制（同一队列时排在本帧之前）
+    engine2d->submit(deviceInfo.queue_, submit_info, renderInfo.inFlightFences_[frame]);
+    auto submitEnd = std::chrono::steady_clock::now();
+
+    // 没有交换链，acquire与present两段为空
+    FrameTimes frameTimes;
+    for (uint32_t i = 0; i < FRAME_INTERVAL_COUNT; i++) frameTimes.ms_[i] = -1;
+    frameTimes.ms_[FRAME_INTERVAL_FRAME] = frameMs;
+    frameTimes.ms_[FRAME_INTERVAL_FENCE_WAIT] = elapsedMs(waitBegin, recordBegin);
+    frameTimes.ms_[FRAME_INTERVAL_RECORD] = elapsedMs(recordBegin, submitBegin);
+    frameTimes.ms_[FRAME_INTERVAL_SUBMIT] = elapsedMs(submitBegin, submitEnd);
+    engine2d->getFrameStats()->addFrame(frameTimes);
+
+    if (stats) {
+        stats->fenceWaitMs_ = frameTimes.ms_[FRAME_INTERVAL_FENCE_WAIT];
+        stats->recordMs_ = frameTimes.ms_[FRAME_INTERVAL_RECORD];
+        stats->submitMs_ = frameTimes.ms_[FRAME_INTERVAL_SUBMIT];
+    }
+
+    renderInfo.currentFrame_ = (frame + 1) % renderInfo.framesInFlight_;
+    return true;
+}
@@ -0,0 +1,60 @@
+//
+// Created by richardwu on 11/5/24.
+//
+
+#ifndef HEADLESS_MAIN_HPP
+#define HEADLESS_MAIN_HPP
+
+#include "engine2d/Engine2D.h"
+#include "engine2d/GpuProfiler.h"
+#include "engine2d/FrameStats.h"
+
+#include <functional>
+#include <string>
+
+// 场景可以使用的本帧资源，离屏图像没有旋转，width_、height_即为其像素尺寸
+typedef Engine2DFrame HeadlessFrame;
+
+// 每帧调用一次，向引擎提交本帧的场景
+typedef std::function<void(const HeadlessFrame &frame)> HeadlessSceneFunc;
+
+// 一帧在CPU上的耗时
+struct HeadlessFrameStats {
+    double fenceWaitMs_; // 复用该在途帧前等待其fence（GPU落后于CPU时不为0）
+    double recordMs_; // 场景、上传与指令录制，直到vkEndCommandBuffer
+    double submitMs_; // vkQueueSubmit
+};
+
+// Initialize a vulkan context without any window system (no VK_KHR_surface),
+// rendering into width x height offscreen images.
+// assetDir is where the build puts the compiled shaders (shaders/*.spv)
+// useNullDriver replaces libvulkan with the in-process null driver (vulkan_null.h):
+// nothing is rendered, only the CPU side of the engine is exercised
+bool InitVulkanHeadless(uint32_t width, uint32_t height, const std::string &assetDir,
+                        bool useNullDriver = false);
+
+// delete the headless vulkan context
+void DeleteVulkanHeadless();
+
+// Check if vulkan is ready to draw
+bool IsVulkanHeadlessReady();
+
+// Record and submit one frame, does not wait for the GPU
+// (at most framesInFlight frames are in flight, as on Android)
+bool HeadlessDrawFrame(const HeadlessSceneFunc &scene, HeadlessFrameStats *stats = nullptr);
+
+// Wait until every submitted frame has finished on the GPU
+void HeadlessWaitIdle();
+
+// Number of VkDeviceMemory blocks currently allocated by the engine
+uint32_t HeadlessGetDeviceAllocationCount();
+
+// GPU timings of the latest resolved frame (framesInFlight frames behind),
+// false if none yet or timestamps are not supported
+bool HeadlessGetGpuProfile(GpuFrameProfile *profile);
+
+// Frame time percentiles since InitVulkanHeadless or the last reset
+void HeadlessGetFrameStats(FrameStatsSummary *summary);
+void HeadlessResetFrameStats();
+
+#endif // HEADLESS_MAIN_HPP
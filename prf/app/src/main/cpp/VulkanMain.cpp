@@ -32,27 +32,54 @@
 #include "vulkan/sync_objects.h"
 #include "vulkan/pipeline_cache.h"
 
-#include "engine2d/utils.h"
-#include "engine2d/pipeline.h"
 #include "engine2d/image_layout.h"
-#include "engine2d/BufferManager.h"
+#include "engine2d/Engine2D.h"
+#include "engine2d/ThreadPool.h"
+#include "engine2d/Trace.h"
 
 #include <vulkan_wrapper.h>
 
 #include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstring>
+#include <string>
+#include <thread>
 #include <vector>
 #include <stdlib.h>
+#include <sys/system_properties.h>
 
 VulkanDeviceInfo deviceInfo;
 VulkanSwapchainInfo swapchainInfo;
 VulkanRenderInfo renderInfo;
 
-VulkanPipelineInfo pipelineInfo; // TODO：假设现在只有一个pipeline
+/* 窗口尺寸或方向变化、或present返回SUBOPTIMAL/OUT_OF_DATE时置位，在下一帧开始时重建交换链 */
+bool swapchainOutOfDate;
 
-/* 管理系统全局的所有各类型的VkBuffer */
-BufferManager *vertexBufferManager;
-BufferManager *indexBufferManager;
+/* 管线缓存在磁盘上的位置，退出时以及每隔一段时间写回 */
+std::string pipelineCachePath;
+uint64_t frameCount;
+const uint64_t PIPELINE_CACHE_CHECKPOINT_FRAMES = 1800; // 60fps下约30秒
+/* 定期的写回在单独的线程上进行，不阻塞渲染线程；同一时间最多一个写回任务 */
+ThreadPool *pipelineCacheSaveThread;
+std::atomic<bool> pipelineCacheSavePending;
+size_t pipelineCacheSavedSize; // 磁盘上的数据大小，只在写回线程上（或其结束之后）访问
+
+/* 同时在途的帧数，不超过交换链图像数 */
+const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+
+/* 2d引擎：资源管理器、管线与每帧的录制 */
+Engine2D *engine2d;
+TextureHandle demoTexture; // 场景中的纹理，解码完成之前相应的精灵被跳过
+
+/* 帧时间统计每隔一段时间打印一次并开始新的统计窗口 */
+const uint64_t FRAME_STATS_DUMP_FRAMES = 600; // 60fps下约10秒
+std::chrono::steady_clock::time_point lastFrameBegin;
+bool hasLastFrameBegin;
+
+/* CPU打点：adb shell setprop debug.prf.trace 1后启动，DeleteVulkan时写到该文件 */
+std::string traceFilePath;
 
 /*
  * setImageLayout():
@@ -79,11 +106,17 @@ bool InitVulkan(android_app *app) {
     deviceInfo.surface_ = getSurface(deviceInfo.instance_, app->window);
     deviceInfo.physicalDevice_ = getPhysicalDevice(deviceInfo.instance_, deviceInfo.surface_);
     deviceInfo.queueFamilyIndex_ = getQueueFamilyIndex(deviceInfo.physicalDevice_);
-    deviceInfo.device_ = getDevice(deviceInfo.physicalDevice_, deviceInfo.queueFamilyIndex_);
+    deviceInfo.transferQueueFamilyIndex_ = getTransferQueueFamilyIndex(deviceInfo.physicalDevice_,
+                                                                       deviceInfo.queueFamilyIndex_);
+    deviceInfo.device_ = getDevice(deviceInfo.physicalDevice_, deviceInfo.queueFamilyIndex_,
+                                   deviceInfo.transferQueueFamilyIndex_);
     deviceInfo.queue_ = getQueue(deviceInfo.device_, deviceInfo.queueFamilyIndex_);
+    deviceInfo.transferQueue_ = getQueue(deviceInfo.device_, deviceInfo.transferQueueFamilyIndex_);
 
     // 创建交换链
-    getSwapChain(deviceInfo.surface_, deviceInfo.physicalDevice_, deviceInfo.queueFamilyIndex_, deviceInfo.device_, &swapchainInfo);
+    getSwapChain(deviceInfo.surface_, deviceInfo.physicalDevice_, deviceInfo.queueFamilyIndex_, deviceInfo.device_,
+                 VK_NULL_HANDLE, &swapchainInfo);
+    swapchainOutOfDate = false;
 
     // 创建render pass
     renderInfo.renderPass_ = getRenderPass(deviceInfo.device_, swapchainInfo.displayFormat_);
@@ -94,27 +127,42 @@ bool InitVulkan(android_app *app) {
     // 创建指令池
     renderInfo.cmdPool_ = getCommandPool(deviceInfo.device_, deviceInfo.queueFamilyIndex_);
 
-    // 创建指令缓冲（为帧缓冲中的每一帧）
-    getCommandBuffers(deviceInfo.device_, swapchainInfo.swapchainLength_, renderInfo.cmdPool_, &renderInfo);
+    // 在途帧数
+    renderInfo.framesInFlight_ = std::min(MAX_FRAMES_IN_FLIGHT, swapchainInfo.swapchainLength_);
+    renderInfo.currentFrame_ = 0;
 
-    // 创建同步原语
-    getImageAvailableSemaphore(deviceInfo.device_, &renderInfo);
-    getRenderFinishedFence(deviceInfo.device_, &renderInfo);
+    // 创建指令缓冲（为每个在途帧）
+    getCommandBuffers(deviceInfo.device_, renderInfo.framesInFlight_, renderInfo.cmdPool_, &renderInfo);
 
-    // 创建管线缓存
-    renderInfo.pipelineCache_ = getPipelineCache(deviceInfo.device_);
+    // 创建同步原语（为每个在途帧）
+    getImageAvailableSemaphores(deviceInfo.device_, &renderInfo);
+    getRenderFinishedSemaphores(deviceInfo.device_, &renderInfo);
+    getInFlightFences(deviceInfo.device_, &renderInfo);
+    renderInfo.imagesInFlight_.assign(swapchainInfo.swapchainLength_, VK_NULL_HANDLE);
 
+    // 创建管线缓存（以上次保存在磁盘上的数据作为初始数据）
+    pipelineCachePath = std::string(app->activity->internalDataPath) + "/pipeline_cache.bin";
+    renderInfo.pipelineCache_ = getPipelineCache(deviceInfo.device_, deviceInfo.physicalDevice_, pipelineCachePath,
+                                                 &pipelineCacheSavedSize);
+    pipelineCacheSaveThread = new ThreadPool(1);
+    pipelineCacheSavePending.store(false);
+    frameCount = 0;
+
+    // 打点默认关闭，由系统属性打开
+    char traceProperty[PROP_VALUE_MAX] = {};
+    __system_property_get("debug.prf.trace", traceProperty);
+    TraceSetEnabled(traceProperty[0] == '1');
+    TraceSetThreadName("render");
+    traceFilePath = std::string(app->activity->internalDataPath) + "/trace.json";
 
-// ============================ 以下为2d引擎资源管理器 ============================
 
-    // 为每个2的整次幂维护一个可用VkBuffer的列表进行复用（全局数据结构）
-    vertexBufferManager = new BufferManager(deviceInfo.device_, deviceInfo.physicalDevice_, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-    indexBufferManager = new BufferManager(deviceInfo.device_, deviceInfo.physicalDevice_, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+// ============================ 以下为2d引擎资源管理器 ============================
 
-    // TODO: pipeline需要维护一个LRU的哈希表（全局数据结构）
-    // Create graphics pipeline
-    createGraphicsPipeline(app, deviceInfo.device_, swapchainInfo.displaySize_,
-            renderInfo.renderPass_, renderInfo.pipelineCache_, &pipelineInfo);
+    // 管线在后台编译，不阻塞初始化与渲染线程
+    engine2d = new Engine2D(deviceInfo, renderInfo.renderPass_, renderInfo.pipelineCache_,
+                            renderInfo.framesInFlight_, getAssetReader(app), false);
+    demoTexture = engine2d->getTextureManager()->acquire("textures/checker.png");
+    hasLastFrameBegin = false;
 
     deviceInfo.initialized_ = true;
     return true;
@@ -128,8 +176,10 @@ bool IsVulkanReady() {
 
 void DeleteVulkan() {
 
-    vkDestroySemaphore(deviceInfo.device_, renderInfo.imageAvailableSemaphore_, nullptr);
-    vkDestroyFence(deviceInfo.device_, renderInfo.renderFinishedFence_, nullptr);
+    // 等待所有在途帧执行完毕
+    vkDeviceWaitIdle(deviceInfo.device_);
+
+    DeleteSyncObjects(deviceInfo.device_, &renderInfo);
 
     vkFreeCommandBuffers(deviceInfo.device_, renderInfo.cmdPool_, renderInfo.cmdBuffer_.size(),
                          renderInfo.cmdBuffer_.data());
@@ -139,53 +189,145 @@ void DeleteVulkan() {
     vkDestroyRenderPass(deviceInfo.device_, renderInfo.renderPass_, nullptr);
     DeleteSwapChain(deviceInfo.device_, &swapchainInfo);
 
+    // 引擎中的编译任务与写回线程都使用管线缓存，先于其销毁
+    engine2d->getTextureManager()->release(demoTexture);
+    demoTexture.reset();
+    delete engine2d;
+    delete pipelineCacheSaveThread;
+    savePipelineCache(deviceInfo.device_, renderInfo.pipelineCache_, pipelineCachePath);
     vkDestroyPipelineCache(deviceInfo.device_, renderInfo.pipelineCache_, nullptr);
 
-    // TODO: 假设只有一个pipeline
-    vkDestroyPipeline(deviceInfo.device_, pipelineInfo.pipeline_, nullptr);
-    vkDestroyPipelineLayout(deviceInfo.device_, pipelineInfo.layout_, nullptr);
-
-    // 调用析构函数，释放VkBuffer与VkDeviceMemory
-    delete vertexBufferManager;
-    delete indexBufferManager;
-
     vkDestroyDevice(deviceInfo.device_, nullptr);
     vkDestroyInstance(deviceInfo.instance_, nullptr);
 
+    if (TraceIsEnabled()) {
+        TraceWriteChromeJson(traceFilePath);
+    }
+
     deviceInfo.initialized_ = false;
 }
 
+bool VulkanGetGpuProfile(GpuFrameProfile *profile) {
+    return engine2d->getGpuProfiler()->getLatestProfile(profile);
+}
+
+void VulkanGetFrameStats(FrameStatsSummary *summary) {
+    engine2d->getFrameStats()->getSummary(summary);
+}
+
+static double elapsedMs(std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+// 示例场景：屏幕中央的一个矩形，其上叠一张纹理；每帧在beginFrame()之后、recordRenderPass()之前提交
+static void submitDemoScene(Engine2D *engine) {
+    Engine2DFrame frame = engine->getFrame();
+    float width = frame.width_;
+    float height = frame.height_;
+    frame.rectBuffer_->drawRect(width / 4, height / 4, width / 2, height / 2, 0x034236FF);
+    frame.spriteBuffer_->drawTexture(demoTexture, width / 2 - 64, height / 2 - 64, 128, 128);
+}
+
+void VulkanWindowResized() {
+    swapchainOutOfDate = true;
+}
+
+// 重建交换链与framebuffer（旧交换链作为oldSwapchain传入）
+// render pass只依赖图像格式，管线的viewport/scissor是动态状态，旋转由投影完成，它们都不需要重建
+static bool RecreateSwapChain() {
+    VkSurfaceCapabilitiesKHR surfaceCapabilities;
+    CALL_VK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(deviceInfo.physicalDevice_, deviceInfo.surface_,
+                                                      &surfaceCapabilities));
+    // 窗口最小化时尺寸为0，无法创建交换链，等待下一次变化
+    if (surfaceCapabilities.currentExtent.width == 0 || surfaceCapabilities.currentExtent.height == 0) {
+        return false;
+    }
+
+    // 等待所有在途帧执行完毕，旧的framebuffer不再被使用
+    vkDeviceWaitIdle(deviceInfo.device_);
+
+    VkFormat oldFormat = swapchainInfo.displayFormat_;
+    VkSwapchainKHR oldSwapchain = swapchainInfo.swapchain_;
+    DeleteSwapChainFrameBuffers(deviceInfo.device_, &swapchainInfo);
+    getSwapChain(deviceInfo.surface_, deviceInfo.physicalDevice_, deviceInfo.queueFamilyIndex_, deviceInfo.device_,
+                 oldSwapchain, &swapchainInfo);
+    vkDestroySwapchainKHR(deviceInfo.device_, oldSwapchain, nullptr);
+    assert(swapchainInfo.displayFormat_ == oldFormat); // 格式固定为R8G8B8A8_UNORM，render pass可以沿用
+    (void) oldFormat;
+
+    getFrameBuffers(deviceInfo.device_, renderInfo.renderPass_, &swapchainInfo);
+    renderInfo.imagesInFlight_.assign(swapchainInfo.swapchainLength_, VK_NULL_HANDLE);
+
+    swapchainOutOfDate = false;
+    return true;
+}
+
 // Draw one frame
 bool VulkanDrawFrame(android_app *app) {
+    TRACE_SCOPE("VulkanDrawFrame");
+
+    // 本帧各时间段的耗时，没有完成的帧（如交换链过期）不计入统计
+    auto frameBegin = std::chrono::steady_clock::now();
+    FrameTimes frameTimes;
+    for (uint32_t i = 0; i < FRAME_INTERVAL_COUNT; i++) frameTimes.ms_[i] = -1;
+    frameTimes.ms_[FRAME_INTERVAL_FRAME] = hasLastFrameBegin ? elapsedMs(lastFrameBegin, frameBegin) : -1;
+    lastFrameBegin = frameBegin;
+    hasLastFrameBegin = true;
+
+    if (swapchainOutOfDate && !RecreateSwapChain()) {
+        return false;
+    }
+
+    // 当前在途帧
+    uint32_t frame = renderInfo.currentFrame_;
+    VkCommandBuffer cmdBuffer = renderInfo.cmdBuffer_[frame];
+
+    // 等待该在途帧上一次的提交执行完毕，之后才能复用它的指令缓冲与临时资源
+    TRACE_BEGIN("fence wait");
+    auto waitBegin = std::chrono::steady_clock::now();
+    CALL_VK(vkWaitForFences(deviceInfo.device_, 1, &renderInfo.inFlightFences_[frame], VK_TRUE, UINT64_MAX));
+    auto acquireBegin = std::chrono::steady_clock::now();
+    TRACE_END("fence wait");
 
     // 获取图片index
     uint32_t nextIndex;
     // Get the framebuffer index we should draw in
-    CALL_VK(vkAcquireNextImageKHR(deviceInfo.device_, swapchainInfo.swapchain_,
-                                  UINT64_MAX, renderInfo.imageAvailableSemaphore_, VK_NULL_HANDLE,
-                                  &nextIndex));
-    CALL_VK(vkResetFences(deviceInfo.device_, 1, &renderInfo.renderFinishedFence_));
+    // OUT_OF_DATE时交换链已不可用，重建后重试；SUBOPTIMAL时图像仍可使用，本帧照常绘制，之后再重建
+    TRACE_BEGIN("acquire");
+    VkResult acquireResult = vkAcquireNextImageKHR(deviceInfo.device_, swapchainInfo.swapchain_,
+                                                   UINT64_MAX, renderInfo.imageAvailableSemaphores_[frame],
+                                                   VK_NULL_HANDLE, &nextIndex);
+    auto acquireEnd = std::chrono::steady_clock::now();
+    TRACE_END("acquire");
+    if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR) {
+        swapchainOutOfDate = true;
+        return false;
+    }
+    if (acquireResult == VK_SUBOPTIMAL_KHR) {
+        swapchainOutOfDate = true;
+    } else {
+        CALL_VK(acquireResult);
+    }
 
-    // 填写绘制命令
-    // 首先，重置该帧在上次轮转时使用的资源
-    vkResetCommandBuffer(renderInfo.cmdBuffer_[nextIndex], 0);
-    vertexBufferManager->freeAllBuffers(nextIndex);
-    indexBufferManager->freeAllBuffers(nextIndex);
+    // 该图像可能仍被另一个在途帧使用（交换链图像数多于在途帧数时乱序返回）
+    if (renderInfo.imagesInFlight_[nextIndex] != VK_NULL_HANDLE) {
+        CALL_VK(vkWaitForFences(deviceInfo.device_, 1, &renderInfo.imagesInFlight_[nextIndex], VK_TRUE, UINT64_MAX));
+    }
+    auto recordBegin = std::chrono::steady_clock::now();
+    // 两次等待fence都算作fence wait
+    frameTimes.ms_[FRAME_INTERVAL_FENCE_WAIT] = elapsedMs(waitBegin, acquireBegin) + elapsedMs(acquireEnd, recordBegin);
+    frameTimes.ms_[FRAME_INTERVAL_ACQUIRE] = elapsedMs(acquireBegin, acquireEnd);
+    renderInfo.imagesInFlight_[nextIndex] = renderInfo.inFlightFences_[frame];
 
-//    vertexBufferManager->dump();
-//    indexBufferManager->dump();
+    CALL_VK(vkResetFences(deviceInfo.device_, 1, &renderInfo.inFlightFences_[frame]));
+    TRACE_BEGIN("record");
+
+    // 填写绘制命令
+    // 首先，重置该在途帧在上次轮转时使用的资源，再开始录制
+    engine2d->beginFrame(frame, cmdBuffer, swapchainInfo.logicalSize_);
 
-    // We create and declare the "beginning" our command buffer
-    VkCommandBufferBeginInfo cmdBufferBeginInfo{
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .pInheritanceInfo = nullptr,
-    };
-    CALL_VK(vkBeginCommandBuffer(renderInfo.cmdBuffer_[nextIndex],
-                                 &cmdBufferBeginInfo));
 //    // transition the display image to color attachment layout // TODO: 这里格式转换的必要性？
-//    setImageLayout(renderInfo.cmdBuffer_[nextIndex],
+//    setImageLayout(cmdBuffer,
 //                   swapchainInfo.displayImages_[nextIndex],
 //                   VK_IMAGE_LAYOUT_UNDEFINED,
 //                   VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
@@ -204,70 +346,80 @@ bool VulkanDrawFrame(android_app *app) {
                     .extent = swapchainInfo.displaySize_},
             .clearValueCount = 1,
             .pClearValues = &clearVals};
-    vkCmdBeginRenderPass(renderInfo.cmdBuffer_[nextIndex], &renderPassBeginInfo,
-                         VK_SUBPASS_CONTENTS_INLINE);
-
-    // Bind what is necessary to the command buffer
-    vkCmdBindPipeline(renderInfo.cmdBuffer_[nextIndex],
-                      VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineInfo.pipeline_);
-
-    // 获取并填充VkBuffer////////////////////////TODO: 移入2d引擎中
-    const float vertexData[] = {-0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5};
-    VulkanBufferInfo vertexBufferInfo = vertexBufferManager->allocBuffer(nextIndex, sizeof(vertexData));
-    void *data;
-    vkMapMemory(deviceInfo.device_, vertexBufferInfo.bufferMemory_, 0, sizeof(vertexData),0, &data);
-    memcpy(data, vertexData, sizeof(vertexData));
-    vkUnmapMemory(deviceInfo.device_, vertexBufferInfo.bufferMemory_);
-    ///////////////////////////////////////////////////////////////////////////
-    VkDeviceSize offset = 0;
-    vkCmdBindVertexBuffers(renderInfo.cmdBuffer_[nextIndex], 0, 1,
-                           &vertexBufferInfo.buffer_, &offset);
-
-    // 获取并填充VkBuffer////////////////////////TODO: 移入2d引擎中
-    const uint16_t indexData[] = {0, 1, 2, 2, 3, 0};
-    VulkanBufferInfo indexBufferInfo = indexBufferManager->allocBuffer(nextIndex, sizeof(indexData));
-    vkMapMemory(deviceInfo.device_, indexBufferInfo.bufferMemory_, 0, sizeof(indexData),0, &data);
-    memcpy(data, indexData, sizeof(indexData));
-    vkUnmapMemory(deviceInfo.device_, indexBufferInfo.bufferMemory_);
-    ///////////////////////////////////////////////////////////////////////////
-
-    vkCmdBindIndexBuffer(renderInfo.cmdBuffer_[nextIndex], indexBufferInfo.buffer_, 0, VK_INDEX_TYPE_UINT16);
-    // Draw Triangle
-    vkCmdDrawIndexed(renderInfo.cmdBuffer_[nextIndex], 6, 1, 0, 0, 0);
-
-    vkCmdEndRenderPass(renderInfo.cmdBuffer_[nextIndex]);
-
-    CALL_VK(vkEndCommandBuffer(renderInfo.cmdBuffer_[nextIndex]));
-
-
-    // 提交指令
+    submitDemoScene(engine2d);
+
+    engine2d->recordRenderPass(cmdBuffer, renderPassBeginInfo, swapchainInfo.pretransform_);
+    engine2d->endFrame(cmdBuffer);
+    auto submitBegin = std::chrono::steady_clock::now();
+    TRACE_END("record");
+
+
+    // 提交指令：等待图像可用，完成后signal渲染完成信号量与该在途帧的fence
     VkPipelineStageFlags waitStageMask =
             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     VkSubmitInfo submit_info = {.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
             .pNext = nullptr,
             .waitSemaphoreCount = 1,
-            .pWaitSemaphores = &renderInfo.imageAvailableSemaphore_,
+            .pWaitSemaphores = &renderInfo.imageAvailableSemaphores_[frame],
             .pWaitDstStageMask = &waitStageMask,
             .commandBufferCount = 1,
-            .pCommandBuffers = &renderInfo.cmdBuffer_[nextIndex],
-            .signalSemaphoreCount = 0,
-            .pSignalSemaphores = nullptr};
-    CALL_VK(vkQueueSubmit(deviceInfo.queue_, 1, &submit_info, renderInfo.renderFinishedFence_));
-    // Wait timeout set to 1 second
-    CALL_VK(vkWaitForFences(deviceInfo.device_, 1, &renderInfo.renderFinishedFence_, VK_TRUE, 1000000000));
-
-    // 递交显示
+            .pCommandBuffers = &cmdBuffer,
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = &renderInfo.renderFinishedSemaphores_[frame]};
+    // 本帧新建的静态缓冲先提交复制（同一队列时排在本帧之前）
+    engine2d->submit(deviceInfo.queue_, submit_info, renderInfo.inFlightFences_[frame]);
+    auto presentBegin = std::chrono::steady_clock::now();
+
+    // 递交显示：在GPU上等待渲染完成信号量，CPU不再阻塞
     VkResult result;
     VkPresentInfoKHR presentInfo{
             .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
             .pNext = nullptr,
-            .waitSemaphoreCount = 0,
-            .pWaitSemaphores = nullptr,
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores = &renderInfo.renderFinishedSemaphores_[frame],
             .swapchainCount = 1,
             .pSwapchains = &swapchainInfo.swapchain_,
             .pImageIndices = &nextIndex,
             .pResults = &result,
     };
-    vkQueuePresentKHR(deviceInfo.queue_, &presentInfo);
+    TRACE_BEGIN("present");
+    VkResult presentResult = vkQueuePresentKHR(deviceInfo.queue_, &presentInfo);
+    auto presentEnd = std::chrono::steady_clock::now();
+    TRACE_END("present");
+    if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR) {
+        swapchainOutOfDate = true;
+    }
+
+    renderInfo.currentFrame_ = (frame + 1) % renderInfo.framesInFlight_;
+
+    frameTimes.ms_[FRAME_INTERVAL_RECORD] = elapsedMs(recordBegin, submitBegin);
+    frameTimes.ms_[FRAME_INTERVAL_SUBMIT] = elapsedMs(submitBegin, presentBegin);
+    frameTimes.ms_[FRAME_INTERVAL_PRESENT] = elapsedMs(presentBegin, presentEnd);
+    FrameStats *frameStats = engine2d->getFrameStats();
+    frameStats->addFrame(frameTimes);
+
+    // 定期打印帧时间统计，每个窗口单独统计
+    // 打开打点（debug.prf.trace）时一并打印GPU区间、缓冲与设备内存的状态
+    if ((frameCount + 1) % FRAME_STATS_DUMP_FRAMES == 0) {
+        frameStats->dump();
+        frameStats->reset();
+        if (TraceIsEnabled()) engine2d->dump();
+    }
+
+    // 定期检查管线缓存，有新的管线编译进来时写回磁盘（进程可能被系统直接杀死，等不到DeleteVulkan）
+    // 读取缓存数据与写文件都在写回线程上（vkGetPipelineCacheData不需要与编译线程外部同步），上一次还没写完时跳过
+    if (++frameCount % PIPELINE_CACHE_CHECKPOINT_FRAMES == 0 && !pipelineCacheSavePending.exchange(true)) {
+        VkDevice device = deviceInfo.device_;
+        VkPipelineCache pipelineCache = renderInfo.pipelineCache_;
+        pipelineCacheSaveThread->post([device, pipelineCache] {
+            TRACE_SCOPE("pipeline cache checkpoint");
+            size_t cacheSize = 0;
+            CALL_VK(vkGetPipelineCacheData(device, pipelineCache, &cacheSize, nullptr));
+            if (cacheSize != pipelineCacheSavedSize) {
+                pipelineCacheSavedSize = savePipelineCache(device, pipelineCache, pipelineCachePath);
+            }
+            pipelineCacheSavePending.store(false);
+        });
+    }
     return true;
 }
@@ -16,6 +16,9 @@
 
 #include <game-activity/native_app_glue/android_native_app_glue.h>
 
+#include "engine2d/GpuProfiler.h"
+#include "engine2d/FrameStats.h"
+
 // Initialize vulkan device context
 // after return, vulkan is ready to draw
 bool InitVulkan(android_app* app);
@@ -26,9 +29,20 @@ void DeleteVulkan();
 // Check if vulkan is ready to draw
 bool IsVulkanReady();
 
+// window size or orientation changed, recreate the swapchain before the next frame
+void VulkanWindowResized();
+
 // Ask Vulkan to Render a frame
 bool VulkanDrawFrame(android_app* app);
 
+// GPU timings of the latest resolved frame (framesInFlight frames behind),
+// false if none yet or timestamps are not supported
+bool VulkanGetGpuProfile(GpuFrameProfile* profile);
+
+// Frame time percentiles of the current statistics window
+// (a new window starts after every periodic dump to the log)
+void VulkanGetFrameStats(FrameStatsSummary* summary);
+
 #endif // VULKAN_MAIN_HPP
 
 
@@ -0,0 +1,136 @@
+//
+// Created by richardwu on 11/14/24.
+//
+// DrawList排序的暴力校验：对随机的绘制序列，逐对检查排序后的顺序是否保持了需要保持的先后
+//
+//   drawlist_check [--iterations N] [--seed S]
+//
+// 每次迭代在一个小的区域内生成随机的绘制（layer、pipeline、texture取值很少，重叠与同状态都很多；
+// 包括负的宽高与零面积的绘制），sort()之后检查：
+// - getOrder()是一个排列，getKeys()不减，且与对应绘制的layer、pipeline、texture一致
+// - 不同layer之间按layer的顺序
+// - 两个绘制的范围相交（面积大于0）时，先提交的仍在前面（不论状态是否相同）
+// - 键相同的绘制保持提交的顺序（稳定），sort()的返回值与顺序是否改变一致
+// 有不符时打印第一处并返回1；只依赖DrawList.cpp，不需要vulkan
+
+#include "../engine2d/DrawList.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// 固定种子的线性同余发生器，与engine2d_bench相同
+struct Random {
+    uint32_t state_;
+
+    uint32_t next() {
+        state_ = state_ * 1664525u + 1013904223u;
+        return state_;
+    }
+    float nextFloat(float min, float max) { return min + (next() >> 8) * ((max - min) / 16777216.0f); }
+};
+
+struct Draw {
+    uint32_t layer_, pipeline_, texture_;
+    float x0_, y0_, x1_, y1_; // 规范化后的范围
+};
+
+static bool overlaps(const Draw &a, const Draw &b) {
+    return a.x0_ < b.x1_ && b.x0_ < a.x1_ && a.y0_ < b.y1_ && b.y0_ < a.y1_;
+}
+
+static bool fail(uint32_t iteration, const char *message, uint32_t a, uint32_t b) {
+    fprintf(stderr, "iteration %u: %s (draws %u and %u)\n", iteration, message, a, b);
+    return false;
+}
+
+static bool checkIteration(DrawList &drawList, Random &random, uint32_t iteration) {
+    // 绘制数、状态的种类与区域大小都随迭代变化，覆盖几乎不重叠到全部重叠的情况
+    const uint32_t count = iteration % 257;
+    const uint32_t layers = 1 + random.next() % 3, pipelines = 1 + random.next() % 4, textures = 1 + random.next() % 4;
+    const float extent = random.nextFloat(64.0f, 2048.0f);
+
+    std::vector<Draw> draws(count);
+    drawList.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        Draw &draw = draws[i];
+        draw.layer_ = random.next() % layers;
+        draw.pipeline_ = random.next() % pipelines;
+        draw.texture_ = random.next() % textures;
+        float x = random.nextFloat(-64.0f, extent), y = random.nextFloat(-64.0f, extent);
+        float w = random.nextFloat(-128.0f, 128.0f), h = random.nextFloat(-128.0f, 128.0f);
+        if (random.next() % 16 == 0) w = 0.0f; // 零面积
+        draw.x0_ = std::min(x, x + w);
+        draw.y0_ = std::min(y, y + h);
+        draw.x1_ = std::max(x, x + w);
+        draw.y1_ = std::max(y, y + h);
+        drawList.add(draw.layer_, draw.pipeline_, draw.texture_, x, y, w, h);
+    }
+    bool reordered = drawList.sort();
+
+    if (drawList.getSize() != count) return fail(iteration, "size differs from the number of draws", 0, 0);
+    const uint64_t *keys = drawList.getKeys();
+    const uint32_t *order = drawList.getOrder();
+    std::vector<uint32_t> position(count, UINT32_MAX); // 提交的下标 -> 排序后的位置
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t index = order[i];
+        if (index >= count || position[index] != UINT32_MAX) return fail(iteration, "order is not a permutation", i, index);
+        position[index] = i;
+        const Draw &draw = draws[index];
+        if (DrawList::getKeyLayer(keys[i]) != draw.layer_ || DrawList::getKeyPipeline(keys[i]) != draw.pipeline_ ||
+            DrawList::getKeyTexture(keys[i]) != draw.texture_) {
+            return fail(iteration, "key does not match the draw", index, index);
+        }
+        if (DrawList::getKeyDepth(keys[i]) >= drawList.getDepthCount()) {
+            return fail(iteration, "depth is not below getDepthCount()", index, index);
+        }
+        if (i > 0 && keys[i - 1] > keys[i]) return fail(iteration, "keys are not sorted", order[i - 1], index);
+        if (i > 0 && keys[i - 1] == keys[i] && order[i - 1] > index) {
+            return fail(iteration, "equal keys are not in submission order", order[i - 1], index);
+        }
+    }
+    if (reordered != (count > 0 && !std::is_sorted(order, order + count))) {
+        return fail(iteration, "sort() return value does not match the order", 0, 0);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        for (uint32_t j = i + 1; j < count; j++) {
+            if (draws[i].layer_ != draws[j].layer_) {
+                if ((draws[i].layer_ < draws[j].layer_) != (position[i] < position[j])) {
+                    return fail(iteration, "layers are out of order", i, j);
+                }
+            } else if (overlaps(draws[i], draws[j]) && position[i] > position[j]) {
+                return fail(iteration, "overlapping draws are out of submission order", i, j);
+            }
+        }
+    }
+    return true;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [--iterations N] [--seed S]\n", argv0);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = 1000, seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) usage(argv[0]);
+        const char *arg = argv[i];
+        const char *value = argv[++i];
+        if (!strcmp(arg, "--iterations")) iterations = strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--seed")) seed = strtoul(value, nullptr, 10);
+        else usage(argv[0]);
+    }
+
+    Random random{seed};
+    DrawList drawList; // 跨迭代复用，同时检查clear()
+    for (uint32_t i = 0; i < iterations; i++) {
+        if (!checkIteration(drawList, random, i)) return 1;
+    }
+    printf("draw list order is preserved for overlapping draws over %u iterations\n", iterations);
+    return 0;
+}
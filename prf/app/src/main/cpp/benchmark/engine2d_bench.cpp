@@ -0,0 +1,392 @@
+//
+// Created by richardwu on 11/6/24.
+//
+// engine2d吞吐量测试：在headless后端上运行参数化的场景，每个场景输出一行JSON（JSON Lines）到stdout
+//
+//   engine2d_bench [--scene rects|blend|uploads|world|sprites|all] [--count N] [--frames F] [--warmup W]
+//                  [--width W] [--height H] [--assets DIR] [--seed S] [--driver system|null]
+//                  [--trace FILE]
+//
+// --driver null使用进程内的空驱动（vulkan_null.h），不需要GPU与ICD，只测量CPU侧的开销，
+// 此时还会输出每帧的vulkan调用次数
+// --trace将引擎中的打点（Trace.h）写为Chrome trace-event JSON，可在chrome://tracing或Perfetto UI中打开
+//
+// 场景内容由固定种子的伪随机数生成，同样的参数每次得到同样的绘制序列
+
+#include "../HeadlessMain.hpp"
+#include "../engine2d/Trace.h"
+#include "../engine2d/SpatialGrid.h"
+
+#include <vulkan_null.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifndef PRF_HEADLESS_ASSET_DIR
+#define PRF_HEADLESS_ASSET_DIR "assets"
+#endif
+
+// ============================ 堆分配计数 ============================
+
+static std::atomic<uint64_t> heapAllocCount(0);
+
+void *operator new(size_t size) {
+    heapAllocCount.fetch_add(1, std::memory_order_relaxed);
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new[](size_t size) {
+    heapAllocCount.fetch_add(1, std::memory_order_relaxed);
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
+
+// ============================ 场景 ============================
+
+struct BenchConfig {
+    std::string scene_;
+    uint32_t count_;
+    uint32_t frames_;
+    uint32_t warmup_;
+    uint32_t width_;
+    uint32_t height_;
+    std::string assetDir_;
+    uint32_t seed_;
+    bool nullDriver_;
+    std::string traceFile_; // 为空时不打点
+};
+
+// 固定种子的线性同余发生器（不依赖标准库实现，跨平台结果一致）
+struct Random {
+    uint32_t state_;
+
+    uint32_t next() {
+        state_ = state_ * 1664525u + 1013904223u;
+        return state_;
+    }
+    float nextFloat(float max) { return (next() >> 8) * (max / 16777216.0f); }
+};
+
+struct SceneRect {
+    float x_, y_, w_, h_;
+    uint32_t color_;
+    BlendMode blendMode_;
+};
+
+static std::vector<SceneRect> makeRects(const BenchConfig &config, bool mixedBlend) {
+    Random random{config.seed_};
+    std::vector<SceneRect> rects(config.count_);
+    for (uint32_t i = 0; i < config.count_; i++) {
+        SceneRect &rect = rects[i];
+        rect.w_ = 4.0f + random.nextFloat(60.0f);
+        rect.h_ = 4.0f + random.nextFloat(60.0f);
+        rect.x_ = random.nextFloat(config.width_ - rect.w_);
+        rect.y_ = random.nextFloat(config.height_ - rect.h_);
+        rect.color_ = random.next() | 0x80u; // alpha至少0x80
+        // 混合方式每64个矩形切换一次，模拟UI中分段的绘制顺序
+        rect.blendMode_ = mixedBlend ? (BlendMode) ((i / 64) % BLEND_MODE_COUNT) : BLEND_MODE_OPAQUE;
+    }
+    return rects;
+}
+
+static HeadlessSceneFunc makeScene(const BenchConfig &config, const std::string &name) {
+    if (name == "rects" || name == "blend") {
+        // N个纯色矩形（不混合）/ N个矩形轮流使用各种混合方式
+        std::vector<SceneRect> rects = makeRects(config, name == "blend");
+        return [rects](const HeadlessFrame &frame) {
+            for (auto iter = rects.begin(); iter != rects.end(); iter++) {
+                frame.rectBuffer_->setBlendMode(iter->blendMode_);
+                frame.rectBuffer_->drawRect(iter->x_, iter->y_, iter->w_, iter->h_, iter->color_);
+            }
+        };
+    }
+    if (name == "world") {
+        // 大场景：N个矩形分布在16倍屏幕面积的世界中，相机每帧平移，并移动其中1%的矩形；
+        // 以SpatialGrid查询视口内的矩形，只提交可见的部分
+        struct WorldState {
+            SpatialGrid grid_;
+            std::vector<SceneRect> rects_; // 没有删除，按grid_中的编号索引
+            std::vector<uint32_t> visible_;
+            Random random_;
+            uint32_t frame_;
+        };
+        std::shared_ptr<WorldState> state = std::make_shared<WorldState>();
+        const float worldWidth = config.width_ * 4.0f, worldHeight = config.height_ * 4.0f;
+        BenchConfig worldConfig = config;
+        worldConfig.width_ = (uint32_t) worldWidth;
+        worldConfig.height_ = (uint32_t) worldHeight;
+        state->rects_ = makeRects(worldConfig, false);
+        for (uint32_t i = 0; i < state->rects_.size(); i++) {
+            const SceneRect &rect = state->rects_[i];
+            state->grid_.insert(SpatialRect{rect.x_, rect.y_, rect.w_, rect.h_}, i);
+        }
+        state->random_ = Random{config.seed_ + 1};
+        state->frame_ = 0;
+        return [state, worldWidth, worldHeight](const HeadlessFrame &frame) {
+            WorldState &world = *state;
+            for (uint32_t i = 0; i < world.rects_.size() / 100; i++) {
+                uint32_t id = world.random_.next() % world.rects_.size();
+                SceneRect &rect = world.rects_[id];
+                rect.x_ = std::min(std::max(rect.x_ + world.random_.nextFloat(16.0f) - 8.0f, 0.0f), worldWidth - rect.w_);
+                rect.y_ = std::min(std::max(rect.y_ + world.random_.nextFloat(16.0f) - 8.0f, 0.0f), worldHeight - rect.h_);
+                world.grid_.move(id, SpatialRect{rect.x_, rect.y_, rect.w_, rect.h_});
+            }
+
+            // 相机沿对角线往返平移
+            float cameraX = (float) (world.frame_ * 4 % (uint32_t) (worldWidth - frame.width_));
+            float cameraY = (float) (world.frame_ * 2 % (uint32_t) (worldHeight - frame.height_));
+            world.frame_++;
+            SpatialRect view;
+            frame.rectBuffer_->getCullRect(&view);
+            view.x_ += cameraX;
+            view.y_ += cameraY;
+            world.visible_.clear();
+            world.grid_.query(view, &world.visible_);
+            for (auto iter = world.visible_.begin(); iter != world.visible_.end(); iter++) {
+                const SceneRect &rect = world.rects_[*iter];
+                frame.rectBuffer_->drawRect(rect.x_ - cameraX, rect.y_ - cameraY, rect.w_, rect.h_, rect.color_);
+            }
+        };
+    }
+    if (name == "sprites") {
+        // N个带纹理的精灵：每8个中有1个采样整张纹理（TextureManager），其余取自图集中的SPRITE_ICONS种小图，
+        // 部分镜像、部分半透明；图集与纹理在第一帧时插入与请求，预热期间完成解码与上传
+        static const uint32_t SPRITE_ICONS = 64;
+        struct SpriteState {
+            std::vector<SceneRect> sprites_;
+            std::vector<uint32_t> icons_; // 每个精灵使用的小图，UINT32_MAX为整张纹理
+            std::vector<AtlasSpriteHandle> atlasSprites_;
+            TextureHandle texture_;
+            TextureAtlas *textureAtlas_;
+            TextureManager *textureManager_;
+
+            ~SpriteState() {
+                // 场景结束时（仍在渲染线程上）归还引用，之后由图集按LRU淘汰、纹理在在途帧结束后销毁
+                for (auto iter = atlasSprites_.begin(); iter != atlasSprites_.end(); iter++) {
+                    if (*iter) textureAtlas_->release(*iter);
+                }
+                if (texture_) textureManager_->release(texture_);
+            }
+        };
+        std::shared_ptr<SpriteState> state = std::make_shared<SpriteState>();
+        state->sprites_ = makeRects(config, false);
+        Random random{config.seed_ + 2};
+        for (uint32_t i = 0; i < config.count_; i++) {
+            SceneRect &sprite = state->sprites_[i];
+            if (random.next() % 4 == 0) sprite.w_ = -sprite.w_; // 水平镜像，x为右边缘
+            if (sprite.w_ < 0) sprite.x_ -= sprite.w_;
+            sprite.color_ = random.next() % 2 ? 0xFFFFFFFF : 0xFFFFFF80;
+            state->icons_.push_back(i % 8 == 0 ? UINT32_MAX : random.next() % SPRITE_ICONS);
+        }
+        state->textureAtlas_ = nullptr;
+        state->textureManager_ = nullptr;
+        uint32_t seed = config.seed_;
+        return [state, seed](const HeadlessFrame &frame) {
+            SpriteState &sprites = *state;
+            if (!sprites.textureAtlas_) {
+                sprites.textureAtlas_ = frame.textureAtlas_;
+                sprites.textureManager_ = frame.textureManager_;
+                sprites.texture_ = frame.textureManager_->acquire("textures/checker.png");
+                // 程序生成的小图：8~48像素见方的圆，颜色随机，圆外透明
+                Random random{seed + 3};
+                std::vector<uint32_t> pixels;
+                for (uint32_t icon = 0; icon < SPRITE_ICONS; icon++) {
+                    uint32_t size = 8 + random.next() % 41;
+                    uint32_t color = random.next() | 0xFF000000u; // 内存中依次为R、G、B、A
+                    pixels.assign(size * size, 0);
+                    float radius = size * 0.5f;
+                    for (uint32_t y = 0; y < size; y++) {
+                        for (uint32_t x = 0; x < size; x++) {
+                            float dx = x + 0.5f - radius, dy = y + 0.5f - radius;
+                            if (dx * dx + dy * dy <= radius * radius) pixels[y * size + x] = color;
+                        }
+                    }
+                    sprites.atlasSprites_.push_back(frame.textureAtlas_->insert(
+                            "icon" + std::to_string(icon), pixels.data(), size, size));
+                }
+            }
+            for (uint32_t i = 0; i < sprites.sprites_.size(); i++) {
+                const SceneRect &sprite = sprites.sprites_[i];
+                if (sprites.icons_[i] == UINT32_MAX) {
+                    frame.spriteBuffer_->drawTexture(sprites.texture_, sprite.x_, sprite.y_, sprite.w_, sprite.h_,
+                                                     sprite.color_);
+                } else {
+                    frame.spriteBuffer_->drawSprite(sprites.atlasSprites_[sprites.icons_[i]], sprite.x_, sprite.y_,
+                                                    sprite.w_, sprite.h_, sprite.color_);
+                }
+            }
+        };
+    }
+    if (name == "uploads") {
+        // 每帧通过BufferManager做N次小的上传（16~256字节），衡量缓冲复用与映射写入的开销
+        Random random{config.seed_};
+        std::vector<uint32_t> sizes(config.count_);
+        for (uint32_t i = 0; i < config.count_; i++) sizes[i] = 16 + random.next() % 241;
+        std::vector<char> payload(256, 0x5a);
+        return [sizes, payload](const HeadlessFrame &frame) {
+            for (auto iter = sizes.begin(); iter != sizes.end(); iter++) {
+                VulkanBufferInfo bufferInfo = frame.vertexBufferManager_->allocBuffer(frame.frameIndex_, *iter);
+                memcpy(bufferInfo.memory_.mapped_, payload.data(), *iter);
+            }
+        };
+    }
+    return nullptr;
+}
+
+// ============================ 测量 ============================
+
+struct Summary {
+    double min_, mean_, max_;
+};
+
+static Summary summarize(const std::vector<double> &samples) {
+    Summary summary{0, 0, 0};
+    if (samples.empty()) return summary;
+    summary.min_ = summary.max_ = samples[0];
+    for (auto value: samples) {
+        summary.mean_ += value;
+        if (value < summary.min_) summary.min_ = value;
+        if (value > summary.max_) summary.max_ = value;
+    }
+    summary.mean_ /= samples.size();
+    return summary;
+}
+
+static void printSummary(const char *name, const Summary &summary) {
+    printf("\"%s\":{\"min\":%.4f,\"mean\":%.4f,\"max\":%.4f},", name, summary.min_, summary.mean_, summary.max_);
+}
+
+static void runScene(const BenchConfig &config, const std::string &name) {
+    HeadlessSceneFunc scene = makeScene(config, name);
+    if (!scene) {
+        fprintf(stderr, "unknown scene: %s\n", name.c_str());
+        exit(1);
+    }
+
+    for (uint32_t i = 0; i < config.warmup_; i++) HeadlessDrawFrame(scene);
+    HeadlessWaitIdle();
+
+    // 吞吐：多帧在途，与真实的帧循环一致
+    std::vector<double> recordMs, submitMs, fenceWaitMs, gpuMs;
+    recordMs.reserve(config.frames_);
+    submitMs.reserve(config.frames_);
+    fenceWaitMs.reserve(config.frames_);
+    gpuMs.reserve(config.frames_);
+    // GPU计时晚framesInFlight帧读回，按帧号去重；预热后先取一次，使之后的拷贝不再分配
+    GpuFrameProfile gpuProfile;
+    uint64_t lastGpuFrame = HeadlessGetGpuProfile(&gpuProfile) ? gpuProfile.frameNumber_ : UINT64_MAX;
+    HeadlessResetFrameStats();
+    uint64_t allocsBegin = heapAllocCount.load();
+    uint64_t vkCallsBegin = config.nullDriver_ ? VulkanNullGetTotalCallCount() : 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < config.frames_; i++) {
+        HeadlessFrameStats stats;
+        HeadlessDrawFrame(scene, &stats);
+        recordMs.push_back(stats.recordMs_);
+        submitMs.push_back(stats.submitMs_);
+        fenceWaitMs.push_back(stats.fenceWaitMs_);
+        if (HeadlessGetGpuProfile(&gpuProfile) && gpuProfile.frameNumber_ != lastGpuFrame) {
+            gpuMs.push_back(gpuProfile.totalNs_ / 1e6);
+            lastGpuFrame = gpuProfile.frameNumber_;
+        }
+    }
+    HeadlessWaitIdle();
+    double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    uint64_t allocs = heapAllocCount.load() - allocsBegin;
+    uint64_t vkCalls = config.nullDriver_ ? VulkanNullGetTotalCallCount() - vkCallsBegin : 0;
+    FrameStatsSummary frameStats;
+    HeadlessGetFrameStats(&frameStats);
+
+    // 延迟：每帧提交后等待GPU完成，得到提交到完成的时间（此时没有帧重叠）
+    std::vector<double> completeMs;
+    completeMs.reserve(config.frames_);
+    for (uint32_t i = 0; i < config.frames_; i++) {
+        HeadlessDrawFrame(scene);
+        auto submitted = std::chrono::steady_clock::now();
+        HeadlessWaitIdle();
+        completeMs.push_back(std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - submitted).count());
+    }
+
+    printf("{\"scene\":\"%s\",\"driver\":\"%s\",\"count\":%u,\"frames\":%u,\"width\":%u,\"height\":%u,"
+           "\"seed\":%u,", name.c_str(), config.nullDriver_ ? "null" : "system", config.count_, config.frames_,
+           config.width_, config.height_, config.seed_);
+    printf("\"fps\":%.2f,", config.frames_ * 1000.0 / totalMs);
+    printSummary("record_ms", summarize(recordMs));
+    printSummary("submit_ms", summarize(submitMs));
+    printSummary("fence_wait_ms", summarize(fenceWaitMs));
+    printSummary("submit_to_complete_ms", summarize(completeMs));
+    if (!gpuMs.empty()) printSummary("gpu_ms", summarize(gpuMs));
+    const FrameIntervalSummary &frameInterval = frameStats.intervals_[FRAME_INTERVAL_FRAME];
+    printf("\"frame_ms\":{\"p50\":%.4f,\"p90\":%.4f,\"p99\":%.4f,\"max\":%.4f},\"over_budget_frames\":%llu,",
+           frameInterval.p50Ms_, frameInterval.p90Ms_, frameInterval.p99Ms_, frameInterval.maxMs_,
+           (unsigned long long) frameStats.overBudgetFrames_);
+    if (config.nullDriver_) printf("\"vk_calls_per_frame\":%.2f,", (double) vkCalls / config.frames_);
+    // 测量数组都已预留空间，计数中只有引擎与场景本身的分配
+    printf("\"heap_allocs_per_frame\":%.2f,\"device_memory_blocks\":%u}\n",
+           (double) allocs / config.frames_, HeadlessGetDeviceAllocationCount());
+    fflush(stdout);
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [--scene rects|blend|uploads|world|sprites|all] [--count N] [--frames F]\n"
+                    "          [--warmup W] [--width W] [--height H] [--assets DIR] [--seed S]\n"
+                    "          [--driver system|null] [--trace FILE]\n", argv0);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    BenchConfig config{"all", 10000, 300, 30, 1280, 720, PRF_HEADLESS_ASSET_DIR, 1, false, ""};
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) usage(argv[0]);
+        const char *arg = argv[i];
+        const char *value = argv[++i];
+        if (!strcmp(arg, "--scene")) config.scene_ = value;
+        else if (!strcmp(arg, "--count")) config.count_ = strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--frames")) config.frames_ = strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--warmup")) config.warmup_ = strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--width")) config.width_ = strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--height")) config.height_ = strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--assets")) config.assetDir_ = value;
+        else if (!strcmp(arg, "--seed")) config.seed_ = strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--driver") && !strcmp(value, "null")) config.nullDriver_ = true;
+        else if (!strcmp(arg, "--driver") && !strcmp(value, "system")) config.nullDriver_ = false;
+        else if (!strcmp(arg, "--trace")) config.traceFile_ = value;
+        else usage(argv[0]);
+    }
+    if (config.frames_ == 0 || config.width_ == 0 || config.height_ == 0) usage(argv[0]);
+
+    if (!config.traceFile_.empty()) {
+        TraceSetEnabled(true);
+        TraceSetThreadName("main");
+    }
+    if (!InitVulkanHeadless(config.width_, config.height_, config.assetDir_, config.nullDriver_)) return 1;
+
+    if (config.scene_ == "all") {
+        const char *scenes[] = {"rects", "blend", "uploads", "world", "sprites"};
+        for (auto scene: scenes) runScene(config, scene);
+    } else {
+        runScene(config, config.scene_);
+    }
+
+    DeleteVulkanHeadless();
+    if (!config.traceFile_.empty() && !TraceWriteChromeJson(config.traceFile_)) return 1;
+    return 0;
+}
@@ -0,0 +1,110 @@
+//
+// Created by richardwu on 11/14/24.
+//
+// geometry_kernels的等价性校验：SIMD路径（NEON/SSE2/SSSE3）的输出必须与标量实现逐字节相同
+//
+//   geometry_kernels_check [--iterations N] [--seed S]
+//
+// 每次迭代生成随机的输入（数量不是4的整数倍，覆盖SIMD之后余下的标量部分）与随机的仿射变换，
+// 比较interleaveRects()/expandSprites()与对应的*Reference()，有不同时打印第一处并返回1
+// 只依赖geometry_kernels.cpp，不需要vulkan
+
+#include "../engine2d/geometry_kernels.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// 固定种子的线性同余发生器，与engine2d_bench相同
+struct Random {
+    uint32_t state_;
+
+    uint32_t next() {
+        state_ = state_ * 1664525u + 1013904223u;
+        return state_;
+    }
+    float nextFloat(float min, float max) { return min + (next() >> 8) * ((max - min) / 16777216.0f); }
+};
+
+static bool compare(const char *name, uint32_t count, const std::vector<char> &actual,
+                    const std::vector<char> &expected, size_t stride) {
+    for (size_t i = 0; i < actual.size(); i++) {
+        if (actual[i] != expected[i]) {
+            fprintf(stderr, "%s (%s): count %u, element %u differs at byte %u\n", name, getGeometryKernelIsa(),
+                    count, (uint32_t) (i / stride), (uint32_t) (i % stride));
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool checkInterleaveRects(Random &random, uint32_t count) {
+    std::vector<float> x(count), y(count), w(count), h(count);
+    std::vector<uint32_t> rgba(count);
+    for (uint32_t i = 0; i < count; i++) {
+        x[i] = random.nextFloat(-4096.0f, 4096.0f);
+        y[i] = random.nextFloat(-4096.0f, 4096.0f);
+        w[i] = random.nextFloat(0.0f, 512.0f);
+        h[i] = random.nextFloat(0.0f, 512.0f);
+        rgba[i] = random.next();
+    }
+    // 输出只要求4字节对齐，偏移4字节，与环形缓冲中的分配一致
+    std::vector<char> actual(count * 20 + 4), expected(count * 20 + 4);
+    interleaveRects(x.data(), y.data(), w.data(), h.data(), rgba.data(), count, actual.data() + 4);
+    interleaveRectsReference(x.data(), y.data(), w.data(), h.data(), rgba.data(), count, expected.data() + 4);
+    return compare("interleaveRects", count, actual, expected, 20);
+}
+
+static bool checkExpandSprites(Random &random, uint32_t count) {
+    std::vector<float> x(count), y(count), w(count), h(count), u0(count), v0(count), u1(count), v1(count);
+    std::vector<uint32_t> rgba(count);
+    for (uint32_t i = 0; i < count; i++) {
+        x[i] = random.nextFloat(-4096.0f, 4096.0f);
+        y[i] = random.nextFloat(-4096.0f, 4096.0f);
+        w[i] = random.nextFloat(-512.0f, 512.0f); // 负的尺寸即镜像
+        h[i] = random.nextFloat(-512.0f, 512.0f);
+        u0[i] = random.nextFloat(0.0f, 1.0f);
+        v0[i] = random.nextFloat(0.0f, 1.0f);
+        u1[i] = random.nextFloat(0.0f, 1.0f);
+        v1[i] = random.nextFloat(0.0f, 1.0f);
+        rgba[i] = random.next();
+    }
+    SpriteBatchSoA batch{x.data(), y.data(), w.data(), h.data(), u0.data(), v0.data(), u1.data(), v1.data(),
+                         rgba.data()};
+    // 非单位的变换：a*x + c*y + tx中的舍入顺序不同时才会出现差异
+    Affine2D m{random.nextFloat(-2.0f, 2.0f), random.nextFloat(-2.0f, 2.0f), random.nextFloat(-2.0f, 2.0f),
+               random.nextFloat(-2.0f, 2.0f), random.nextFloat(-1000.0f, 1000.0f),
+               random.nextFloat(-1000.0f, 1000.0f)};
+    std::vector<char> actual(count * 4 * sizeof(SpriteVertex)), expected(count * 4 * sizeof(SpriteVertex));
+    expandSprites(batch, count, m, (SpriteVertex *) actual.data());
+    expandSpritesReference(batch, count, m, (SpriteVertex *) expected.data());
+    return compare("expandSprites", count, actual, expected, sizeof(SpriteVertex));
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [--iterations N] [--seed S]\n", argv0);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = 1000, seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) usage(argv[0]);
+        const char *arg = argv[i];
+        const char *value = argv[++i];
+        if (!strcmp(arg, "--iterations")) iterations = strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--seed")) seed = strtoul(value, nullptr, 10);
+        else usage(argv[0]);
+    }
+
+    Random random{seed};
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint32_t count = i % 67; // 包括0与不足4个的情况
+        if (!checkInterleaveRects(random, count) || !checkExpandSprites(random, count)) return 1;
+    }
+    printf("geometry kernels (%s) match the scalar reference over %u iterations\n", getGeometryKernelIsa(),
+           iterations);
+    return 0;
+}
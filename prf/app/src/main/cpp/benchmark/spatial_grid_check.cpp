@@ -0,0 +1,221 @@
+//
+// Created by richardwu on 11/14/24.
+//
+// SpatialGrid的暴力校验：随机的插入、移动、删除之后，查询与点选的结果必须与逐个比较所有条目相同
+//
+//   spatial_grid_check [--iterations N] [--seed S]
+//
+// 每次迭代以随机的格子大小新建一个索引，执行一串随机的操作，条目的尺寸包括负的（在(x, y)的左边、上边）、
+// 零面积、跨越很多格子的大条目，坐标有一部分取整数（落在格子的边界上）；每次查询检查：
+// - query()的结果与暴力相交的集合相同，且按order不减
+// - queryRects()每一段与对应矩形的暴力结果相同
+// - hitTestPoints()的结果包含该点，且order为包含该点的条目中最大的；没有时为INVALID_ID
+// - getBounds()为规范化后的范围
+// 有不符时打印第一处并返回1；只依赖SpatialGrid.cpp，不需要vulkan设备
+
+#include "../engine2d/SpatialGrid.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// 固定种子的线性同余发生器，与engine2d_bench相同
+struct Random {
+    uint32_t state_;
+
+    uint32_t next() {
+        state_ = state_ * 1664525u + 1013904223u;
+        return state_;
+    }
+    float nextFloat(float min, float max) { return min + (next() >> 8) * ((max - min) / 16777216.0f); }
+};
+
+// 暴力比较时的一个条目，bounds_为规范化后的范围
+struct Item {
+    bool alive_;
+    SpatialRect bounds_;
+    uint32_t order_;
+};
+
+static SpatialRect normalize(const SpatialRect &rect) {
+    return SpatialRect{std::min(rect.x_, rect.x_ + rect.w_), std::min(rect.y_, rect.y_ + rect.h_),
+                       std::abs(rect.w_), std::abs(rect.h_)};
+}
+
+static bool intersects(const SpatialRect &a, const SpatialRect &b) {
+    return a.x_ < b.x_ + b.w_ && b.x_ < a.x_ + a.w_ && a.y_ < b.y_ + b.h_ && b.y_ < a.y_ + a.h_;
+}
+
+static bool contains(const SpatialRect &rect, float x, float y) {
+    return x >= rect.x_ && x < rect.x_ + rect.w_ && y >= rect.y_ && y < rect.y_ + rect.h_;
+}
+
+// 随机的矩形：多数是小的，部分跨越很多格子，尺寸可以为负或为零
+static SpatialRect randomRect(Random &random, float extent) {
+    float x = random.nextFloat(-extent, extent), y = random.nextFloat(-extent, extent);
+    float maxSize = random.next() % 8 == 0 ? extent : 200.0f;
+    float w = random.nextFloat(-maxSize, maxSize), h = random.nextFloat(-maxSize, maxSize);
+    if (random.next() % 4 == 0) {
+        // 整数坐标，边缘落在格子的边界上
+        x = (float) (int32_t) x;
+        y = (float) (int32_t) y;
+        w = (float) (int32_t) w;
+        h = (float) (int32_t) h;
+    }
+    if (random.next() % 32 == 0) w = 0.0f;
+    return SpatialRect{x, y, w, h};
+}
+
+static bool fail(uint32_t iteration, uint32_t step, const char *message) {
+    fprintf(stderr, "iteration %u, step %u: %s\n", iteration, step, message);
+    return false;
+}
+
+static bool checkIteration(Random &random, uint32_t iteration) {
+    const float cellSizes[] = {16.0f, 64.0f, SpatialGrid::DEFAULT_CELL_SIZE, 500.0f};
+    const float extent = random.nextFloat(256.0f, 4096.0f);
+    SpatialGrid grid(cellSizes[random.next() % 4]);
+    std::vector<Item> items;
+    std::vector<uint32_t> ids, expected, offsets;
+    std::vector<SpatialRect> rects;
+    std::vector<float> xs, ys;
+    std::vector<uint32_t> hits;
+
+    const uint32_t steps = 200;
+    for (uint32_t step = 0; step < steps; step++) {
+        uint32_t op = random.next() % 10;
+        uint32_t aliveCount = grid.getItemCount();
+        if (op < 4 || aliveCount == 0) {
+            SpatialRect bounds = randomRect(random, extent);
+            uint32_t order = random.next() % 64; // 有相同的order
+            uint32_t id = grid.insert(bounds, order);
+            if (id >= items.size()) items.resize(id + 1, Item{false, SpatialRect{0, 0, 0, 0}, 0});
+            if (items[id].alive_) return fail(iteration, step, "insert() returned an id that is alive");
+            items[id] = Item{true, normalize(bounds), order};
+        } else if (op < 6 || op == 6) {
+            // 移动或删除一个存活的条目
+            uint32_t id;
+            do {
+                id = random.next() % items.size();
+            } while (!items[id].alive_);
+            if (op == 6) {
+                grid.remove(id);
+                items[id].alive_ = false;
+            } else {
+                SpatialRect bounds = items[id].bounds_;
+                if (random.next() % 2) {
+                    bounds.x_ += random.nextFloat(-8.0f, 8.0f); // 小幅移动，多数仍在同样的格子中
+                    bounds.y_ += random.nextFloat(-8.0f, 8.0f);
+                } else {
+                    bounds = randomRect(random, extent);
+                }
+                grid.move(id, bounds);
+                items[id].bounds_ = normalize(bounds);
+            }
+        }
+
+        uint32_t alive = 0;
+        for (uint32_t id = 0; id < items.size(); id++) {
+            if (!items[id].alive_) continue;
+            alive++;
+            const SpatialRect &actual = grid.getBounds(id), &bounds = items[id].bounds_;
+            if (actual.x_ != bounds.x_ || actual.y_ != bounds.y_ || actual.w_ != bounds.w_ || actual.h_ != bounds.h_) {
+                return fail(iteration, step, "getBounds() is not the normalized rect");
+            }
+        }
+        if (alive != grid.getItemCount()) return fail(iteration, step, "getItemCount() differs");
+
+        // query()：与暴力结果的集合相同，按order不减
+        SpatialRect view = randomRect(random, extent);
+        ids.clear();
+        grid.query(view, &ids);
+        for (size_t i = 1; i < ids.size(); i++) {
+            if (grid.getOrder(ids[i - 1]) > grid.getOrder(ids[i])) return fail(iteration, step, "query() is not sorted");
+        }
+        expected.clear();
+        for (uint32_t id = 0; id < items.size(); id++) {
+            if (items[id].alive_ && intersects(items[id].bounds_, normalize(view))) expected.push_back(id);
+        }
+        std::sort(ids.begin(), ids.end());
+        if (ids != expected) return fail(iteration, step, "query() differs from brute force");
+
+        // queryRects()
+        rects.clear();
+        for (uint32_t i = 0; i < 4; i++) rects.push_back(randomRect(random, extent));
+        grid.queryRects(rects.data(), rects.size(), &ids, &offsets);
+        for (uint32_t i = 0; i < rects.size(); i++) {
+            std::vector<uint32_t> actual(ids.begin() + offsets[i], ids.begin() + offsets[i + 1]);
+            std::sort(actual.begin(), actual.end());
+            expected.clear();
+            for (uint32_t id = 0; id < items.size(); id++) {
+                if (items[id].alive_ && intersects(items[id].bounds_, normalize(rects[i]))) expected.push_back(id);
+            }
+            if (actual != expected) return fail(iteration, step, "queryRects() differs from brute force");
+        }
+
+        // hitTestPoints()：一部分点取存活条目的角上（边界上的包含关系）
+        xs.clear();
+        ys.clear();
+        for (uint32_t i = 0; i < 16; i++) {
+            if (i % 4 == 0 && alive > 0) {
+                uint32_t id;
+                do {
+                    id = random.next() % items.size();
+                } while (!items[id].alive_);
+                const SpatialRect &bounds = items[id].bounds_;
+                xs.push_back(random.next() % 2 ? bounds.x_ : bounds.x_ + bounds.w_);
+                ys.push_back(random.next() % 2 ? bounds.y_ : bounds.y_ + bounds.h_);
+            } else {
+                xs.push_back(random.nextFloat(-extent, extent));
+                ys.push_back(random.nextFloat(-extent, extent));
+            }
+        }
+        hits.resize(xs.size());
+        grid.hitTestPoints(xs.data(), ys.data(), xs.size(), hits.data());
+        for (uint32_t i = 0; i < xs.size(); i++) {
+            bool found = false;
+            uint32_t bestOrder = 0;
+            for (uint32_t id = 0; id < items.size(); id++) {
+                if (!items[id].alive_ || !contains(items[id].bounds_, xs[i], ys[i])) continue;
+                if (!found || items[id].order_ > bestOrder) bestOrder = items[id].order_;
+                found = true;
+            }
+            if (!found) {
+                if (hits[i] != SpatialGrid::INVALID_ID) return fail(iteration, step, "hit where no item contains the point");
+                continue;
+            }
+            if (hits[i] == SpatialGrid::INVALID_ID || hits[i] >= items.size() || !items[hits[i]].alive_ ||
+                !contains(items[hits[i]].bounds_, xs[i], ys[i]) || items[hits[i]].order_ != bestOrder) {
+                return fail(iteration, step, "hitTestPoints() is not the topmost item containing the point");
+            }
+        }
+    }
+    return true;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [--iterations N] [--seed S]\n", argv0);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = 100, seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) usage(argv[0]);
+        const char *arg = argv[i];
+        const char *value = argv[++i];
+        if (!strcmp(arg, "--iterations")) iterations = strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--seed")) seed = strtoul(value, nullptr, 10);
+        else usage(argv[0]);
+    }
+
+    Random random{seed};
+    for (uint32_t i = 0; i < iterations; i++) {
+        if (!checkIteration(random, i)) return 1;
+    }
+    printf("spatial grid matches brute force over %u iterations\n", iterations);
+    return 0;
+}
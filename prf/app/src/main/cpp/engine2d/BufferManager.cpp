@@ -3,85 +3,260 @@
 //
 
 #include "BufferManager.h"
+#include "Trace.h"
 #include "../vulkan/utils.h"
 
-BufferManager::BufferManager(VkDevice device, VkPhysicalDevice physicalDevice, VkBufferUsageFlags usage) {
+#include <algorithm>
+#include <cassert>
+
+// 线程缓存的编号（所有BufferManager共用），第i位为1表示编号i正被某个线程（或reclaimThreadCaches()）占用
+static std::atomic<uint32_t> usedThreadSlots(0);
+static const uint32_t ALL_THREAD_SLOTS = (1u << BufferManager::MAX_THREAD_CACHES) - 1;
+static_assert(BufferManager::MAX_THREAD_CACHES < 32, "thread slots must fit in a 32-bit mask");
+
+// 占用最小的空闲编号，都被占用时返回MAX_THREAD_CACHES（共用的缓存）
+static uint32_t acquireThreadSlot() {
+    uint32_t used = usedThreadSlots.load(std::memory_order_relaxed);
+    while (used != ALL_THREAD_SLOTS) {
+        uint32_t slot = __builtin_ctz(~used);
+        // acquire：看到上一个占用者（已退出的线程）对该编号缓存的全部修改
+        if (usedThreadSlots.compare_exchange_weak(used, used | (1u << slot), std::memory_order_acquire,
+                                                  std::memory_order_relaxed)) {
+            return slot;
+        }
+    }
+    return BufferManager::MAX_THREAD_CACHES;
+}
+
+static void releaseThreadSlot(uint32_t slot) {
+    usedThreadSlots.fetch_and(~(1u << slot), std::memory_order_release);
+}
+
+// 线程退出时归还编号；各BufferManager中该编号的空闲列表由下一个占用者继续使用，或由reclaimThreadCaches()放回仓库
+struct ThreadSlot {
+    uint32_t slot_;
+
+    ThreadSlot() : slot_(acquireThreadSlot()) {}
+    ~ThreadSlot() {
+        if (slot_ < BufferManager::MAX_THREAD_CACHES) releaseThreadSlot(slot_);
+    }
+};
+
+static uint32_t getThreadSlot() {
+    static thread_local ThreadSlot threadSlot;
+    // 之前没有空闲的编号：有线程退出后可以换到独占的缓存
+    if (threadSlot.slot_ == BufferManager::MAX_THREAD_CACHES) threadSlot.slot_ = acquireThreadSlot();
+    return threadSlot.slot_;
+}
+
+BufferManager::BufferManager(VkDevice device, MemoryArena *memoryArena, VkBufferUsageFlags usage) {
     device_ = device;
-    physicalDevice_ = physicalDevice;
+    memoryArena_ = memoryArena;
     usage_ = usage;
-}
 
-BufferManager::~BufferManager() {
-    std::unique_lock<std::mutex> locker(mutex_);
-    // 释放所有的VkBuffer和VkDeviceMemory
-    for(auto iter = freeBufferLists_.begin(); iter != freeBufferLists_.end(); iter++) {
-        while (!iter->second.empty()) {
-            // 取出
-            VulkanBufferInfo bufferInfo = iter->second.front();
-            iter->second.pop_front();
-
-            // 删除
-            vkDestroyBuffer(device_, bufferInfo.buffer_, nullptr);
-            vkFreeMemory(device_, bufferInfo.bufferMemory_, nullptr);
-        }
+    for (uint32_t sizeClass = 0; sizeClass < SIZE_CLASS_COUNT; sizeClass++) {
+        depots_[sizeClass] = 0;
+        liveCounts_[sizeClass] = 0;
+        freeCounts_[sizeClass] = 0;
     }
+    for (uint32_t slot = 0; slot <= MAX_THREAD_CACHES; slot++) {
+        for (uint32_t frame = 0; frame < MAX_FRAMES; frame++) caches_[slot].requestedBytes_[frame] = 0;
+    }
+    for (uint32_t chunk = 0; chunk < MAX_NODE_CHUNKS; chunk++) nodeChunks_[chunk] = nullptr;
+    nodeCount_ = 0;
 
-    for(auto iter = usedBufferLists_.begin(); iter != usedBufferLists_.end(); iter++) {
-        while (!iter->second.empty()) {
-            // 取出
-            VulkanBufferInfo bufferInfo = iter->second.front();
-            iter->second.pop_front();
+    frameNumber_ = 0;
+    budgetBytes_ = UINT64_MAX;
+    idleFrames_ = 0;
 
-            // 删除
-            vkDestroyBuffer(device_, bufferInfo.buffer_, nullptr);
-            vkFreeMemory(device_, bufferInfo.bufferMemory_, nullptr);
-        }
+    liveBytes_ = 0;
+    freeBytes_ = 0;
+    highWatermarkBytes_ = 0;
+    allocCount_ = 0;
+    reuseCount_ = 0;
+    createCount_ = 0;
+    trimCount_ = 0;
+}
+
+BufferManager::~BufferManager() {
+    // 所有节点（仓库、线程缓存、使用中）的VkBuffer都在这里，被回收的节点buffer_为VK_NULL_HANDLE
+    for (uint32_t index = 0; index < nodeCount_; index++) {
+        BufferNode &node = getNode(index);
+        if (node.bufferInfo_.buffer_ != VK_NULL_HANDLE) destroyBuffer(node.bufferInfo_);
+    }
+    for (uint32_t chunk = 0; chunk < MAX_NODE_CHUNKS; chunk++) {
+        delete[] nodeChunks_[chunk].load();
     }
 }
 
 void BufferManager::freeAllBuffers(uint32_t frameIndex) {
-    std::unique_lock<std::mutex> locker(mutex_);
-    std::list<VulkanBufferInfo>& usedBufferList = usedBufferLists_[frameIndex];
-
-    // 将所有VkBuffer还至freeBufferLists_
-    while(!usedBufferList.empty()) {
-        // 取出
-        VulkanBufferInfo bufferInfo = usedBufferList.front();
-        usedBufferList.pop_front();
+    assert(frameIndex < MAX_FRAMES);
 
-        // 加入
-        freeBufferLists_[bufferInfo.size_].push_back(bufferInfo);
+    // 将各线程该帧使用的VkBuffer放回仓库（记下归还时的帧，用于判断空闲了多久）
+    for (uint32_t slot = 0; slot <= MAX_THREAD_CACHES; slot++) {
+        std::unique_lock<std::mutex> locker(sharedCacheMutex_, std::defer_lock);
+        if (slot == MAX_THREAD_CACHES) locker.lock();
+        ThreadCache &cache = caches_[slot];
+        std::vector<uint32_t> &usedList = cache.used_[frameIndex];
+        for (auto iter = usedList.begin(); iter != usedList.end(); iter++) {
+            BufferNode &node = getNode(*iter);
+            uint64_t size = node.bufferInfo_.size_;
+            uint32_t sizeClass = getSizeClass(size);
+            node.freedFrame_ = frameNumber_;
+            depotPush(sizeClass, *iter);
+            liveCounts_[sizeClass]--;
+            freeCounts_[sizeClass]++;
+            liveBytes_ -= size;
+            freeBytes_ += size;
+        }
+        usedList.clear(); // 保留容量
+        cache.requestedBytes_[frameIndex] = 0;
     }
 
+    frameNumber_++;
+    reclaimThreadCaches();
+    trim();
+}
+
+void BufferManager::reclaimThreadCaches() {
+    // 没有线程占用的编号（线程已退出）：暂时占用，把其空闲列表放回仓库，由其他线程取用或被trim()回收
+    uint32_t used = usedThreadSlots.load(std::memory_order_relaxed);
+    for (uint32_t slot = 0; slot < MAX_THREAD_CACHES; slot++) {
+        if (used & (1u << slot)) continue;
+        uint32_t expected = used;
+        if (!usedThreadSlots.compare_exchange_strong(expected, used | (1u << slot), std::memory_order_acquire,
+                                                     std::memory_order_relaxed)) {
+            used = expected; // 其他线程同时占用或归还了编号，下一帧再处理
+            continue;
+        }
+        ThreadCache &cache = caches_[slot];
+        for (uint32_t sizeClass = 0; sizeClass < SIZE_CLASS_COUNT; sizeClass++) {
+            std::vector<uint32_t> &freeList = cache.free_[sizeClass];
+            // 表尾是最先被用的，最后放入，仍在栈顶
+            for (auto iter = freeList.begin(); iter != freeList.end(); iter++) depotPush(sizeClass, *iter);
+            freeList.clear();
+        }
+        releaseThreadSlot(slot);
+        used = usedThreadSlots.load(std::memory_order_relaxed);
+    }
 }
 
 VulkanBufferInfo BufferManager::allocBuffer(uint32_t frameIndex, uint64_t size) {
-    std::unique_lock<std::mutex> locker(mutex_);
+    TRACE_SCOPE("BufferManager::allocBuffer");
+    assert(frameIndex < MAX_FRAMES);
+    uint32_t slot = getThreadSlot();
+    if (slot < MAX_THREAD_CACHES) return allocFromCache(caches_[slot], frameIndex, size);
+
+    std::unique_lock<std::mutex> locker(sharedCacheMutex_);
+    return allocFromCache(caches_[MAX_THREAD_CACHES], frameIndex, size);
+}
+
+VulkanBufferInfo BufferManager::allocFromCache(ThreadCache &cache, uint32_t frameIndex, uint64_t size) {
+    allocCount_.fetch_add(1, std::memory_order_relaxed);
+    cache.requestedBytes_[frameIndex].fetch_add(size, std::memory_order_relaxed);
     size = roundUpToPowerOfTwo(size);
-    std::list<VulkanBufferInfo>& freeBufferList = freeBufferLists_[size];
+    uint32_t sizeClass = getSizeClass(size);
+    std::vector<uint32_t> &freeList = cache.free_[sizeClass];
 
-    // 已有空闲已分配VkBuffer
-    if(!freeBufferList.empty()) {
-        // 取出
-        VulkanBufferInfo bufferInfo = freeBufferList.front();
-        freeBufferList.pop_front();
+    // 本线程的空闲列表为空：从仓库中取出一批（最近归还的在栈顶）
+    if (freeList.empty()) {
+        for (uint32_t i = 0; i < REFILL_COUNT; i++) {
+            uint32_t index = depotPop(sizeClass);
+            if (index == INVALID_NODE) break;
+            freeList.push_back(index);
+        }
+        // 保持栈顶（最近归还的）在表尾先用
+        std::reverse(freeList.begin(), freeList.end());
+    }
 
-        // 加入
-        usedBufferLists_[frameIndex].push_back(bufferInfo);
-        return bufferInfo;
+    uint32_t index;
+    // 已有空闲已分配VkBuffer
+    if (!freeList.empty()) {
+        index = freeList.back();
+        freeList.pop_back();
+        reuseCount_.fetch_add(1, std::memory_order_relaxed);
+        freeCounts_[sizeClass]--;
+        freeBytes_ -= size;
+        liveCounts_[sizeClass]++;
+        liveBytes_ += size;
     }
     // 创建新的VkBuffer
     else {
+        index = createNode(size);
+    }
+
+    // 加入
+    cache.used_[frameIndex].push_back(index);
+    return getNode(index).bufferInfo_;
+}
+
+void BufferManager::setBudget(uint64_t budgetBytes, uint32_t idleFrames) {
+    budgetBytes_ = budgetBytes;
+    idleFrames_ = idleFrames;
+}
+
+void BufferManager::trim() {
+    if (liveBytes_ + freeBytes_ <= budgetBytes_) return;
+
+    // 从最大的大小类别开始（每销毁一个回收的字节最多）；只回收仓库中的，线程缓存中的很快就会被用到
+    for (uint32_t sizeClass = SIZE_CLASS_COUNT; sizeClass-- > 0;) {
+        if (depots_[sizeClass].load(std::memory_order_relaxed) == 0) continue;
+
+        // 整个栈取出，栈顶是最近归还的，最久未用的在表尾
+        trimScratch_.clear();
+        for (uint32_t index = depotPop(sizeClass); index != INVALID_NODE; index = depotPop(sizeClass)) {
+            trimScratch_.push_back(index);
+        }
+        while (!trimScratch_.empty() && liveBytes_ + freeBytes_ > budgetBytes_) {
+            BufferNode &node = getNode(trimScratch_.back());
+            if (node.freedFrame_ + idleFrames_ > frameNumber_) break; // 之前的归还得更晚
+            uint64_t size = node.bufferInfo_.size_;
+            destroyBuffer(node.bufferInfo_);
+            node.bufferInfo_.buffer_ = VK_NULL_HANDLE;
+            freeCounts_[sizeClass]--;
+            freeBytes_ -= size;
+            trimCount_.fetch_add(1, std::memory_order_relaxed);
+            {
+                std::unique_lock<std::mutex> locker(nodeMutex_);
+                spareNodes_.push_back(trimScratch_.back());
+            }
+            trimScratch_.pop_back();
+        }
+        // 剩下的按原来的顺序放回（最久未用的先放，仍在栈底）
+        for (auto iter = trimScratch_.rbegin(); iter != trimScratch_.rend(); iter++) {
+            depotPush(sizeClass, *iter);
+        }
+        if (liveBytes_ + freeBytes_ <= budgetBytes_) return;
+    }
+}
 
-        // 创建
-        VulkanBufferInfo bufferInfo;
-        createBuffer(size, bufferInfo.buffer_, bufferInfo.bufferMemory_);
-        bufferInfo.size_ = size;
+void BufferManager::destroyBuffer(const VulkanBufferInfo &bufferInfo) {
+    vkDestroyBuffer(device_, bufferInfo.buffer_, nullptr);
+    memoryArena_->free(bufferInfo.memory_);
+}
+
+void BufferManager::getStats(BufferManagerStats *stats) {
+    // 计数都是原子的，其他线程正在分配时得到的是近似值
+    stats->sizeClasses_.clear();
+    for (uint32_t sizeClass = 0; sizeClass < SIZE_CLASS_COUNT; sizeClass++) {
+        uint32_t liveCount = liveCounts_[sizeClass], freeCount = freeCounts_[sizeClass];
+        if (liveCount == 0 && freeCount == 0) continue;
+        stats->sizeClasses_.push_back(BufferSizeClassStats{MIN_BUFFER_SIZE << sizeClass, liveCount, freeCount});
+    }
 
-        // 加入
-        usedBufferLists_[frameIndex].push_back(bufferInfo);
-        return bufferInfo;
+    uint64_t requestedBytes = 0;
+    for (uint32_t slot = 0; slot <= MAX_THREAD_CACHES; slot++) {
+        for (uint32_t frame = 0; frame < MAX_FRAMES; frame++) requestedBytes += caches_[slot].requestedBytes_[frame];
     }
+    stats->liveBytes_ = liveBytes_;
+    stats->freeBytes_ = freeBytes_;
+    stats->highWatermarkBytes_ = highWatermarkBytes_;
+    stats->wasteBytes_ = stats->liveBytes_ > requestedBytes ? stats->liveBytes_ - requestedBytes : 0;
+    stats->budgetBytes_ = budgetBytes_;
+    stats->allocCount_ = allocCount_;
+    stats->reuseCount_ = reuseCount_;
+    stats->createCount_ = createCount_;
+    stats->trimCount_ = trimCount_;
 }
 
 uint64_t BufferManager::roundUpToPowerOfTwo(uint64_t size) {
@@ -93,30 +268,82 @@ uint64_t BufferManager::roundUpToPowerOfTwo(uint64_t size) {
     return power;
 }
 
-/* 创建VkBuffer的一系辅助函数 */
-bool BufferManager::mapMemoryTypeToIndex(uint32_t typeBits, VkFlags requirements_mask, uint32_t *typeIndex) {
-    VkPhysicalDeviceMemoryProperties memoryProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice_, &memoryProperties);
-    // Search mem types to find first index with those properties
-    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
-        if ((typeBits & 1) == 1) {
-            // Type is available, does it match user properties?
-            if ((memoryProperties.memoryTypes[i].propertyFlags & requirements_mask) ==
-                requirements_mask) {
-                *typeIndex = i;
-                return true;
-            }
+uint32_t BufferManager::getSizeClass(uint64_t size) {
+    return __builtin_ctzll(size) - MIN_BUFFER_SIZE_LOG2;
+}
+
+BufferManager::BufferNode &BufferManager::getNode(uint32_t index) {
+    return nodeChunks_[index / NODE_CHUNK_SIZE].load(std::memory_order_acquire)[index % NODE_CHUNK_SIZE];
+}
+
+uint32_t BufferManager::createNode(uint64_t size) {
+    // VkBuffer的创建不需要加锁（MemoryArena自己加锁）
+    VulkanBufferInfo bufferInfo;
+    createBuffer(size, bufferInfo.buffer_, bufferInfo.memory_);
+    bufferInfo.size_ = size;
+
+    std::unique_lock<std::mutex> locker(nodeMutex_);
+    uint32_t index;
+    if (!spareNodes_.empty()) {
+        index = spareNodes_.back();
+        spareNodes_.pop_back();
+    } else {
+        index = nodeCount_;
+        uint32_t chunk = index / NODE_CHUNK_SIZE;
+        assert(chunk < MAX_NODE_CHUNKS);
+        if (nodeChunks_[chunk].load(std::memory_order_relaxed) == nullptr) {
+            nodeChunks_[chunk].store(new BufferNode[NODE_CHUNK_SIZE], std::memory_order_release);
+        }
+        nodeCount_++;
+    }
+    BufferNode &node = getNode(index);
+    node.bufferInfo_ = bufferInfo;
+    node.freedFrame_ = 0;
+    node.next_.store(0, std::memory_order_relaxed);
+
+    createCount_.fetch_add(1, std::memory_order_relaxed);
+    liveCounts_[getSizeClass(size)]++;
+    liveBytes_ += size;
+    uint64_t totalBytes = liveBytes_ + freeBytes_;
+    if (totalBytes > highWatermarkBytes_) highWatermarkBytes_ = totalBytes; // 只在这里增长，由nodeMutex_保护
+    return index;
+}
+
+void BufferManager::depotPush(uint32_t sizeClass, uint32_t index) {
+    std::atomic<uint64_t> &depot = depots_[sizeClass];
+    BufferNode &node = getNode(index);
+    uint64_t head = depot.load(std::memory_order_relaxed);
+    for (;;) {
+        node.next_.store((uint32_t) head, std::memory_order_relaxed);
+        uint64_t tag = (head >> 32) + 1;
+        if (depot.compare_exchange_weak(head, (tag << 32) | (index + 1), std::memory_order_release,
+                                        std::memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+uint32_t BufferManager::depotPop(uint32_t sizeClass) {
+    std::atomic<uint64_t> &depot = depots_[sizeClass];
+    uint64_t head = depot.load(std::memory_order_acquire);
+    for (;;) {
+        uint32_t top = (uint32_t) head;
+        if (top == 0) return INVALID_NODE;
+        // 节点的内存不会被释放，即使已被其他线程取走，读到的next_也只会让下面的比较失败（版本号已变）
+        uint32_t next = getNode(top - 1).next_.load(std::memory_order_relaxed);
+        uint64_t tag = (head >> 32) + 1;
+        if (depot.compare_exchange_weak(head, (tag << 32) | next, std::memory_order_acquire,
+                                        std::memory_order_acquire)) {
+            return top - 1;
         }
-        typeBits >>= 1;
     }
-    return false;
 }
 
 /**
 * 创建缓冲的辅助函数
 * 可以使用不同的大小、usage、properties
 */
-void BufferManager::createBuffer(VkDeviceSize size, VkBuffer &buffer, VkDeviceMemory &bufferMemory)
+void BufferManager::createBuffer(VkDeviceSize size, VkBuffer &buffer, VulkanMemoryAllocation &bufferMemory)
 {
     VkBufferCreateInfo bufferInfo = {};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -128,20 +355,19 @@ void BufferManager::createBuffer(VkDeviceSize size, VkBuffer &buffer, VkDeviceMe
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    mapMemoryTypeToIndex(memRequirements.memoryTypeBits,
-                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                         &allocInfo.memoryTypeIndex);
-
-    CALL_VK(vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory));
+    // 从内存池中切分（对齐要求来自memRequirements.alignment）
+    bool allocated = memoryArena_->alloc(memRequirements,
+                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                         &bufferMemory);
+    assert(allocated);
+    (void) allocated;
 
-    vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+    CALL_VK(vkBindBufferMemory(device_, buffer, bufferMemory.memory_, bufferMemory.offset_));
 }
 
 void BufferManager::dump() {
-    std::unique_lock<std::mutex> locker(mutex_);
+    BufferManagerStats stats;
+    getStats(&stats);
 
     std::string usageStr;
     if (usage_ == VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) {
@@ -151,15 +377,14 @@ void BufferManager::dump() {
     } else {
         usageStr = "unknown";
     }
-    LOGI("%s buffer manager:", usageStr.c_str());
-
-    LOGI("\tfreeBufferLists_:");
-    for(auto iter = freeBufferLists_.begin(); iter != freeBufferLists_.end(); iter++) {
-        LOGI("\t\t[%d] size %d", iter->first, iter->second.size());
-    }
+    LOGI("%s buffer manager: live %d bytes, free %d bytes, high watermark %d bytes, waste %d bytes",
+         usageStr.c_str(), (int) stats.liveBytes_, (int) stats.freeBytes_, (int) stats.highWatermarkBytes_,
+         (int) stats.wasteBytes_);
+    LOGI("\tallocs %d, reused %d, created %d, trimmed %d", (int) stats.allocCount_, (int) stats.reuseCount_,
+         (int) stats.createCount_, (int) stats.trimCount_);
 
-    LOGI("\tusedBufferLists_:");
-    for(auto iter = usedBufferLists_.begin(); iter != usedBufferLists_.end(); iter++) {
-        LOGI("\t\t[%d] size %d", iter->first, iter->second.size());
+    LOGI("\tsize classes (live / free):");
+    for(auto iter = stats.sizeClasses_.begin(); iter != stats.sizeClasses_.end(); iter++) {
+        LOGI("\t\t[%d] %d / %d", (int) iter->size_, iter->liveCount_, iter->freeCount_);
     }
 }
\ No newline at end of file
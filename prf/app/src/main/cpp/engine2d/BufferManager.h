@@ -6,47 +6,138 @@
 #define PRF_BUFFERMANAGER_H
 
 #include <vulkan_wrapper.h>
+#include "MemoryArena.h"
 
-#include <map>
-#include <list>
+#include <atomic>
 #include <mutex>
 #include <string>
+#include <vector>
 
 // 缓冲管理信息
 struct VulkanBufferInfo {
     VkBuffer buffer_;
-    VkDeviceMemory bufferMemory_;
+    VulkanMemoryAllocation memory_; // 从MemoryArena中切分得到的内存，mapped_可直接写入
     uint64_t size_; // 该buffer的大小，需为2的整数次幂
 };
 
+// 一个大小类别（2的整数次幂）的缓冲统计
+struct BufferSizeClassStats {
+    uint64_t size_;
+    uint32_t liveCount_; // 正被某一帧使用
+    uint32_t freeCount_; // 在空闲列表中等待复用
+};
+
+// BufferManager的统计，字节数均为取整到2的整数次幂之后的大小
+struct BufferManagerStats {
+    std::vector<BufferSizeClassStats> sizeClasses_; // 按size_递增
+    uint64_t liveBytes_;
+    uint64_t freeBytes_;
+    uint64_t highWatermarkBytes_; // liveBytes_ + freeBytes_的历史最大值
+    uint64_t wasteBytes_; // 正在使用的缓冲中，取整多出的字节数
+    uint64_t budgetBytes_;
+
+    uint64_t allocCount_; // allocBuffer调用次数
+    uint64_t reuseCount_; // 其中复用空闲缓冲的次数
+    uint64_t createCount_; // 创建的VkBuffer数
+    uint64_t trimCount_; // 因超出预算被销毁的空闲VkBuffer数
+};
+
 /*
  * 管理系统中所有的某种类型的VkBuffer
- * 暂时有两个实例，处理index buffer或vertex buffer
+ * 暂时只有一个实例，处理vertex buffer（四边形的索引由QuadIndexBuffer共享）
+ * 总字节数超过预算时，连续idleFrames帧未被复用的空闲缓冲会被销毁，一次性的上传高峰不会一直占用内存
+ *
+ * allocBuffer可在多个线程中同时调用，常见路径上没有锁：
+ * - 每个线程一份缓存（按线程的编号，超出MAX_THREAD_CACHES的线程共用一份加锁的缓存），
+ *   其中有每个大小类别的空闲列表，以及每个帧使用中的缓冲；线程退出时归还编号，由之后的线程复用，
+ *   没有线程占用的编号，其空闲列表在freeAllBuffers中放回仓库
+ * - 全局的仓库是每个大小类别一个无锁的Treiber栈；线程缓存为空时一次从中取出REFILL_COUNT个，
+ *   freeAllBuffers把该帧所有线程使用的缓冲放回仓库，由其他线程取用
+ * - 只有创建新的VkBuffer时加锁（分配节点）
+ * freeAllBuffers、setBudget、getStats只在渲染线程上调用；调用freeAllBuffers(frameIndex)时，
+ * 不能有线程正在为同一个frameIndex调用allocBuffer
+ * 各列表的容量只增不减，稳定之后每帧不再有堆分配
  */
 class BufferManager
 {
 public:
-    BufferManager(VkDevice device, VkPhysicalDevice physicalDevice, VkBufferUsageFlags usage); // 该BufferManager管理的VkBuffer类型
-    ~BufferManager(); // 释放所有的VkBuffer和VkDeviceMemory
-    void freeAllBuffers(uint32_t frameIndex); // 归还该帧使用的所有缓冲
+    static const uint32_t MAX_FRAMES = 4; // frameIndex的上限
+    static const uint32_t MAX_THREAD_CACHES = 16;
+
+    BufferManager(VkDevice device, MemoryArena *memoryArena, VkBufferUsageFlags usage); // 该BufferManager管理的VkBuffer类型
+    ~BufferManager(); // 释放所有的VkBuffer，并将内存归还memoryArena
+    void freeAllBuffers(uint32_t frameIndex); // 归还该帧使用的所有缓冲（每帧调用一次，同时推进帧计数并按预算回收）
     VulkanBufferInfo allocBuffer(uint32_t frameIndex, uint64_t size); // 为帧frameIndex申请一个大小至少为size的VkBuffer
 
+    // 设置预算（默认不限制），超出时回收连续idleFrames帧没有被复用的空闲缓冲
+    void setBudget(uint64_t budgetBytes, uint32_t idleFrames);
+    void getStats(BufferManagerStats *stats);
+
     void dump(); // 以log的形式打印 for debug
 
 private:
+    static const uint32_t MIN_BUFFER_SIZE_LOG2 = 5; // 32字节
+    static const uint32_t SIZE_CLASS_COUNT = 64 - MIN_BUFFER_SIZE_LOG2; // 第i类的大小为2^(i + 5)
+    static const uint32_t REFILL_COUNT = 8; // 线程缓存为空时一次从仓库中取出的数量
+    static const uint32_t NODE_CHUNK_SIZE = 1024;
+    static const uint32_t MAX_NODE_CHUNKS = 1024;
+    static const uint32_t INVALID_NODE = 0xFFFFFFFF;
+    const uint64_t MIN_BUFFER_SIZE = 1L << MIN_BUFFER_SIZE_LOG2;
+
+    // 每个VkBuffer一个节点，按编号索引；节点的内存在析构之前不释放，无锁栈读取已被取走的节点也是安全的
+    struct BufferNode {
+        VulkanBufferInfo bufferInfo_;
+        uint64_t freedFrame_; // 最近一次归还时的帧计数
+        std::atomic<uint32_t> next_; // 仓库中下一个节点的编号 + 1，0为栈底
+    };
+
+    // 一个线程的缓存，只由该线程读写（freeAllBuffers读写used_时，该线程不会使用同一帧）
+    struct ThreadCache {
+        std::vector<uint32_t> free_[SIZE_CLASS_COUNT]; // 空闲节点，表尾先用
+        std::vector<uint32_t> used_[MAX_FRAMES]; // 按照正在被哪一个轮转的帧使用
+        std::atomic<uint64_t> requestedBytes_[MAX_FRAMES]; // 申请的原始字节数之和，用于计算取整浪费
+    };
+
     VkDevice device_;
-    VkPhysicalDevice physicalDevice_;
+    MemoryArena *memoryArena_; // 所有VkBuffer的内存都从这里子分配，不再单独vkAllocateMemory
     VkBufferUsageFlags usage_;
 
-    std::mutex mutex_; // 保护下面两个list
+    // 仓库：每个大小类别一个Treiber栈，高32位为版本号（避免ABA），低32位为栈顶节点的编号 + 1，0为空
+    std::atomic<uint64_t> depots_[SIZE_CLASS_COUNT];
+    ThreadCache caches_[MAX_THREAD_CACHES + 1]; // 最后一份由编号超出的线程共用
+    std::mutex sharedCacheMutex_; // 保护共用的那份缓存
+
+    std::atomic<BufferNode *> nodeChunks_[MAX_NODE_CHUNKS];
+    std::mutex nodeMutex_; // 保护节点的分配
+    uint32_t nodeCount_;
+    std::vector<uint32_t> spareNodes_; // 缓冲被回收后留下的节点
+
+    std::vector<uint32_t> trimScratch_; // trim()中暂时取出的节点，只在渲染线程上使用
+    uint64_t frameNumber_; // freeAllBuffers的调用次数，只在渲染线程上修改
+    uint64_t budgetBytes_;
+    uint32_t idleFrames_;
 
-    const uint64_t MIN_BUFFER_SIZE = 32L;
-    std::map<uint64_t, std::list<VulkanBufferInfo>> freeBufferLists_; // 按照2的整数次幂管理所有free buffers
-    std::map<uint32_t, std::list<VulkanBufferInfo>> usedBufferLists_; // 按照正在被哪一个轮转的帧使用，管理所有的used buffers
+    std::atomic<uint32_t> liveCounts_[SIZE_CLASS_COUNT];
+    std::atomic<uint32_t> freeCounts_[SIZE_CLASS_COUNT];
+    std::atomic<uint64_t> liveBytes_;
+    std::atomic<uint64_t> freeBytes_;
+    std::atomic<uint64_t> highWatermarkBytes_;
+    std::atomic<uint64_t> allocCount_;
+    std::atomic<uint64_t> reuseCount_;
+    std::atomic<uint64_t> createCount_;
+    std::atomic<uint64_t> trimCount_;
 
     uint64_t roundUpToPowerOfTwo(uint64_t size);
-    bool mapMemoryTypeToIndex(uint32_t typeBits, VkFlags requirements_mask, uint32_t *typeIndex);
-    void createBuffer(VkDeviceSize size, VkBuffer &buffer, VkDeviceMemory &bufferMemory);
+    static uint32_t getSizeClass(uint64_t size); // size为2的整数次幂且不小于MIN_BUFFER_SIZE
+    BufferNode &getNode(uint32_t index);
+    uint32_t createNode(uint64_t size); // 创建VkBuffer及其节点
+    void depotPush(uint32_t sizeClass, uint32_t index);
+    uint32_t depotPop(uint32_t sizeClass); // 为空时返回INVALID_NODE
+    VulkanBufferInfo allocFromCache(ThreadCache &cache, uint32_t frameIndex, uint64_t size);
+    void reclaimThreadCaches(); // 把已退出的线程留下的空闲缓冲放回仓库
+    void trim(); // 超出预算时回收仓库中空闲太久的缓冲
+    void destroyBuffer(const VulkanBufferInfo &bufferInfo);
+    void createBuffer(VkDeviceSize size, VkBuffer &buffer, VulkanMemoryAllocation &bufferMemory);
 };
 
 #endif //PRF_BUFFERMANAGER_H
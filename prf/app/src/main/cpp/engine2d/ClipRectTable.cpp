@@ -0,0 +1,95 @@
+//
+// Created by richardwu on 11/14/24.
+//
+
+#include "ClipRectTable.h"
+#include "projection.h"
+#include "../vulkan/utils.h"
+
+#include <algorithm>
+
+static bool equals(const SpatialRect &a, const SpatialRect &b) {
+    return a.x_ == b.x_ && a.y_ == b.y_ && a.w_ == b.w_ && a.h_ == b.h_;
+}
+
+ClipRectTable::ClipRectTable(uint32_t maxClipRects) {
+    maxClipRects_ = maxClipRects;
+    viewport_ = SpatialRect{0.0f, 0.0f, 0.0f, 0.0f};
+    cullRect_ = viewport_;
+    clipRects_.push_back(viewport_);
+    clip_ = 0;
+    full_ = false;
+}
+
+void ClipRectTable::setViewport(float width, float height) {
+    viewport_ = SpatialRect{0.0f, 0.0f, width, height};
+    clipRects_[0] = viewport_;
+    if (clip_ == 0) cullRect_ = viewport_;
+}
+
+void ClipRectTable::setClipRect(const SpatialRect &clipRect) {
+    float x0 = std::max(viewport_.x_, std::min(clipRect.x_, clipRect.x_ + clipRect.w_));
+    float y0 = std::max(viewport_.y_, std::min(clipRect.y_, clipRect.y_ + clipRect.h_));
+    float x1 = std::min(viewport_.x_ + viewport_.w_, std::max(clipRect.x_, clipRect.x_ + clipRect.w_));
+    float y1 = std::min(viewport_.y_ + viewport_.h_, std::max(clipRect.y_, clipRect.y_ + clipRect.h_));
+    cullRect_ = SpatialRect{x0, y0, std::max(x1 - x0, 0.0f), std::max(y1 - y0, 0.0f)};
+
+    // 覆盖整个视口的即不裁剪，与最后一项相同（如连续的元素设置同一个裁剪矩形）的复用
+    if (equals(cullRect_, clipRects_[0])) {
+        clip_ = 0;
+        return;
+    }
+    if (equals(cullRect_, clipRects_.back())) {
+        clip_ = clipRects_.size() - 1;
+        return;
+    }
+    if (clipRects_.size() == maxClipRects_) {
+        // 表已满：之后的绘制仍按裁剪矩形剔除，但不再裁剪
+        if (!full_) LOGW("more than %u clip rects in one frame, clipping is dropped", maxClipRects_ - 1);
+        full_ = true;
+        clip_ = 0;
+        return;
+    }
+    clipRects_.push_back(cullRect_);
+    clip_ = clipRects_.size() - 1;
+}
+
+void ClipRectTable::resetClipRect() {
+    cullRect_ = viewport_;
+    clip_ = 0;
+}
+
+const SpatialRect &ClipRectTable::getCullRect() {
+    return cullRect_;
+}
+
+uint32_t ClipRectTable::getClip() {
+    return clip_;
+}
+
+bool ClipRectTable::cull(float x, float y, float w, float h) {
+    float x0 = std::min(x, x + w), y0 = std::min(y, y + h), x1 = std::max(x, x + w), y1 = std::max(y, y + h);
+    return cullRect_.w_ <= 0.0f || cullRect_.h_ <= 0.0f ||
+           x0 >= cullRect_.x_ + cullRect_.w_ || x1 <= cullRect_.x_ ||
+           y0 >= cullRect_.y_ + cullRect_.h_ || y1 <= cullRect_.y_;
+}
+
+void ClipRectTable::setScissor(VkCommandBuffer cmdBuffer, uint32_t clip, const float projection[16],
+                               VkExtent2D displaySize) {
+    VkRect2D scissor = {
+            .offset {.x = 0, .y = 0,},
+            .extent = displaySize,
+    };
+    if (clip != 0) {
+        const SpatialRect &clipRect = clipRects_[clip];
+        scissor = makeScissor(projection, displaySize, clipRect.x_, clipRect.y_, clipRect.w_, clipRect.h_);
+    }
+    vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+}
+
+void ClipRectTable::clear() {
+    clipRects_.resize(1); // 保留容量
+    cullRect_ = viewport_;
+    clip_ = 0;
+    full_ = false;
+}
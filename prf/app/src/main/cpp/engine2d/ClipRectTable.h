@@ -0,0 +1,48 @@
+//
+// Created by richardwu on 11/14/24.
+//
+
+#ifndef PRF_CLIPRECTTABLE_H
+#define PRF_CLIPRECTTABLE_H
+
+#include <vulkan_wrapper.h>
+#include "SpatialGrid.h"
+
+#include <vector>
+
+/*
+ * 一帧中用到的裁剪矩形，RectBuffer与SpriteBuffer各一份
+ * setClipRect()把裁剪矩形（与视口的交集）记入表中，getClip()为其下标，由调用者放进DrawList的排序键，
+ * 这样不同裁剪矩形的绘制不会被合并，重叠时也保持提交的顺序；下标0为不裁剪（整个视口）
+ * 提交时以cull()剔除完全在视口与裁剪矩形之外的绘制，录制时以setScissor()为每个batch设置scissor
+ * 连续设置同一个裁剪矩形时复用表项；表满时之后的裁剪矩形只用于剔除，不再裁剪
+ * 只能在一个线程上修改；setScissor()可在多个线程上同时调用
+ */
+class ClipRectTable
+{
+public:
+    explicit ClipRectTable(uint32_t maxClipRects); // 下标的上限，由排序键中可用的位数决定
+
+    void setViewport(float width, float height); // 本帧绘制区域的尺寸（逻辑像素），每帧开始时设置
+    void setClipRect(const SpatialRect &clipRect); // w、h为负时规范化
+    void resetClipRect();
+    const SpatialRect &getCullRect(); // 视口与当前裁剪矩形的交集
+    uint32_t getClip(); // 当前裁剪矩形在表中的下标
+    // (x, y, w, h)完全在getCullRect()之外（w、h可以为负，即在(x, y)的左边、上边）
+    bool cull(float x, float y, float w, float h);
+
+    // 将cmdBuffer的scissor设为表中第clip项，裁剪矩形是旋转前的逻辑像素，经projection变换到图像中
+    // clip为0时为整个displaySize
+    void setScissor(VkCommandBuffer cmdBuffer, uint32_t clip, const float projection[16], VkExtent2D displaySize);
+    void clear(); // 清空表，开始下一帧
+
+private:
+    uint32_t maxClipRects_;
+    SpatialRect viewport_;
+    SpatialRect cullRect_;
+    std::vector<SpatialRect> clipRects_; // 与视口的交集，下标0为整个视口
+    uint32_t clip_;
+    bool full_; // 本帧的表已满（已警告过）
+};
+
+#endif //PRF_CLIPRECTTABLE_H
@@ -0,0 +1,174 @@
+//
+// Created by richardwu on 11/13/24.
+//
+
+#include "DrawList.h"
+
+#include <algorithm>
+#include <cstring>
+
+static const uint32_t LAYER_SHIFT = 56;
+static const uint32_t DEPTH_SHIFT = 32;
+static const uint32_t PIPELINE_SHIFT = 16;
+static const uint64_t DEPTH_MASK = (uint64_t) DrawList::MAX_DEPTH << DEPTH_SHIFT;
+static const uint64_t STATE_MASK = ~DEPTH_MASK; // layer、pipeline、texture
+
+uint64_t DrawList::makeKey(uint32_t layer, uint32_t depth, uint32_t pipeline, uint32_t texture) {
+    return ((uint64_t) (layer & 0xFF) << LAYER_SHIFT) | ((uint64_t) (depth & MAX_DEPTH) << DEPTH_SHIFT) |
+           ((uint64_t) (pipeline & 0xFFFF) << PIPELINE_SHIFT) | (texture & 0xFFFF);
+}
+
+uint32_t DrawList::getKeyLayer(uint64_t key) {
+    return (uint32_t) (key >> LAYER_SHIFT);
+}
+
+uint32_t DrawList::getKeyDepth(uint64_t key) {
+    return (uint32_t) ((key & DEPTH_MASK) >> DEPTH_SHIFT);
+}
+
+uint32_t DrawList::getKeyPipeline(uint64_t key) {
+    return (uint32_t) (key >> PIPELINE_SHIFT) & 0xFFFF;
+}
+
+uint32_t DrawList::getKeyTexture(uint64_t key) {
+    return (uint32_t) key & 0xFFFF;
+}
+
+bool DrawList::isCompatible(uint64_t a, uint64_t b) {
+    return (uint32_t) a == (uint32_t) b; // 低32位为pipeline与texture
+}
+
+DrawList::DrawList() {
+    depthCount_ = 0;
+}
+
+uint32_t DrawList::add(uint32_t layer, uint32_t pipeline, uint32_t texture, float x, float y, float w, float h) {
+    keys_.push_back(makeKey(layer, 0, pipeline, texture));
+    bounds_.push_back(Bounds{std::min(x, x + w), std::min(y, y + h), std::max(x, x + w), std::max(y, y + h)});
+    return keys_.size() - 1;
+}
+
+bool DrawList::sort() {
+    assignDepth();
+    radixSort();
+    for (uint32_t i = 0; i < order_.size(); i++) {
+        if (order_[i] != i) return true;
+    }
+    return false;
+}
+
+void DrawList::clear() {
+    keys_.clear();
+    bounds_.clear();
+    sortedKeys_.clear();
+    order_.clear();
+    depthCount_ = 0;
+}
+
+uint32_t DrawList::getSize() {
+    return keys_.size();
+}
+
+const uint64_t *DrawList::getKeys() {
+    return sortedKeys_.data();
+}
+
+const uint32_t *DrawList::getOrder() {
+    return order_.data();
+}
+
+uint32_t DrawList::getDepthCount() {
+    return depthCount_;
+}
+
+void DrawList::assignDepth() {
+    depthCount_ = 0;
+    if (keys_.empty()) return;
+
+    // 网格覆盖本帧所有绘制的范围
+    float minX = bounds_[0].x0_, minY = bounds_[0].y0_, maxX = bounds_[0].x1_, maxY = bounds_[0].y1_;
+    for (auto iter = bounds_.begin(); iter != bounds_.end(); iter++) {
+        minX = std::min(minX, iter->x0_);
+        minY = std::min(minY, iter->y0_);
+        maxX = std::max(maxX, iter->x1_);
+        maxY = std::max(maxY, iter->y1_);
+    }
+    const float scaleX = GRID_SIZE / std::max(maxX - minX, 1.0f);
+    const float scaleY = GRID_SIZE / std::max(maxY - minY, 1.0f);
+    auto toCell = [](float value) {
+        return (uint32_t) std::min(std::max(value, 0.0f), (float) (GRID_SIZE - 1));
+    };
+    grid_.assign(GRID_SIZE * GRID_SIZE, Cell{0, 0, false, false});
+
+    for (uint32_t i = 0; i < keys_.size(); i++) {
+        const Bounds &b = bounds_[i];
+        uint32_t cx0 = toCell((b.x0_ - minX) * scaleX), cx1 = toCell((b.x1_ - minX) * scaleX);
+        uint32_t cy0 = toCell((b.y0_ - minY) * scaleY), cy1 = toCell((b.y1_ - minY) * scaleY);
+        const uint64_t state = keys_[i] & STATE_MASK;
+
+        // 不低于所覆盖格子中的最高层级；该层级上有其他状态时再高一级
+        uint32_t depth = 0;
+        for (uint32_t cy = cy0; cy <= cy1; cy++) {
+            for (uint32_t cx = cx0; cx <= cx1; cx++) {
+                const Cell &cell = grid_[cy * GRID_SIZE + cx];
+                if (!cell.used_) continue;
+                uint32_t needed = cell.mixed_ || cell.state_ != state ? cell.depth_ + 1 : cell.depth_;
+                depth = std::max(depth, needed);
+            }
+        }
+        depth = std::min(depth, (uint32_t) MAX_DEPTH); // 层级数不会超过绘制数
+
+        for (uint32_t cy = cy0; cy <= cy1; cy++) {
+            for (uint32_t cx = cx0; cx <= cx1; cx++) {
+                Cell &cell = grid_[cy * GRID_SIZE + cx];
+                if (!cell.used_ || depth > cell.depth_) {
+                    cell = Cell{depth, state, false, true};
+                } else if (depth == cell.depth_ && cell.state_ != state) {
+                    cell.mixed_ = true;
+                }
+            }
+        }
+        keys_[i] = (keys_[i] & STATE_MASK) | ((uint64_t) depth << DEPTH_SHIFT);
+        depthCount_ = std::max(depthCount_, depth + 1);
+    }
+}
+
+void DrawList::radixSort() {
+    const uint32_t count = keys_.size();
+    sortedKeys_.assign(keys_.begin(), keys_.end());
+    order_.resize(count);
+    for (uint32_t i = 0; i < count; i++) order_[i] = i;
+    if (count < 2) return;
+    tempKeys_.resize(count);
+    tempOrder_.resize(count);
+
+    // LSD基数排序，每趟8位；一次遍历统计所有8趟的直方图，所有键在某一字节上都相同时跳过该趟
+    uint32_t histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t key = sortedKeys_[i];
+        for (uint32_t pass = 0; pass < 8; pass++) {
+            histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+        }
+    }
+
+    for (uint32_t pass = 0; pass < 8; pass++) {
+        uint32_t *histogram = histograms[pass];
+        if (histogram[(sortedKeys_[0] >> (pass * 8)) & 0xFF] == count) continue;
+
+        uint32_t offset = 0;
+        for (uint32_t digit = 0; digit < 256; digit++) {
+            uint32_t n = histogram[digit];
+            histogram[digit] = offset;
+            offset += n;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            uint64_t key = sortedKeys_[i];
+            uint32_t dst = histogram[(key >> (pass * 8)) & 0xFF]++;
+            tempKeys_[dst] = key;
+            tempOrder_[dst] = order_[i];
+        }
+        sortedKeys_.swap(tempKeys_);
+        order_.swap(tempOrder_);
+    }
+}
@@ -0,0 +1,74 @@
+//
+// Created by richardwu on 11/13/24.
+//
+
+#ifndef PRF_DRAWLIST_H
+#define PRF_DRAWLIST_H
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * 延迟的绘制列表：每个绘制带一个64位的排序键，每帧以基数排序后按键的顺序录制，
+ * 相邻且管线、纹理相同的绘制可以合并为一次绘制，减少vkCmdBindPipeline等状态切换
+ * 排序键从高到低：layer 8位 | depth 24位 | pipeline 16位 | texture 16位
+ * - layer由调用者指定，不同layer之间严格按layer的顺序绘制
+ * - depth由sort()根据重叠关系计算（画家算法的层级）：一个绘制排在所有与它重叠、且在它之前提交的绘制之后，
+ *   与其中状态（layer、pipeline、texture）不同的绘制至少差一级；不重叠的绘制可以自由重排，因而能与别处的同状态绘制合并
+ * 重叠以覆盖本帧所有绘制的GRID_SIZE x GRID_SIZE网格判断（按格子保守地估计，只会多分层级，不会打乱需要保持的顺序）
+ * 排序是稳定的，同一状态、同一层级的绘制保持提交的顺序
+ * 只能在一个线程上使用
+ */
+class DrawList
+{
+public:
+    static const uint32_t GRID_SIZE = 32;
+    static const uint32_t MAX_DEPTH = (1u << 24) - 1;
+
+    DrawList();
+
+    static uint64_t makeKey(uint32_t layer, uint32_t depth, uint32_t pipeline, uint32_t texture);
+    static uint32_t getKeyLayer(uint64_t key);
+    static uint32_t getKeyDepth(uint64_t key);
+    static uint32_t getKeyPipeline(uint64_t key);
+    static uint32_t getKeyTexture(uint64_t key);
+    static bool isCompatible(uint64_t a, uint64_t b); // 管线与纹理都相同，可以合并为一次绘制
+
+    // 提交一个绘制，覆盖的像素范围为(x, y, w, h)；返回提交的下标
+    uint32_t add(uint32_t layer, uint32_t pipeline, uint32_t texture, float x, float y, float w, float h);
+    // 计算depth并排序，之后getKeys()与getOrder()按排序后的顺序返回；顺序与提交时相同时返回false
+    bool sort();
+    void clear();
+
+    uint32_t getSize();
+    const uint64_t *getKeys(); // 排序后的键
+    const uint32_t *getOrder(); // 排序后的第i个绘制在提交时的下标
+    uint32_t getDepthCount(); // 本帧用到的层级数
+
+private:
+    struct Bounds {
+        float x0_, y0_, x1_, y1_;
+    };
+
+    // 网格的一格：覆盖它的绘制中最高的层级，以及该层级上的状态
+    struct Cell {
+        uint32_t depth_;
+        uint64_t state_;
+        bool mixed_; // 该层级上有不止一种状态
+        bool used_;
+    };
+
+    std::vector<uint64_t> keys_; // 按提交的顺序，sort()之前depth为0
+    std::vector<Bounds> bounds_;
+    std::vector<Cell> grid_;
+    uint32_t depthCount_;
+
+    // 基数排序的输入输出交替使用两组数组
+    std::vector<uint64_t> sortedKeys_, tempKeys_;
+    std::vector<uint32_t> order_, tempOrder_;
+
+    void assignDepth();
+    void radixSort();
+};
+
+#endif //PRF_DRAWLIST_H
@@ -0,0 +1,302 @@
+//
+// Created by richardwu on 11/13/24.
+//
+
+#include "Engine2D.h"
+#include "pipeline.h"
+#include "projection.h"
+#include "Trace.h"
+#include "rect/rect_pipeline.h"
+#include "sprite/sprite_pipeline.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+static const uint32_t PIPELINE_BUDGET = 64;
+static const uint32_t MAX_COMPILE_THREADS = 2;
+
+static const uint64_t BUFFER_BUDGET_BYTES = 16L * 1024 * 1024; // 超出后回收空闲的缓冲
+static const uint32_t BUFFER_IDLE_FRAMES = 120; // 空闲超过这么多帧的缓冲才会被回收
+
+static const VkDeviceSize TRANSIENT_REGION_SIZE = 1L * 1024 * 1024;
+
+static const uint32_t MAX_RECORD_THREADS = 4;
+static const uint32_t PARALLEL_RECORD_THRESHOLD = 512;
+
+static const uint32_t MAX_QUADS_PER_BATCH = 32768;
+
+static const uint32_t MAX_DECODE_THREADS = 2;
+
+static const double FRAME_BUDGET_MS = 1000.0 / 60;
+
+Engine2D::Engine2D(const VulkanDeviceInfo &deviceInfo, VkRenderPass renderPass, VkPipelineCache pipelineCache,
+                   uint32_t framesInFlight, const AssetReader &assetReader, bool synchronous) {
+    device_ = deviceInfo.device_;
+    pipelineCache_ = pipelineCache;
+    synchronous_ = synchronous;
+    frameIndex_ = 0;
+    logicalSize_ = VkExtent2D{0, 0};
+
+    // 以大块VkDeviceMemory为单位申请内存，再切分给各个VkBuffer
+    memoryArena_ = new MemoryArena(device_, deviceInfo.physicalDevice_);
+
+    // 为每个2的整次幂维护一个可用VkBuffer的列表进行复用
+    vertexBufferManager_ = new BufferManager(device_, memoryArena_, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    vertexBufferManager_->setBudget(BUFFER_BUDGET_BYTES, BUFFER_IDLE_FRAMES);
+
+    // 每帧临时几何数据的环形缓冲
+    transientBuffer_ = new RingBuffer(device_, memoryArena_,
+                                      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                      framesInFlight, TRANSIENT_REGION_SIZE);
+
+    // 每帧临时CPU数据的线性分配器
+    frameArena_ = new FrameArena(framesInFlight);
+
+    // 多线程录制：每个线程、每个在途帧一个指令池
+    uint32_t recordThreads = std::min(MAX_RECORD_THREADS, std::max(1u, std::thread::hardware_concurrency()));
+    parallelRecorder_ = new ParallelRecorder(device_, deviceInfo.queueFamilyIndex_, recordThreads, framesInFlight);
+
+    // 静态几何数据的上传，每批一个fence，不阻塞渲染线程
+    staticBufferUploader_ = new StaticBufferUploader(device_, memoryArena_, deviceInfo.queueFamilyIndex_,
+                                                     deviceInfo.transferQueueFamilyIndex_, deviceInfo.transferQueue_);
+
+    // 四边形的索引只生成、上传一次，不再走每帧的路径
+    quadIndexBuffer_ = new QuadIndexBuffer(staticBufferUploader_, MAX_QUADS_PER_BATCH);
+
+    // 矩形的实例数据走环形缓冲，单位四边形位于显存
+    rectBuffer_ = new RectBuffer(staticBufferUploader_, quadIndexBuffer_, transientBuffer_, vertexBufferManager_,
+                                 frameArena_);
+
+    if (synchronous_) {
+        // 初始化时等待上传完成，保证第一帧就是完整的画面
+        staticBufferUploader_->submit();
+        CALL_VK(vkQueueWaitIdle(deviceInfo.transferQueue_));
+    }
+
+    // 每个在途帧一个时间戳query pool
+    gpuProfiler_ = new GpuProfiler(device_, deviceInfo.physicalDevice_, deviceInfo.queueFamilyIndex_,
+                                   framesInFlight);
+
+    // 各时间段的直方图
+    frameStats_ = new FrameStats(FRAME_BUDGET_MS);
+
+    // 管线按需异步创建，以LRU的哈希表维护
+    uint32_t compileThreads = std::min(MAX_COMPILE_THREADS, std::max(1u, std::thread::hardware_concurrency() / 2));
+    compileThreadPool_ = new ThreadPool(compileThreads);
+    VkDevice device = device_;
+    pipelineRegistry_ = new PipelineRegistry(device_,
+                                             [assetReader, device, pipelineCache](const VulkanPipelineDesc &desc,
+                                                                                  VulkanPipelineInfo *pipelineInfo) {
+                                                 createGraphicsPipeline(assetReader, device, pipelineCache, desc,
+                                                                        pipelineInfo);
+                                             }, compileThreadPool_, PIPELINE_BUDGET, framesInFlight);
+
+    // 纹理的读取与解码不占用管线编译的线程
+    uint32_t decodeThreads = std::min(MAX_DECODE_THREADS, std::max(1u, std::thread::hardware_concurrency() / 2));
+    decodeThreadPool_ = new ThreadPool(decodeThreads);
+    textureManager_ = new TextureManager(device_, deviceInfo.physicalDevice_, memoryArena_, staticBufferUploader_,
+                                         decodeThreadPool_, assetReader, framesInFlight);
+    textureAtlas_ = new TextureAtlas(device_, deviceInfo.physicalDevice_, memoryArena_, staticBufferUploader_,
+                                     framesInFlight);
+
+    // 精灵展开后的顶点同样走环形缓冲，以共享的四边形索引绘制
+    spriteBuffer_ = new SpriteBuffer(device_, quadIndexBuffer_, textureAtlas_, transientBuffer_, vertexBufferManager_,
+                                     frameArena_, framesInFlight);
+    recordContext_ = RecordContext{};
+    recordContext_.rectBuffer_ = rectBuffer_;
+    recordContext_.spriteBuffer_ = spriteBuffer_;
+
+    for (uint32_t mode = 0; mode < BLEND_MODE_COUNT; mode++) {
+        rectPipelineDescs_[mode] = getRectPipelineDesc(renderPass, (BlendMode) mode);
+        spritePipelineDescs_[mode] = getSpritePipelineDesc(renderPass, spriteBuffer_->getSetLayout(),
+                                                           (BlendMode) mode);
+    }
+    if (synchronous_) {
+        // 所有混合方式的管线一起提交，再逐个等待
+        for (uint32_t mode = 0; mode < BLEND_MODE_COUNT; mode++) {
+            pipelineRegistry_->getAsync(rectPipelineDescs_[mode]);
+            pipelineRegistry_->getAsync(spritePipelineDescs_[mode]);
+        }
+        for (uint32_t mode = 0; mode < BLEND_MODE_COUNT; mode++) {
+            pipelineRegistry_->get(rectPipelineDescs_[mode]);
+            pipelineRegistry_->get(spritePipelineDescs_[mode]);
+        }
+    } else {
+        // 预先提交编译，不阻塞初始化；首帧之前未完成的话相关绘制会被跳过
+        pipelineRegistry_->getAsync(rectPipelineDescs_[BLEND_MODE_ALPHA]);
+        pipelineRegistry_->getAsync(spritePipelineDescs_[BLEND_MODE_ALPHA]);
+    }
+}
+
+Engine2D::~Engine2D() {
+    delete parallelRecorder_;
+
+    // 编译任务使用pipelineCache_，先于其销毁结束
+    delete pipelineRegistry_;
+    delete compileThreadPool_;
+    delete textureManager_; // 等待解码中的纹理，之后线程池才能结束
+    delete decodeThreadPool_;
+    delete textureAtlas_;
+
+    // 调用析构函数，释放VkBuffer，再释放其下的VkDeviceMemory
+    delete gpuProfiler_;
+    delete frameStats_;
+    delete rectBuffer_;
+    delete spriteBuffer_; // 使用其set layout的管线已随pipelineRegistry_销毁
+    delete quadIndexBuffer_;
+    delete staticBufferUploader_;
+    delete vertexBufferManager_;
+    delete transientBuffer_;
+    delete frameArena_;
+    delete memoryArena_;
+}
+
+void Engine2D::beginFrame(uint32_t frameIndex, VkCommandBuffer cmdBuffer, VkExtent2D logicalSize) {
+    frameIndex_ = frameIndex;
+    logicalSize_ = logicalSize;
+
+    // 重置该在途帧在上次轮转时使用的资源
+    vkResetCommandBuffer(cmdBuffer, 0);
+    vertexBufferManager_->freeAllBuffers(frameIndex);
+    transientBuffer_->resetRegion(frameIndex);
+    frameArena_->reset(frameIndex);
+    staticBufferUploader_->poll();
+    textureManager_->beginFrame();
+    textureAtlas_->beginFrame();
+    pipelineRegistry_->beginFrame();
+    spriteBuffer_->beginFrame(frameIndex);
+
+    VkCommandBufferBeginInfo cmdBufferBeginInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .pNext = nullptr,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            .pInheritanceInfo = nullptr,
+    };
+    CALL_VK(vkBeginCommandBuffer(cmdBuffer, &cmdBufferBeginInfo));
+    // 读回该在途帧上一次的GPU计时，并重置其query pool
+    if (gpuProfiler_->beginFrame(frameIndex, cmdBuffer)) {
+        frameStats_->addSample(FRAME_INTERVAL_GPU, gpuProfiler_->getLatestTotalNs() / 1e6);
+    }
+
+    // 视口取旋转前的逻辑尺寸（与投影矩阵一致），屏幕外的矩形在提交时被丢弃
+    rectBuffer_->setViewport(logicalSize.width, logicalSize.height);
+    spriteBuffer_->setViewport(logicalSize.width, logicalSize.height);
+}
+
+Engine2DFrame Engine2D::getFrame() {
+    return Engine2DFrame{frameIndex_, logicalSize_.width, logicalSize_.height, rectBuffer_, spriteBuffer_,
+                         textureManager_, textureAtlas_, vertexBufferManager_, frameArena_};
+}
+
+void Engine2D::recordRenderPass(VkCommandBuffer cmdBuffer, const VkRenderPassBeginInfo &renderPassBeginInfo,
+                                VkSurfaceTransformFlagBitsKHR pretransform) {
+    const uint32_t frame = frameIndex_;
+    const VkExtent2D displaySize = renderPassBeginInfo.renderArea.extent;
+
+    // 实例与顶点数据一次性写入环形缓冲，之后各线程只录制绘制命令
+    rectBuffer_->upload(frame);
+    spriteBuffer_->upload(frame);
+    RecordContext &context = recordContext_;
+    makeProjection(logicalSize_, pretransform, context.projection_);
+    context.displaySize_ = displaySize;
+
+    // 本帧用到的每种混合方式取得管线
+    for (uint32_t mode = 0; mode < BLEND_MODE_COUNT; mode++) {
+        context.rectPipelines_[mode] = VulkanPipelineInfo{};
+        context.spritePipelines_[mode] = VulkanPipelineInfo{};
+    }
+    getPipelines(rectPipelineDescs_, rectBuffer_->getBlendModeMask(), context.rectPipelines_);
+    getPipelines(spritePipelineDescs_, spriteBuffer_->getBlendModeMask(), context.spritePipelines_);
+    const uint32_t rectCount = rectBuffer_->getRectCount();
+    const uint32_t spriteCount = spriteBuffer_->getSpriteCount();
+    const uint32_t drawCount = rectCount + spriteCount;
+    context.rectCount_ = rectCount;
+    TRACE_COUNTER("rects", rectCount);
+    TRACE_COUNTER("rect batches", rectBuffer_->getBatchCount());
+    TRACE_COUNTER("rects culled", rectBuffer_->getCulledCount());
+    TRACE_COUNTER("sprites", spriteCount);
+    TRACE_COUNTER("sprite batches", spriteBuffer_->getBatchCount());
+    TRACE_COUNTER("sprites skipped", spriteBuffer_->getSkippedCount());
+    TRACE_COUNTER("frame arena bytes", frameArena_->getUsedBytes(frame));
+    uint32_t renderPassScope = gpuProfiler_->beginScope(cmdBuffer, "render pass");
+    if (drawCount >= PARALLEL_RECORD_THRESHOLD) {
+        // 矩形在前、精灵在后排成一个下标空间，切片后由工作线程录制，secondary按切片的顺序执行，矩形仍先于精灵
+        // primary中只执行secondary command buffer
+        vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        const std::vector<VkCommandBuffer> &secondaryBuffers = parallelRecorder_->record(
+                frame, renderPassBeginInfo.renderPass, renderPassBeginInfo.framebuffer, drawCount,
+                &Engine2D::recordSlice, &context);
+        // 以SECONDARY_COMMAND_BUFFERS开始的render pass中primary只能执行vkCmdExecuteCommands，这里只有render pass整体的计时
+        vkCmdExecuteCommands(cmdBuffer, secondaryBuffers.size(), secondaryBuffers.data());
+    } else {
+        vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        setViewportAndScissor(cmdBuffer, displaySize);
+        rectBuffer_->record(cmdBuffer, context.rectPipelines_, context.projection_, displaySize, 0, rectCount,
+                            gpuProfiler_);
+        spriteBuffer_->record(cmdBuffer, context.spritePipelines_, context.projection_, displaySize, 0, spriteCount,
+                              gpuProfiler_);
+    }
+    rectBuffer_->clear();
+    spriteBuffer_->clear();
+
+    vkCmdEndRenderPass(cmdBuffer);
+    gpuProfiler_->endScope(cmdBuffer, renderPassScope);
+}
+
+void Engine2D::recordSlice(void *context, VkCommandBuffer cmdBuffer, uint32_t begin, uint32_t end) {
+    const RecordContext &record = *(const RecordContext *) context;
+    const uint32_t rectCount = record.rectCount_;
+    setViewportAndScissor(cmdBuffer, record.displaySize_);
+    record.rectBuffer_->record(cmdBuffer, record.rectPipelines_, record.projection_, record.displaySize_, begin,
+                               std::min(end, rectCount));
+    record.spriteBuffer_->record(cmdBuffer, record.spritePipelines_, record.projection_, record.displaySize_,
+                                 std::max(begin, rectCount) - rectCount, std::max(end, rectCount) - rectCount);
+}
+
+void Engine2D::getPipelines(const VulkanPipelineDesc descs[BLEND_MODE_COUNT], uint32_t blendModeMask,
+                            VulkanPipelineInfo pipelines[BLEND_MODE_COUNT]) {
+    // 非同步模式下尚在编译的保持为空，相应的绘制被跳过，而不是阻塞渲染线程
+    for (uint32_t mode = 0; mode < BLEND_MODE_COUNT; mode++) {
+        if (!(blendModeMask & (1u << mode))) continue;
+        if (synchronous_) {
+            pipelines[mode] = pipelineRegistry_->get(descs[mode]);
+        } else {
+            PipelineHandle handle = pipelineRegistry_->getAsync(descs[mode]);
+            if (handle->isReady()) pipelines[mode] = handle->pipelineInfo_;
+        }
+    }
+}
+
+void Engine2D::endFrame(VkCommandBuffer cmdBuffer) {
+    CALL_VK(vkEndCommandBuffer(cmdBuffer));
+}
+
+void Engine2D::submit(VkQueue queue, const VkSubmitInfo &submitInfo, VkFence fence) {
+    staticBufferUploader_->submit();
+    TRACE_BEGIN("submit");
+    CALL_VK(vkQueueSubmit(queue, 1, &submitInfo, fence));
+    TRACE_END("submit");
+}
+
+TextureManager *Engine2D::getTextureManager() {
+    return textureManager_;
+}
+
+MemoryArena *Engine2D::getMemoryArena() {
+    return memoryArena_;
+}
+
+GpuProfiler *Engine2D::getGpuProfiler() {
+    return gpuProfiler_;
+}
+
+FrameStats *Engine2D::getFrameStats() {
+    return frameStats_;
+}
+
+void Engine2D::dump() {
+    gpuProfiler_->dump();
+    vertexBufferManager_->dump();
+    memoryArena_->dump();
+}
@@ -0,0 +1,134 @@
+//
+// Created by richardwu on 11/13/24.
+//
+
+#ifndef PRF_ENGINE2D_H
+#define PRF_ENGINE2D_H
+
+#include <vulkan_wrapper.h>
+#include "../vulkan/utils.h"
+#include "utils.h"
+#include "asset.h"
+#include "MemoryArena.h"
+#include "BufferManager.h"
+#include "RingBuffer.h"
+#include "FrameArena.h"
+#include "ParallelRecorder.h"
+#include "PipelineRegistry.h"
+#include "ThreadPool.h"
+#include "GpuProfiler.h"
+#include "FrameStats.h"
+#include "StaticBufferUploader.h"
+#include "QuadIndexBuffer.h"
+#include "TextureManager.h"
+#include "TextureAtlas.h"
+#include "rect/rect_buffer.h"
+#include "sprite/sprite_buffer.h"
+
+// 场景可以使用的本帧资源
+struct Engine2DFrame {
+    uint32_t frameIndex_; // 当前在途帧，向BufferManager申请缓冲时使用
+    uint32_t width_; // 逻辑尺寸（旋转前，与投影一致）
+    uint32_t height_;
+    RectBuffer *rectBuffer_;
+    SpriteBuffer *spriteBuffer_; // 在本帧的矩形之后绘制
+    TextureManager *textureManager_; // drawTexture()使用的纹理由此取得
+    TextureAtlas *textureAtlas_; // drawSprite()使用的精灵由此插入
+    BufferManager *vertexBufferManager_;
+    FrameArena *frameArena_; // 本帧的临时内存，下次复用该在途帧时回卷
+};
+
+/*
+ * 2d引擎中与设备无关的部分：资源管理器的创建与销毁、每帧资源的回收、render pass内的录制
+ * 交换链（Android）或离屏图像（headless）、同步原语与提交由各个后端负责，每帧的调用顺序为：
+ *   等待该在途帧的fence -> beginFrame() -> 向getFrame()提交场景 -> recordRenderPass() -> endFrame()
+ *   -> submit()
+ * 析构前调用者需要vkDeviceWaitIdle，并在之后才销毁pipelineCache与设备
+ */
+class Engine2D
+{
+public:
+    // synchronous为true时（headless测量）初始化时等待静态数据上传与所有管线编译完成，之后每帧取管线也阻塞，
+    // 保证每一帧的内容都完整；为false时管线在后台编译，未就绪的绘制被跳过，不阻塞渲染线程
+    Engine2D(const VulkanDeviceInfo &deviceInfo, VkRenderPass renderPass, VkPipelineCache pipelineCache,
+             uint32_t framesInFlight, const AssetReader &assetReader, bool synchronous);
+    ~Engine2D();
+
+    // 该在途帧的fence已signal后调用：回收该帧的资源，开始录制cmdBuffer
+    // logicalSize为旋转前的尺寸，是场景的视口
+    void beginFrame(uint32_t frameIndex, VkCommandBuffer cmdBuffer, VkExtent2D logicalSize);
+    Engine2DFrame getFrame();
+    // 上传本帧场景，录制整个render pass；pretransform与交换链一致（离屏图像为IDENTITY）
+    void recordRenderPass(VkCommandBuffer cmdBuffer, const VkRenderPassBeginInfo &renderPassBeginInfo,
+                          VkSurfaceTransformFlagBitsKHR pretransform);
+    void endFrame(VkCommandBuffer cmdBuffer); // 结束录制
+    // 先提交本帧新建的静态缓冲的复制（同一队列时排在本帧之前），再提交本帧
+    void submit(VkQueue queue, const VkSubmitInfo &submitInfo, VkFence fence);
+
+    TextureManager *getTextureManager();
+    MemoryArena *getMemoryArena();
+    GpuProfiler *getGpuProfiler();
+    FrameStats *getFrameStats();
+    void dump(); // 以log的形式打印最近一帧的GPU区间、缓冲与设备内存 for debug
+
+private:
+    VkDevice device_;
+    VkPipelineCache pipelineCache_;
+    bool synchronous_;
+    uint32_t frameIndex_;
+    VkExtent2D logicalSize_;
+
+    /* 管线注册表：按管线状态的哈希复用管线，超过预算时按LRU淘汰；管线在后台线程池中编译 */
+    PipelineRegistry *pipelineRegistry_;
+    ThreadPool *compileThreadPool_;
+    VulkanPipelineDesc rectPipelineDescs_[BLEND_MODE_COUNT]; // 每种混合方式一个
+    VulkanPipelineDesc spritePipelineDescs_[BLEND_MODE_COUNT];
+
+    /* 设备内存池，所有BufferManager的VkBuffer都从中子分配内存 */
+    MemoryArena *memoryArena_;
+    /* 管理各类型的VkBuffer */
+    BufferManager *vertexBufferManager_;
+    /* 只活一帧的顶点、索引数据走持久映射的环形缓冲，每个在途帧一个区域 */
+    RingBuffer *transientBuffer_;
+    /* 每帧的CPU临时内存，随该帧的fence整体回卷 */
+    FrameArena *frameArena_;
+    /* 绘制数量超过阈值时，由多个线程录制secondary command buffer */
+    ParallelRecorder *parallelRecorder_;
+    /* 静态几何数据经staging缓冲复制到DEVICE_LOCAL内存，有独立的传输队列时在其上执行 */
+    StaticBufferUploader *staticBufferUploader_;
+    /* 所有四边形图元共享的索引缓冲，初始化时生成一次，超出uint16_t范围的批次使用32位索引 */
+    QuadIndexBuffer *quadIndexBuffer_;
+    /* 纹理：在线程池中解码，经staticBufferUploader_复制到显存，按引用计数管理 */
+    TextureManager *textureManager_;
+    ThreadPool *decodeThreadPool_;
+    /* 小图装进少数几张图集页中，同一页上的精灵可以一次绘制 */
+    TextureAtlas *textureAtlas_;
+    /* 实例化的矩形绘制 */
+    RectBuffer *rectBuffer_;
+    /* 带纹理的精灵，顶点走环形缓冲，以共享的四边形索引成批绘制 */
+    SpriteBuffer *spriteBuffer_;
+    /* GPU时间戳计时，结果比当前帧晚framesInFlight帧 */
+    GpuProfiler *gpuProfiler_;
+    /* 帧时间统计，各段耗时由后端填写 */
+    FrameStats *frameStats_;
+
+    // 录制一帧的render pass所需的参数，每帧在recordRenderPass()中填写，多线程录制时作为ParallelRecorder的context
+    struct RecordContext {
+        RectBuffer *rectBuffer_;
+        SpriteBuffer *spriteBuffer_;
+        float projection_[16];
+        VulkanPipelineInfo rectPipelines_[BLEND_MODE_COUNT];
+        VulkanPipelineInfo spritePipelines_[BLEND_MODE_COUNT];
+        uint32_t rectCount_; // 矩形在前、精灵在后排成一个下标空间
+        VkExtent2D displaySize_;
+    };
+    RecordContext recordContext_;
+
+    // ParallelRecorder的RecordFunc：在secondary command buffer中录制下标[begin, end)的矩形与精灵
+    static void recordSlice(void *context, VkCommandBuffer cmdBuffer, uint32_t begin, uint32_t end);
+    // 取得blendModeMask中各混合方式的管线，非同步模式下尚在编译的保持为空
+    void getPipelines(const VulkanPipelineDesc descs[BLEND_MODE_COUNT], uint32_t blendModeMask,
+                      VulkanPipelineInfo pipelines[BLEND_MODE_COUNT]);
+};
+
+#endif //PRF_ENGINE2D_H
@@ -0,0 +1,96 @@
+//
+// Created by richardwu on 11/13/24.
+//
+
+#include "FrameArena.h"
+#include "../vulkan/utils.h"
+
+#include <algorithm>
+#include <cassert>
+
+FrameArena::FrameArena(uint32_t framesInFlight, size_t blockSize) {
+    blockSize_ = blockSize;
+    blockAllocCount_ = 0;
+    frames_.resize(framesInFlight);
+    for (auto iter = frames_.begin(); iter != frames_.end(); iter++) {
+        iter->current_ = 0;
+        iter->offset_ = 0;
+        iter->usedBytes_ = 0;
+        iter->peakBytes_ = 0;
+        addBlock(*iter, blockSize_); // 预先分配，第一帧也不在渲染路径上申请
+    }
+}
+
+FrameArena::~FrameArena() {
+    for (auto frame = frames_.begin(); frame != frames_.end(); frame++) {
+        for (auto iter = frame->blocks_.begin(); iter != frame->blocks_.end(); iter++) {
+            delete[] iter->data_;
+        }
+    }
+}
+
+void FrameArena::reset(uint32_t frameIndex) {
+    assert(frameIndex < frames_.size());
+    Frame &frame = frames_[frameIndex];
+    frame.peakBytes_ = std::max(frame.peakBytes_, frame.usedBytes_);
+
+    // 上一轮用到了多个块：合并为一个，下一轮（同样的用量）只需一个块
+    if (frame.blocks_.size() > 1) {
+        size_t totalSize = 0;
+        for (auto iter = frame.blocks_.begin(); iter != frame.blocks_.end(); iter++) {
+            totalSize += iter->size_;
+            delete[] iter->data_;
+        }
+        frame.blocks_.clear();
+        addBlock(frame, totalSize);
+    }
+    frame.current_ = 0;
+    frame.offset_ = 0;
+    frame.usedBytes_ = 0;
+}
+
+void *FrameArena::alloc(uint32_t frameIndex, size_t size, size_t alignment) {
+    assert(frameIndex < frames_.size() && alignment && !(alignment & (alignment - 1)));
+    Frame &frame = frames_[frameIndex];
+    for (;;) {
+        Block &block = frame.blocks_[frame.current_];
+        // 按地址对齐（块本身只保证max_align_t的对齐）
+        uintptr_t begin = (uintptr_t) block.data_ + frame.offset_;
+        uintptr_t aligned = (begin + alignment - 1) & ~(uintptr_t) (alignment - 1);
+        size_t end = aligned - (uintptr_t) block.data_ + size;
+        if (end <= block.size_) {
+            frame.usedBytes_ += end - frame.offset_;
+            frame.offset_ = end;
+            return (void *) aligned;
+        }
+        // 当前块放不下：使用下一个块，没有时追加
+        if (frame.current_ + 1 >= frame.blocks_.size()) addBlock(frame, size + alignment);
+        frame.current_++;
+        frame.offset_ = 0;
+    }
+}
+
+size_t FrameArena::getUsedBytes(uint32_t frameIndex) {
+    return frames_[frameIndex].usedBytes_;
+}
+
+uint64_t FrameArena::getBlockAllocCount() {
+    return blockAllocCount_;
+}
+
+void FrameArena::dump() {
+    LOGI("FrameArena: %llu block allocations", (unsigned long long) blockAllocCount_);
+    for (size_t i = 0; i < frames_.size(); i++) {
+        const Frame &frame = frames_[i];
+        size_t capacity = 0;
+        for (auto iter = frame.blocks_.begin(); iter != frame.blocks_.end(); iter++) capacity += iter->size_;
+        LOGI("\tframe %zu: used %zu bytes, peak %zu bytes, %zu blocks, %zu bytes", i, frame.usedBytes_,
+             std::max(frame.peakBytes_, frame.usedBytes_), frame.blocks_.size(), capacity);
+    }
+}
+
+void FrameArena::addBlock(Frame &frame, size_t minSize) {
+    size_t size = std::max(blockSize_, minSize);
+    frame.blocks_.push_back(Block{new char[size], size});
+    blockAllocCount_++;
+}
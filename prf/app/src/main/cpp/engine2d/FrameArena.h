@@ -0,0 +1,59 @@
+//
+// Created by richardwu on 11/13/24.
+//
+
+#ifndef PRF_FRAMEARENA_H
+#define PRF_FRAMEARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * 每帧的CPU临时内存（绘制记录、顶点的暂存、临时数组等）：每个在途帧一组内存块，分配只是移动指针，
+ * 该帧的fence signal之后整体回卷，不逐个释放
+ * 一帧用量超出时追加新的块；回卷时把多个块合并为一个足够大的块，稳定之后每帧不再有堆分配
+ * 分配得到的内存只在本帧（直到下次reset同一帧）有效，不调用析构函数，只用于平凡类型
+ * 只能在渲染线程上使用
+ */
+class FrameArena
+{
+public:
+    static const size_t DEFAULT_BLOCK_SIZE = 256 * 1024;
+
+    FrameArena(uint32_t framesInFlight, size_t blockSize = DEFAULT_BLOCK_SIZE);
+    ~FrameArena();
+
+    void reset(uint32_t frameIndex); // 该帧的fence已signal，回卷其所有分配
+    void *alloc(uint32_t frameIndex, size_t size, size_t alignment = alignof(std::max_align_t));
+    template <typename T>
+    T *allocArray(uint32_t frameIndex, size_t count) {
+        return (T *) alloc(frameIndex, count * sizeof(T), alignof(T));
+    }
+
+    size_t getUsedBytes(uint32_t frameIndex); // 该帧自上次reset以来分配的字节数（含对齐）
+    uint64_t getBlockAllocCount(); // 向堆申请内存块的次数，稳定之后不再增长
+    void dump(); // 以log的形式打印 for debug
+
+private:
+    struct Block {
+        char *data_;
+        size_t size_;
+    };
+
+    struct Frame {
+        std::vector<Block> blocks_;
+        size_t current_; // 正在使用的块
+        size_t offset_; // 在当前块中已用的字节数
+        size_t usedBytes_;
+        size_t peakBytes_;
+    };
+
+    size_t blockSize_;
+    std::vector<Frame> frames_;
+    uint64_t blockAllocCount_;
+
+    void addBlock(Frame &frame, size_t minSize);
+};
+
+#endif //PRF_FRAMEARENA_H
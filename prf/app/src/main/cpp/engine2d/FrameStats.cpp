@@ -0,0 +1,146 @@
+//
+// Created by richardwu on 11/9/24.
+//
+
+#include "FrameStats.h"
+#include "../log.h"
+
+#include <cstring>
+
+static const char *INTERVAL_NAMES[FRAME_INTERVAL_COUNT] = {
+        "frame", "fence wait", "acquire", "record", "submit", "present", "gpu"};
+
+FrameHistogram::FrameHistogram() {
+    reset();
+}
+
+void FrameHistogram::reset() {
+    memset(buckets_, 0, sizeof(buckets_));
+    count_ = 0;
+    sumMs_ = 0;
+    maxMs_ = 0;
+}
+
+uint32_t FrameHistogram::bucketIndex(uint64_t us) {
+    if (us < 16) return us;
+    if (us >= (1ull << 24)) return BUCKET_COUNT - 1;
+    // exponent >= 4，取最高位之后的3位作为桶内下标
+    uint32_t exponent = 63 - __builtin_clzll(us);
+    return 16 + (exponent - 4) * 8 + ((us >> (exponent - 3)) & 7);
+}
+
+double FrameHistogram::bucketMidMs(uint32_t index) {
+    if (index < 16) return (index + 0.5) / 1000.0;
+    uint32_t exponent = 4 + (index - 16) / 8;
+    uint64_t width = 1ull << (exponent - 3);
+    uint64_t lower = (8 + (index - 16) % 8) * width;
+    return (lower + width / 2.0) / 1000.0;
+}
+
+void FrameHistogram::add(double ms) {
+    if (ms < 0) return;
+    buckets_[bucketIndex((uint64_t) (ms * 1000.0))]++;
+    count_++;
+    sumMs_ += ms;
+    if (ms > maxMs_) maxMs_ = ms;
+}
+
+uint64_t FrameHistogram::getCount() {
+    return count_;
+}
+
+double FrameHistogram::getMeanMs() {
+    return count_ ? sumMs_ / count_ : 0;
+}
+
+double FrameHistogram::getMaxMs() {
+    return maxMs_;
+}
+
+double FrameHistogram::getPercentileMs(double percentile) {
+    if (count_ == 0) return 0;
+    // 第rank个样本（从1开始）所在的桶
+    uint64_t rank = (uint64_t) (percentile / 100.0 * count_ + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > count_) rank = count_;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += buckets_[i];
+        if (seen >= rank) {
+            double mid = bucketMidMs(i);
+            return mid < maxMs_ ? mid : maxMs_;
+        }
+    }
+    return maxMs_;
+}
+
+FrameStats::FrameStats(double budgetMs) {
+    budgetMs_ = budgetMs;
+    reset();
+}
+
+void FrameStats::addFrame(const FrameTimes &times) {
+    std::unique_lock<std::mutex> locker(mutex_);
+    for (uint32_t i = 0; i < FRAME_INTERVAL_COUNT; i++) {
+        histograms_[i].add(times.ms_[i]);
+    }
+    frames_++;
+
+    // 超出预算时，记下CPU上耗时最长的一段
+    if (times.ms_[FRAME_INTERVAL_FRAME] > budgetMs_) {
+        overBudgetFrames_++;
+        uint32_t cause = FRAME_INTERVAL_FENCE_WAIT;
+        for (uint32_t i = FRAME_INTERVAL_FENCE_WAIT; i <= FRAME_INTERVAL_PRESENT; i++) {
+            if (times.ms_[i] > times.ms_[cause]) cause = i;
+        }
+        slowFrameCauses_[cause]++;
+    }
+}
+
+void FrameStats::addSample(FrameInterval interval, double ms) {
+    std::unique_lock<std::mutex> locker(mutex_);
+    histograms_[interval].add(ms);
+}
+
+void FrameStats::getSummary(FrameStatsSummary *summary) {
+    std::unique_lock<std::mutex> locker(mutex_);
+    summary->frames_ = frames_;
+    summary->overBudgetFrames_ = overBudgetFrames_;
+    summary->budgetMs_ = budgetMs_;
+    for (uint32_t i = 0; i < FRAME_INTERVAL_COUNT; i++) {
+        FrameHistogram &histogram = histograms_[i];
+        FrameIntervalSummary &interval = summary->intervals_[i];
+        interval.count_ = histogram.getCount();
+        interval.meanMs_ = histogram.getMeanMs();
+        interval.p50Ms_ = histogram.getPercentileMs(50);
+        interval.p90Ms_ = histogram.getPercentileMs(90);
+        interval.p99Ms_ = histogram.getPercentileMs(99);
+        interval.maxMs_ = histogram.getMaxMs();
+        summary->slowFrameCauses_[i] = slowFrameCauses_[i];
+    }
+}
+
+void FrameStats::reset() {
+    std::unique_lock<std::mutex> locker(mutex_);
+    frames_ = 0;
+    overBudgetFrames_ = 0;
+    for (uint32_t i = 0; i < FRAME_INTERVAL_COUNT; i++) {
+        histograms_[i].reset();
+        slowFrameCauses_[i] = 0;
+    }
+}
+
+void FrameStats::dump() {
+    FrameStatsSummary summary;
+    getSummary(&summary);
+
+    LOGI("frame stats: %d frames, %d over the %.2f ms budget", (int) summary.frames_,
+         (int) summary.overBudgetFrames_, summary.budgetMs_);
+    for (uint32_t i = 0; i < FRAME_INTERVAL_COUNT; i++) {
+        const FrameIntervalSummary &interval = summary.intervals_[i];
+        if (interval.count_ == 0) continue;
+        LOGI("\t%-10s mean %.3f p50 %.3f p90 %.3f p99 %.3f max %.3f ms, slowest in %d slow frames",
+             INTERVAL_NAMES[i], interval.meanMs_, interval.p50Ms_, interval.p90Ms_, interval.p99Ms_,
+             interval.maxMs_, (int) summary.slowFrameCauses_[i]);
+    }
+}
@@ -0,0 +1,100 @@
+//
+// Created by richardwu on 11/9/24.
+//
+
+#ifndef PRF_FRAMESTATS_H
+#define PRF_FRAMESTATS_H
+
+#include <cstdint>
+#include <mutex>
+
+// 一帧中分别统计的时间段
+enum FrameInterval {
+    FRAME_INTERVAL_FRAME = 0, // 相邻两帧开始之间的时间，超出预算即为掉帧
+    FRAME_INTERVAL_FENCE_WAIT, // 等待该在途帧上一次提交完成（GPU落后于CPU）
+    FRAME_INTERVAL_ACQUIRE, // vkAcquireNextImageKHR
+    FRAME_INTERVAL_RECORD, // 场景、上传与指令录制
+    FRAME_INTERVAL_SUBMIT, // vkQueueSubmit
+    FRAME_INTERVAL_PRESENT, // vkQueuePresentKHR
+    FRAME_INTERVAL_GPU, // GPU时间戳测得的本帧GPU时间（晚几帧才到达）
+    FRAME_INTERVAL_COUNT,
+};
+
+// 一帧各时间段的耗时（毫秒），小于0表示本帧没有这一段
+struct FrameTimes {
+    double ms_[FRAME_INTERVAL_COUNT];
+};
+
+// 一个时间段的统计结果
+struct FrameIntervalSummary {
+    uint64_t count_;
+    double meanMs_;
+    double p50Ms_, p90Ms_, p99Ms_; // 来自直方图，相对误差不超过1/16
+    double maxMs_; // 精确值
+};
+
+struct FrameStatsSummary {
+    uint64_t frames_;
+    uint64_t overBudgetFrames_; // FRAME_INTERVAL_FRAME超过预算的帧数
+    double budgetMs_;
+    FrameIntervalSummary intervals_[FRAME_INTERVAL_COUNT];
+    // 超出预算的帧中，CPU上耗时最长的是哪一段（FENCE_WAIT到PRESENT），用于判断掉帧的原因
+    uint64_t slowFrameCauses_[FRAME_INTERVAL_COUNT];
+};
+
+/*
+ * 固定大小的耗时直方图（以微秒为单位的对数线性分桶，与HdrHistogram类似）
+ * 16us以下每微秒一个桶，之后每个2的整次幂区间分为8个桶，上限约16秒
+ * 记录一个样本只是几次整数运算，不分配内存
+ */
+class FrameHistogram
+{
+public:
+    FrameHistogram();
+
+    void add(double ms);
+    void reset();
+
+    uint64_t getCount();
+    double getMeanMs();
+    double getMaxMs();
+    double getPercentileMs(double percentile); // percentile取值[0, 100]
+
+    static const uint32_t BUCKET_COUNT = 176;
+
+private:
+    uint32_t buckets_[BUCKET_COUNT];
+    uint64_t count_;
+    double sumMs_;
+    double maxMs_;
+
+    static uint32_t bucketIndex(uint64_t us);
+    static double bucketMidMs(uint32_t index);
+};
+
+/*
+ * 常开的帧时间统计：每帧记录各时间段的耗时，可随时查询各段的p50/p90/p99/max与超出预算的帧数
+ * 所有时间段共用固定大小的直方图，记录一帧不分配内存；加锁后可以在其他线程查询
+ */
+class FrameStats
+{
+public:
+    explicit FrameStats(double budgetMs);
+
+    void addFrame(const FrameTimes &times); // 记录一帧（FRAME_INTERVAL_GPU可以为-1，另由addSample补充）
+    void addSample(FrameInterval interval, double ms); // 单独记录某一段，如晚到的GPU时间
+    void getSummary(FrameStatsSummary *summary);
+    void reset(); // 清空统计，开始新的统计窗口
+
+    void dump(); // 以log的形式打印当前统计 for debug
+
+private:
+    std::mutex mutex_; // 保护下面所有成员
+    double budgetMs_;
+    uint64_t frames_;
+    uint64_t overBudgetFrames_;
+    uint64_t slowFrameCauses_[FRAME_INTERVAL_COUNT];
+    FrameHistogram histograms_[FRAME_INTERVAL_COUNT];
+};
+
+#endif //PRF_FRAMESTATS_H
@@ -0,0 +1,158 @@
+//
+// Created by richardwu on 11/7/24.
+//
+
+#include "GpuProfiler.h"
+#include "../vulkan/utils.h"
+
+GpuProfiler::GpuProfiler(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex,
+                         uint32_t framesInFlight, uint32_t maxScopes) {
+    device_ = device;
+    maxScopes_ = maxScopes;
+    currentFrame_ = 0;
+    frameNumber_ = 0;
+    openScope_ = -1;
+    hasLatest_ = false;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    timestampPeriod_ = properties.limits.timestampPeriod;
+
+    // timestampValidBits为0表示该队列族不支持时间戳
+    uint32_t queueFamilyCount;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilyProperties.data());
+    uint32_t validBits = queueFamilyProperties[queueFamilyIndex].timestampValidBits;
+    supported_ = validBits != 0 && timestampPeriod_ > 0;
+    timestampMask_ = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+    if (!supported_) {
+        LOGW("gpu profiler: timestamps are not supported on queue family %d", queueFamilyIndex);
+        return;
+    }
+
+    VkQueryPoolCreateInfo queryPoolCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = 2 * maxScopes_, // 每个区间一对
+            .pipelineStatistics = 0,
+    };
+    frames_.resize(framesInFlight);
+    for (auto iter = frames_.begin(); iter != frames_.end(); iter++) {
+        CALL_VK(vkCreateQueryPool(device_, &queryPoolCreateInfo, nullptr, &iter->queryPool_));
+        iter->frameNumber_ = 0;
+        iter->scopes_.reserve(maxScopes_);
+    }
+    timestamps_.resize(2 * maxScopes_);
+    latest_.scopes_.reserve(maxScopes_);
+    LOGI("gpu profiler: timestamp period %.2f ns, %d valid bits", timestampPeriod_, validBits);
+}
+
+GpuProfiler::~GpuProfiler() {
+    for (auto iter = frames_.begin(); iter != frames_.end(); iter++) {
+        vkDestroyQueryPool(device_, iter->queryPool_, nullptr);
+    }
+}
+
+bool GpuProfiler::isSupported() {
+    return supported_;
+}
+
+bool GpuProfiler::beginFrame(uint32_t frameIndex, VkCommandBuffer cmdBuffer) {
+    if (!supported_) return false;
+    assert(frameIndex < frames_.size());
+    assert(openScope_ == -1); // 上一帧的区间必须都已结束
+
+    // 该在途帧的fence已signal，上一次写入的时间戳都已可用
+    Frame &frame = frames_[frameIndex];
+    bool resolved = resolve(frame);
+
+    // 重置必须在render pass之外
+    vkCmdResetQueryPool(cmdBuffer, frame.queryPool_, 0, 2 * maxScopes_);
+    frame.scopes_.clear();
+    frame.frameNumber_ = frameNumber_++;
+    currentFrame_ = frameIndex;
+    openScope_ = -1;
+    return resolved;
+}
+
+uint32_t GpuProfiler::beginScope(VkCommandBuffer cmdBuffer, const char *name) {
+    if (!supported_) return GPU_PROFILER_INVALID_SCOPE;
+    Frame &frame = frames_[currentFrame_];
+    if (frame.scopes_.size() >= maxScopes_) return GPU_PROFILER_INVALID_SCOPE;
+
+    uint32_t scope = frame.scopes_.size();
+    GpuProfileScope profileScope{};
+    profileScope.name_ = name;
+    profileScope.parent_ = openScope_;
+    profileScope.depth_ = openScope_ < 0 ? 0 : frame.scopes_[openScope_].depth_ + 1;
+    frame.scopes_.push_back(profileScope);
+    openScope_ = scope;
+
+    vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool_, 2 * scope);
+    return scope;
+}
+
+void GpuProfiler::endScope(VkCommandBuffer cmdBuffer, uint32_t scope) {
+    if (scope == GPU_PROFILER_INVALID_SCOPE) return;
+    Frame &frame = frames_[currentFrame_];
+    assert((int32_t) scope == openScope_); // 区间只能按嵌套顺序结束
+
+    // 之前的所有命令都执行完毕后写入
+    vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.queryPool_, 2 * scope + 1);
+    openScope_ = frame.scopes_[scope].parent_;
+}
+
+bool GpuProfiler::getLatestProfile(GpuFrameProfile *profile) {
+    if (!hasLatest_) return false;
+    *profile = latest_;
+    return true;
+}
+
+bool GpuProfiler::resolve(Frame &frame) {
+    uint32_t scopeCount = frame.scopes_.size();
+    if (scopeCount == 0) return false;
+
+    // 不带WAIT_BIT：fence已signal，这里不会阻塞；万一未就绪则丢弃这一帧
+    VkResult result = vkGetQueryPoolResults(device_, frame.queryPool_, 0, 2 * scopeCount,
+                                            2 * scopeCount * sizeof(uint64_t), timestamps_.data(),
+                                            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        LOGW("gpu profiler: results of frame %d are not available (%d)", (int) frame.frameNumber_, result);
+        return false;
+    }
+
+    latest_.frameNumber_ = frame.frameNumber_;
+    latest_.totalNs_ = 0;
+    latest_.scopes_ = frame.scopes_;
+    const uint64_t base = timestamps_[0];
+    for (uint32_t i = 0; i < scopeCount; i++) {
+        GpuProfileScope &scope = latest_.scopes_[i];
+        uint64_t begin = timestamps_[2 * i];
+        uint64_t end = timestamps_[2 * i + 1];
+        // 只有低timestampValidBits位有效，相减后取模可以处理回绕
+        scope.beginNs_ = ((begin - base) & timestampMask_) * timestampPeriod_;
+        scope.durationNs_ = ((end - begin) & timestampMask_) * timestampPeriod_;
+        if (scope.parent_ < 0) latest_.totalNs_ += scope.durationNs_;
+    }
+    hasLatest_ = true;
+    return true;
+}
+
+uint64_t GpuProfiler::getLatestTotalNs() {
+    return hasLatest_ ? latest_.totalNs_ : 0;
+}
+
+void GpuProfiler::dump() {
+    if (!hasLatest_) {
+        LOGI("gpu profiler: no results yet");
+        return;
+    }
+    LOGI("gpu profiler: frame %d, %.3f ms", (int) latest_.frameNumber_, latest_.totalNs_ / 1e6);
+    for (auto iter = latest_.scopes_.begin(); iter != latest_.scopes_.end(); iter++) {
+        LOGI("\t%*s%s: %.3f ms (+%.3f ms)", (int) iter->depth_ * 2, "", iter->name_,
+             iter->durationNs_ / 1e6, iter->beginNs_ / 1e6);
+    }
+}
@@ -0,0 +1,87 @@
+//
+// Created by richardwu on 11/7/24.
+//
+
+#ifndef PRF_GPUPROFILER_H
+#define PRF_GPUPROFILER_H
+
+#include <vulkan_wrapper.h>
+
+#include <cstdint>
+#include <vector>
+
+// 一个计时区间的结果
+struct GpuProfileScope {
+    const char *name_; // beginScope时传入的名字（需为静态字符串）
+    int32_t parent_; // 父区间在scopes_中的下标，-1表示顶层
+    uint32_t depth_; // 嵌套深度，顶层为0
+    uint64_t beginNs_; // 相对于本帧第一个区间开始的时间
+    uint64_t durationNs_;
+};
+
+// 一帧的GPU计时：区间按开始的先后排列（即树的先序遍历）
+struct GpuFrameProfile {
+    uint64_t frameNumber_; // 第几次beginFrame，从0开始
+    uint64_t totalNs_; // 所有顶层区间的时长之和
+    std::vector<GpuProfileScope> scopes_;
+};
+
+const uint32_t GPU_PROFILER_INVALID_SCOPE = UINT32_MAX;
+
+/*
+ * 基于VkQueryPool时间戳的GPU计时
+ * 每个在途帧一个query pool，每个区间占用一对query（开始、结束）；
+ * 在该在途帧下一次beginFrame时（其fence已signal）读回结果，不需要额外等待GPU
+ * 读回的帧比当前帧晚framesInFlight帧，时间戳按timestampPeriod换算为纳秒
+ * 队列不支持时间戳时所有调用都是空操作
+ */
+class GpuProfiler
+{
+public:
+    GpuProfiler(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex,
+                uint32_t framesInFlight, uint32_t maxScopes = DEFAULT_MAX_SCOPES);
+    ~GpuProfiler(); // 销毁所有query pool
+
+    static const uint32_t DEFAULT_MAX_SCOPES = 256; // 每帧最多的区间数，超出的区间被忽略
+
+    bool isSupported();
+
+    // 在frameIndex的fence signal之后、vkBeginCommandBuffer之后（render pass之外）调用
+    // 读回该在途帧上一次的结果，并在cmdBuffer中重置其query pool；读回了新的一帧时返回true
+    bool beginFrame(uint32_t frameIndex, VkCommandBuffer cmdBuffer);
+    // 开始一个区间（可嵌套），返回的编号交给endScope；只能在录制primary指令缓冲的线程上调用
+    uint32_t beginScope(VkCommandBuffer cmdBuffer, const char *name);
+    void endScope(VkCommandBuffer cmdBuffer, uint32_t scope);
+
+    bool getLatestProfile(GpuFrameProfile *profile); // 最近一次读回的结果，还没有时返回false
+    uint64_t getLatestTotalNs(); // 最近一次读回的帧的totalNs_，不拷贝区间
+
+    void dump(); // 以log的形式打印最近一帧的区间树 for debug
+
+private:
+    // 每个在途帧的query pool与本帧录制的区间
+    struct Frame {
+        VkQueryPool queryPool_;
+        uint64_t frameNumber_;
+        std::vector<GpuProfileScope> scopes_; // 录制时只填name_、parent_、depth_
+    };
+
+    VkDevice device_;
+    bool supported_;
+    double timestampPeriod_; // 一个时间戳单位的纳秒数
+    uint64_t timestampMask_; // timestampValidBits之外的位无效
+    uint32_t maxScopes_;
+
+    std::vector<Frame> frames_;
+    uint32_t currentFrame_;
+    uint64_t frameNumber_;
+    int32_t openScope_; // 当前最内层未结束的区间，-1表示没有
+
+    std::vector<uint64_t> timestamps_; // 读回时使用，避免每帧分配
+    GpuFrameProfile latest_;
+    bool hasLatest_;
+
+    bool resolve(Frame &frame);
+};
+
+#endif //PRF_GPUPROFILER_H
@@ -0,0 +1,213 @@
+//
+// Created by richardwu on 10/25/24.
+//
+
+#include "MemoryArena.h"
+#include "../vulkan/utils.h"
+
+#include <iterator>
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    if (alignment <= 1) return value;
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+MemoryArena::MemoryArena(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize blockSize) {
+    device_ = device;
+    blockSize_ = blockSize;
+    nextBlockId_ = 0;
+
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties_);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    maxAllocationCount_ = properties.limits.maxMemoryAllocationCount;
+}
+
+MemoryArena::~MemoryArena() {
+    std::unique_lock<std::mutex> locker(mutex_);
+    // 释放所有的VkDeviceMemory（映射会随vkFreeMemory一起解除）
+    for (auto iter = blocks_.begin(); iter != blocks_.end(); iter++) {
+        if (iter->second.usedBytes_ != 0) {
+            LOGW("memory arena: block %d still has %d bytes in use", iter->first,
+                 (int) iter->second.usedBytes_);
+        }
+        vkFreeMemory(device_, iter->second.memory_, nullptr);
+    }
+    blocks_.clear();
+}
+
+bool MemoryArena::alloc(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+                        VulkanMemoryAllocation *allocation) {
+    std::unique_lock<std::mutex> locker(mutex_);
+
+    uint32_t memoryTypeIndex;
+    if (!mapMemoryTypeToIndex(requirements.memoryTypeBits, properties, &memoryTypeIndex)) {
+        LOGE("memory arena: no memory type for bits 0x%x, properties 0x%x",
+             requirements.memoryTypeBits, properties);
+        return false;
+    }
+
+    // 先在已有的同类型块中寻找（first-fit）
+    uint32_t blockId = 0;
+    Block *block = nullptr;
+    VkDeviceSize offset = 0;
+    for (auto iter = blocks_.begin(); iter != blocks_.end(); iter++) {
+        if (iter->second.memoryTypeIndex_ != memoryTypeIndex) continue;
+        if (carve(iter->second, requirements.size, requirements.alignment, &offset)) {
+            blockId = iter->first;
+            block = &iter->second;
+            break;
+        }
+    }
+
+    // 没有合适的空闲区间，向驱动申请新块（超大的请求单独成块）
+    if (block == nullptr) {
+        VkDeviceSize size = requirements.size > blockSize_ ? requirements.size : blockSize_;
+        block = createBlock(memoryTypeIndex, size, &blockId);
+        if (block == nullptr) return false;
+        bool carved = carve(*block, requirements.size, requirements.alignment, &offset);
+        assert(carved);
+        (void) carved;
+    }
+
+    allocation->memory_ = block->memory_;
+    allocation->offset_ = offset;
+    allocation->size_ = requirements.size;
+    allocation->mapped_ = block->mapped_ ? (char *) block->mapped_ + offset : nullptr;
+    allocation->blockId_ = blockId;
+    return true;
+}
+
+void MemoryArena::free(const VulkanMemoryAllocation &allocation) {
+    std::unique_lock<std::mutex> locker(mutex_);
+    auto blockIter = blocks_.find(allocation.blockId_);
+    assert(blockIter != blocks_.end());
+    Block &block = blockIter->second;
+
+    // 插入空闲区间，并与前后相邻的区间合并
+    auto iter = block.freeRanges_.insert(std::make_pair(allocation.offset_, allocation.size_)).first;
+    auto next = std::next(iter);
+    if (next != block.freeRanges_.end() && iter->first + iter->second == next->first) {
+        iter->second += next->second;
+        block.freeRanges_.erase(next);
+    }
+    if (iter != block.freeRanges_.begin()) {
+        auto prev = std::prev(iter);
+        if (prev->first + prev->second == iter->first) {
+            prev->second += iter->second;
+            block.freeRanges_.erase(iter);
+        }
+    }
+    block.usedBytes_ -= allocation.size_;
+
+    // 块已完全空闲：若还有其他同类型的块则将其还给驱动，否则留作备用
+    if (block.usedBytes_ == 0) {
+        for (auto other = blocks_.begin(); other != blocks_.end(); other++) {
+            if (other != blockIter && other->second.memoryTypeIndex_ == block.memoryTypeIndex_) {
+                vkFreeMemory(device_, block.memory_, nullptr);
+                blocks_.erase(blockIter);
+                break;
+            }
+        }
+    }
+}
+
+uint32_t MemoryArena::getAllocationCount() {
+    std::unique_lock<std::mutex> locker(mutex_);
+    return blocks_.size();
+}
+
+VkDeviceSize MemoryArena::getAllocatedBytes() {
+    std::unique_lock<std::mutex> locker(mutex_);
+    VkDeviceSize bytes = 0;
+    for (auto iter = blocks_.begin(); iter != blocks_.end(); iter++) {
+        bytes += iter->second.size_;
+    }
+    return bytes;
+}
+
+VkDeviceSize MemoryArena::getUsedBytes() {
+    std::unique_lock<std::mutex> locker(mutex_);
+    VkDeviceSize bytes = 0;
+    for (auto iter = blocks_.begin(); iter != blocks_.end(); iter++) {
+        bytes += iter->second.usedBytes_;
+    }
+    return bytes;
+}
+
+/* 在块中切出一段对齐后的区间，对齐产生的前后空隙仍留在空闲列表中 */
+bool MemoryArena::carve(Block &block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *offset) {
+    for (auto iter = block.freeRanges_.begin(); iter != block.freeRanges_.end(); iter++) {
+        VkDeviceSize rangeBegin = iter->first;
+        VkDeviceSize rangeEnd = iter->first + iter->second;
+        VkDeviceSize alignedBegin = alignUp(rangeBegin, alignment);
+        if (alignedBegin + size > rangeEnd) continue;
+
+        block.freeRanges_.erase(iter);
+        if (alignedBegin > rangeBegin) {
+            block.freeRanges_[rangeBegin] = alignedBegin - rangeBegin;
+        }
+        if (alignedBegin + size < rangeEnd) {
+            block.freeRanges_[alignedBegin + size] = rangeEnd - (alignedBegin + size);
+        }
+        block.usedBytes_ += size;
+        *offset = alignedBegin;
+        return true;
+    }
+    return false;
+}
+
+MemoryArena::Block *MemoryArena::createBlock(uint32_t memoryTypeIndex, VkDeviceSize size, uint32_t *blockId) {
+    if (blocks_.size() >= maxAllocationCount_) {
+        LOGE("memory arena: maxMemoryAllocationCount (%d) reached", maxAllocationCount_);
+        return nullptr;
+    }
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+    Block block;
+    CALL_VK(vkAllocateMemory(device_, &allocInfo, nullptr, &block.memory_));
+    block.memoryTypeIndex_ = memoryTypeIndex;
+    block.size_ = size;
+    block.usedBytes_ = 0;
+    block.mapped_ = nullptr;
+    block.freeRanges_[0] = size;
+
+    // HOST_VISIBLE的块整体映射一次（同一VkDeviceMemory不能被重复映射）
+    if (memoryProperties_.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        CALL_VK(vkMapMemory(device_, block.memory_, 0, VK_WHOLE_SIZE, 0, &block.mapped_));
+    }
+
+    *blockId = nextBlockId_++;
+    return &(blocks_[*blockId] = block);
+}
+
+bool MemoryArena::mapMemoryTypeToIndex(uint32_t typeBits, VkFlags requirements_mask, uint32_t *typeIndex) {
+    // Search mem types to find first index with those properties
+    for (uint32_t i = 0; i < memoryProperties_.memoryTypeCount; i++) {
+        if ((typeBits & 1) == 1) {
+            // Type is available, does it match user properties?
+            if ((memoryProperties_.memoryTypes[i].propertyFlags & requirements_mask) ==
+                requirements_mask) {
+                *typeIndex = i;
+                return true;
+            }
+        }
+        typeBits >>= 1;
+    }
+    return false;
+}
+
+void MemoryArena::dump() {
+    std::unique_lock<std::mutex> locker(mutex_);
+    LOGI("memory arena: %d blocks", (int) blocks_.size());
+    for (auto iter = blocks_.begin(); iter != blocks_.end(); iter++) {
+        LOGI("\t[%d] type %d, used %d / %d bytes, %d free ranges", iter->first,
+             iter->second.memoryTypeIndex_, (int) iter->second.usedBytes_,
+             (int) iter->second.size_, (int) iter->second.freeRanges_.size());
+    }
+}
@@ -0,0 +1,72 @@
+//
+// Created by richardwu on 10/25/24.
+//
+
+#ifndef PRF_MEMORYARENA_H
+#define PRF_MEMORYARENA_H
+
+#include <vulkan_wrapper.h>
+
+#include <map>
+#include <mutex>
+
+// 一次子分配的结果
+struct VulkanMemoryAllocation {
+    VkDeviceMemory memory_; // 所在的VkDeviceMemory块
+    VkDeviceSize offset_; // 在块内的偏移（已按VkMemoryRequirements::alignment对齐）
+    VkDeviceSize size_; // 子分配的大小
+    void *mapped_; // HOST_VISIBLE内存持久映射后的CPU地址（已加上offset_），否则为nullptr
+    uint32_t blockId_; // 所属块的编号，释放时使用
+};
+
+/*
+ * 设备内存池：以较大的VkDeviceMemory块为单位向驱动申请内存，
+ * 再按照offset/size切分给各个VkBuffer使用
+ * 这样真实的vkAllocateMemory次数只与总内存量有关，而与缓冲的数量无关
+ */
+class MemoryArena
+{
+public:
+    static const VkDeviceSize DEFAULT_BLOCK_SIZE = 8L * 1024 * 1024;
+
+    MemoryArena(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+    ~MemoryArena(); // 释放所有的VkDeviceMemory块
+
+    // 按照requirements（大小、对齐、可用的内存类型）与properties申请一段内存
+    bool alloc(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+               VulkanMemoryAllocation *allocation);
+    void free(const VulkanMemoryAllocation &allocation); // 归还一段内存，与相邻空闲区间合并
+
+    uint32_t getAllocationCount(); // 当前真实的vkAllocateMemory次数（即块的数量）
+    VkDeviceSize getAllocatedBytes(); // 向驱动申请的总字节数
+    VkDeviceSize getUsedBytes(); // 已切分出去的总字节数
+
+    void dump(); // 以log的形式打印 for debug
+
+private:
+    // 一个VkDeviceMemory块
+    struct Block {
+        VkDeviceMemory memory_;
+        uint32_t memoryTypeIndex_;
+        VkDeviceSize size_;
+        VkDeviceSize usedBytes_;
+        void *mapped_; // HOST_VISIBLE的块在创建时整体映射一次，直到释放
+        std::map<VkDeviceSize, VkDeviceSize> freeRanges_; // 空闲区间，offset -> size（按offset有序，便于合并）
+    };
+
+    VkDevice device_;
+    VkPhysicalDeviceMemoryProperties memoryProperties_;
+    uint32_t maxAllocationCount_;
+    VkDeviceSize blockSize_;
+
+    std::mutex mutex_; // 保护下面的blocks_
+
+    std::map<uint32_t, Block> blocks_; // blockId -> 块
+    uint32_t nextBlockId_;
+
+    bool mapMemoryTypeToIndex(uint32_t typeBits, VkFlags requirements_mask, uint32_t *typeIndex);
+    Block *createBlock(uint32_t memoryTypeIndex, VkDeviceSize size, uint32_t *blockId);
+    bool carve(Block &block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *offset);
+};
+
+#endif //PRF_MEMORYARENA_H
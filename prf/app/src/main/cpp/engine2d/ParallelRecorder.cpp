@@ -0,0 +1,167 @@
+//
+// Created by richardwu on 10/28/24.
+//
+
+#include "ParallelRecorder.h"
+#include "Trace.h"
+#include "../vulkan/utils.h"
+
+ParallelRecorder::ParallelRecorder(VkDevice device, uint32_t queueFamilyIndex, uint32_t threadCount,
+                                   uint32_t framesInFlight) {
+    device_ = device;
+    exit_ = false;
+    jobGeneration_ = 0;
+    pendingWorkers_ = 0;
+    jobSliceCount_ = 0;
+    jobRecordFunc_ = nullptr;
+    jobContext_ = nullptr;
+
+    if (threadCount == 0) threadCount = 1;
+    workers_.resize(threadCount);
+    secondaryBuffers_.reserve(threadCount);
+
+    // 每个线程、每个在途帧一个指令池，重置时整池一起重置，不需要RESET_COMMAND_BUFFER_BIT
+    VkCommandPoolCreateInfo cmdPoolCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = queueFamilyIndex,
+    };
+    for (uint32_t i = 0; i < threadCount; i++) {
+        Worker &worker = workers_[i];
+        worker.cmdPools_.resize(framesInFlight);
+        worker.cmdBuffers_.resize(framesInFlight);
+        for (uint32_t frame = 0; frame < framesInFlight; frame++) {
+            CALL_VK(vkCreateCommandPool(device_, &cmdPoolCreateInfo, nullptr, &worker.cmdPools_[frame]));
+            VkCommandBufferAllocateInfo cmdBufferCreateInfo{
+                    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                    .pNext = nullptr,
+                    .commandPool = worker.cmdPools_[frame],
+                    .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+                    .commandBufferCount = 1,
+            };
+            CALL_VK(vkAllocateCommandBuffers(device_, &cmdBufferCreateInfo, &worker.cmdBuffers_[frame]));
+        }
+    }
+
+    for (uint32_t i = 0; i < threadCount; i++) {
+        workers_[i].thread_ = std::thread(&ParallelRecorder::workerLoop, this, i);
+    }
+    LOGI("parallel recorder: %d threads", threadCount);
+}
+
+ParallelRecorder::~ParallelRecorder() {
+    {
+        std::unique_lock<std::mutex> locker(mutex_);
+        exit_ = true;
+    }
+    jobCond_.notify_all();
+
+    for (auto iter = workers_.begin(); iter != workers_.end(); iter++) {
+        iter->thread_.join();
+        // 销毁指令池时其中的指令缓冲一并释放
+        for (auto pool = iter->cmdPools_.begin(); pool != iter->cmdPools_.end(); pool++) {
+            vkDestroyCommandPool(device_, *pool, nullptr);
+        }
+    }
+}
+
+uint32_t ParallelRecorder::getThreadCount() {
+    return workers_.size();
+}
+
+const std::vector<VkCommandBuffer> &ParallelRecorder::record(uint32_t frameIndex, VkRenderPass renderPass,
+                                                             VkFramebuffer framebuffer, uint32_t drawCount,
+                                                             RecordFunc recordFunc, void *context) {
+    secondaryBuffers_.clear();
+    if (drawCount == 0) return secondaryBuffers_;
+
+    // 切片数：不超过线程数，且每片至少MIN_DRAWS_PER_THREAD个绘制
+    uint32_t sliceCount = (drawCount + MIN_DRAWS_PER_THREAD - 1) / MIN_DRAWS_PER_THREAD;
+    if (sliceCount > workers_.size()) sliceCount = workers_.size();
+
+    {
+        std::unique_lock<std::mutex> locker(mutex_);
+        jobFrameIndex_ = frameIndex;
+        jobInheritance_ = VkCommandBufferInheritanceInfo{
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+                .pNext = nullptr,
+                .renderPass = renderPass,
+                .subpass = 0,
+                .framebuffer = framebuffer,
+                .occlusionQueryEnable = VK_FALSE,
+                .queryFlags = 0,
+                .pipelineStatistics = 0,
+        };
+        jobRecordFunc_ = recordFunc;
+        jobContext_ = context;
+        jobSliceCount_ = sliceCount;
+        jobDrawCount_ = drawCount;
+        pendingWorkers_ = workers_.size();
+        jobGeneration_++;
+    }
+    jobCond_.notify_all();
+
+    // 等待所有工作线程完成（没有分到切片的线程也会确认一次）
+    {
+        std::unique_lock<std::mutex> locker(mutex_);
+        doneCond_.wait(locker, [this] { return pendingWorkers_ == 0; });
+        jobRecordFunc_ = nullptr;
+        jobContext_ = nullptr;
+    }
+
+    for (uint32_t i = 0; i < sliceCount; i++) {
+        secondaryBuffers_.push_back(workers_[i].cmdBuffers_[frameIndex]);
+    }
+    return secondaryBuffers_;
+}
+
+void ParallelRecorder::workerLoop(uint32_t workerIndex) {
+    TraceSetThreadName("record worker");
+    uint64_t seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> locker(mutex_);
+            jobCond_.wait(locker, [this, seenGeneration] { return exit_ || jobGeneration_ != seenGeneration; });
+            if (exit_) return;
+            seenGeneration = jobGeneration_;
+        }
+
+        // 任务参数在pendingWorkers_归零之前不会被修改，可以不加锁读取
+        if (workerIndex < jobSliceCount_) {
+            recordSlice(workerIndex);
+        }
+
+        {
+            std::unique_lock<std::mutex> locker(mutex_);
+            if (--pendingWorkers_ == 0) {
+                doneCond_.notify_one();
+            }
+        }
+    }
+}
+
+void ParallelRecorder::recordSlice(uint32_t workerIndex) {
+    TRACE_SCOPE("ParallelRecorder::recordSlice");
+    Worker &worker = workers_[workerIndex];
+    VkCommandBuffer cmdBuffer = worker.cmdBuffers_[jobFrameIndex_];
+
+    // 该帧的fence已signal，整池重置比逐个重置指令缓冲更便宜
+    CALL_VK(vkResetCommandPool(device_, worker.cmdPools_[jobFrameIndex_], 0));
+
+    VkCommandBufferBeginInfo cmdBufferBeginInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .pNext = nullptr,
+            .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+                     VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            .pInheritanceInfo = &jobInheritance_,
+    };
+    CALL_VK(vkBeginCommandBuffer(cmdBuffer, &cmdBufferBeginInfo));
+
+    // 均分[0, jobDrawCount_)
+    uint32_t begin = (uint64_t) jobDrawCount_ * workerIndex / jobSliceCount_;
+    uint32_t end = (uint64_t) jobDrawCount_ * (workerIndex + 1) / jobSliceCount_;
+    jobRecordFunc_(jobContext_, cmdBuffer, begin, end);
+
+    CALL_VK(vkEndCommandBuffer(cmdBuffer));
+}
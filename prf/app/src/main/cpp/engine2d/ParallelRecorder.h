@@ -0,0 +1,76 @@
+//
+// Created by richardwu on 10/28/24.
+//
+
+#ifndef PRF_PARALLELRECORDER_H
+#define PRF_PARALLELRECORDER_H
+
+#include <vulkan_wrapper.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 录制绘制列表中[begin, end)这一段到cmdBuffer中，context为record()时传入的指针
+// secondary command buffer不继承primary中绑定的管线、缓冲等状态，需要在函数内重新绑定
+// 普通的函数指针而不是std::function：每帧的录制参数由调用者放在context中，不会因捕获过多而在堆上分配
+typedef void (*RecordFunc)(void *context, VkCommandBuffer cmdBuffer, uint32_t begin, uint32_t end);
+
+/*
+ * 多线程录制指令
+ * 每个工作线程为每个在途帧拥有独立的VkCommandPool（VkCommandPool不能被多个线程同时使用），
+ * 将绘制列表的一段录制到VK_COMMAND_BUFFER_LEVEL_SECONDARY的指令缓冲中，
+ * 再由primary指令缓冲通过vkCmdExecuteCommands执行
+ */
+class ParallelRecorder
+{
+public:
+    ParallelRecorder(VkDevice device, uint32_t queueFamilyIndex, uint32_t threadCount, uint32_t framesInFlight);
+    ~ParallelRecorder(); // 结束所有工作线程，释放VkCommandPool
+
+    // 将[0, drawCount)切片并交给工作线程录制，阻塞直到全部录制完成
+    // 调用前frameIndex对应的fence必须已经signal（其指令池会被重置）
+    // 各工作线程以recordFunc(context, ...)录制自己的切片，context在record()返回之前必须有效
+    // 按切片顺序返回录制好的secondary command buffer，需在以VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS开始的
+    // render pass中执行；返回的数组在下一次record()之前有效
+    const std::vector<VkCommandBuffer> &record(uint32_t frameIndex, VkRenderPass renderPass,
+                                               VkFramebuffer framebuffer, uint32_t drawCount,
+                                               RecordFunc recordFunc, void *context);
+
+    uint32_t getThreadCount();
+
+    const uint32_t MIN_DRAWS_PER_THREAD = 256; // 切片太小时多线程得不偿失
+
+private:
+    // 每个工作线程的资源
+    struct Worker {
+        std::thread thread_;
+        std::vector<VkCommandPool> cmdPools_; // 每个在途帧一个
+        std::vector<VkCommandBuffer> cmdBuffers_; // 每个在途帧一个secondary command buffer
+    };
+
+    VkDevice device_;
+    std::vector<Worker> workers_;
+    std::vector<VkCommandBuffer> secondaryBuffers_; // 最近一次record()的结果，容量为线程数，不再分配
+
+    std::mutex mutex_; // 保护下面的任务状态
+    std::condition_variable jobCond_; // 通知工作线程有新任务
+    std::condition_variable doneCond_; // 通知录制线程所有切片都已完成
+    bool exit_;
+    uint64_t jobGeneration_; // 每次record()递增，工作线程据此判断是否有新任务
+    uint32_t pendingWorkers_;
+
+    // 当前任务
+    uint32_t jobFrameIndex_;
+    VkCommandBufferInheritanceInfo jobInheritance_;
+    RecordFunc jobRecordFunc_;
+    void *jobContext_;
+    uint32_t jobSliceCount_;
+    uint32_t jobDrawCount_;
+
+    void workerLoop(uint32_t workerIndex);
+    void recordSlice(uint32_t workerIndex);
+};
+
+#endif //PRF_PARALLELRECORDER_H
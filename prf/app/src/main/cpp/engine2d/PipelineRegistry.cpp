@@ -0,0 +1,239 @@
+//
+// Created by richardwu on 11/1/24.
+//
+
+#include "PipelineRegistry.h"
+#include "../vulkan/utils.h"
+
+#include <cstring>
+#include <iterator>
+
+static const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char *) data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static uint64_t fnv1aString(uint64_t hash, const char *str) {
+    return fnv1a(hash, str, strlen(str) + 1);
+}
+
+PipelineRegistry::PipelineRegistry(VkDevice device, const PipelineFactory &factory, ThreadPool *threadPool,
+                                   uint32_t budget, uint32_t framesInFlight) {
+    device_ = device;
+    factory_ = factory;
+    threadPool_ = threadPool;
+    pendingCount_ = 0;
+    budget_ = budget;
+    framesInFlight_ = framesInFlight;
+    frameNumber_ = 0;
+    hitCount_ = 0;
+    missCount_ = 0;
+    evictCount_ = 0;
+}
+
+PipelineRegistry::~PipelineRegistry() {
+    std::unique_lock<std::mutex> locker(mutex_);
+    // 线程池中的编译任务引用了this，必须等它们结束
+    readyCond_.wait(locker, [this] { return pendingCount_ == 0; });
+    for (auto iter = lruList_.begin(); iter != lruList_.end(); iter++) {
+        destroyPipeline(iter->handle_->pipelineInfo_);
+    }
+    lruList_.clear();
+    entries_.clear();
+}
+
+uint64_t PipelineRegistry::hashDesc(const VulkanPipelineDesc &desc) {
+    // 逐字段哈希（结构体中可能有未初始化的填充字节，不能整体哈希）
+    uint64_t hash = FNV_OFFSET_BASIS;
+    hash = fnv1aString(hash, desc.vertexShader_);
+    hash = fnv1aString(hash, desc.fragmentShader_);
+    for (auto iter = desc.bindings_.begin(); iter != desc.bindings_.end(); iter++) {
+        hash = fnv1a(hash, &iter->binding, sizeof(iter->binding));
+        hash = fnv1a(hash, &iter->stride, sizeof(iter->stride));
+        hash = fnv1a(hash, &iter->inputRate, sizeof(iter->inputRate));
+    }
+    for (auto iter = desc.attributes_.begin(); iter != desc.attributes_.end(); iter++) {
+        hash = fnv1a(hash, &iter->location, sizeof(iter->location));
+        hash = fnv1a(hash, &iter->binding, sizeof(iter->binding));
+        hash = fnv1a(hash, &iter->format, sizeof(iter->format));
+        hash = fnv1a(hash, &iter->offset, sizeof(iter->offset));
+    }
+    hash = fnv1a(hash, &desc.pushConstantSize_, sizeof(desc.pushConstantSize_));
+    hash = fnv1a(hash, &desc.setLayout_, sizeof(desc.setLayout_));
+    hash = fnv1a(hash, &desc.blendMode_, sizeof(desc.blendMode_));
+    hash = fnv1a(hash, &desc.topology_, sizeof(desc.topology_));
+    hash = fnv1a(hash, &desc.sampleCount_, sizeof(desc.sampleCount_));
+    hash = fnv1a(hash, &desc.renderPass_, sizeof(desc.renderPass_));
+    return hash;
+}
+
+bool PipelineRegistry::isSameDesc(const VulkanPipelineDesc &a, const VulkanPipelineDesc &b) {
+    if (strcmp(a.vertexShader_, b.vertexShader_) != 0) return false;
+    if (strcmp(a.fragmentShader_, b.fragmentShader_) != 0) return false;
+    if (a.bindings_.size() != b.bindings_.size()) return false;
+    for (size_t i = 0; i < a.bindings_.size(); i++) {
+        if (a.bindings_[i].binding != b.bindings_[i].binding ||
+            a.bindings_[i].stride != b.bindings_[i].stride ||
+            a.bindings_[i].inputRate != b.bindings_[i].inputRate) return false;
+    }
+    if (a.attributes_.size() != b.attributes_.size()) return false;
+    for (size_t i = 0; i < a.attributes_.size(); i++) {
+        if (a.attributes_[i].location != b.attributes_[i].location ||
+            a.attributes_[i].binding != b.attributes_[i].binding ||
+            a.attributes_[i].format != b.attributes_[i].format ||
+            a.attributes_[i].offset != b.attributes_[i].offset) return false;
+    }
+    return a.pushConstantSize_ == b.pushConstantSize_ && a.setLayout_ == b.setLayout_ &&
+           a.blendMode_ == b.blendMode_ && a.topology_ == b.topology_ && a.sampleCount_ == b.sampleCount_ &&
+           a.renderPass_ == b.renderPass_;
+}
+
+VulkanPipelineInfo PipelineRegistry::get(const VulkanPipelineDesc &desc) {
+    PipelineHandle handle = request(desc, nullptr, false);
+    if (!handle->isReady()) {
+        // 已经在线程池中编译，等待其完成
+        std::unique_lock<std::mutex> locker(mutex_);
+        readyCond_.wait(locker, [&handle] { return handle->isReady(); });
+    }
+    return handle->pipelineInfo_;
+}
+
+PipelineHandle PipelineRegistry::getAsync(const VulkanPipelineDesc &desc, const PipelineReadyCallback &callback) {
+    return request(desc, callback, true);
+}
+
+PipelineHandle PipelineRegistry::request(const VulkanPipelineDesc &desc, const PipelineReadyCallback &callback,
+                                         bool async) {
+    uint64_t key = hashDesc(desc);
+    std::unique_lock<std::mutex> locker(mutex_);
+
+    auto range = entries_.equal_range(key);
+    for (auto found = range.first; found != range.second; found++) {
+        Entry &entry = *found->second;
+        if (isSameDesc(entry.desc_, desc)) {
+            // 命中：移到表头
+            hitCount_++;
+            entry.lastUsedFrame_ = frameNumber_;
+            lruList_.splice(lruList_.begin(), lruList_, found->second);
+            PipelineHandle handle = entry.handle_;
+            if (callback) {
+                if (handle->isReady()) {
+                    locker.unlock();
+                    callback(handle->pipelineInfo_);
+                } else {
+                    handle->callbacks_.push_back(callback);
+                }
+            }
+            return handle;
+        }
+    }
+    if (range.first != range.second) {
+        // 哈希碰撞：与已有的管线并存于同一个键下，不替换（旧管线可能仍被在途帧使用）
+        LOGW("pipeline registry: hash collision on %llx", (unsigned long long) key);
+    }
+
+    // 未命中：加入表头，再编译
+    missCount_++;
+    Entry entry;
+    entry.key_ = key;
+    entry.desc_ = desc;
+    entry.handle_ = std::make_shared<PipelineRequest>();
+    entry.handle_->ready_.store(false, std::memory_order_relaxed);
+    entry.lastUsedFrame_ = frameNumber_;
+    lruList_.push_front(entry);
+    entries_.insert(std::make_pair(key, lruList_.begin()));
+    pendingCount_++;
+    locker.unlock();
+
+    PipelineHandle handle = entry.handle_;
+    if (async) {
+        VulkanPipelineDesc descCopy = desc;
+        threadPool_->post([this, descCopy, handle, callback] { compile(descCopy, handle, callback); });
+    } else {
+        compile(desc, handle, callback);
+    }
+    return handle;
+}
+
+void PipelineRegistry::compile(const VulkanPipelineDesc &desc, PipelineHandle handle,
+                               const PipelineReadyCallback &callback) {
+    // 编译不持锁，多个线程可以同时向共享的VkPipelineCache写入（VkPipelineCache内部同步）
+    VulkanPipelineInfo pipelineInfo;
+    factory_(desc, &pipelineInfo);
+
+    std::vector<PipelineReadyCallback> callbacks;
+    {
+        std::unique_lock<std::mutex> locker(mutex_);
+        handle->pipelineInfo_ = pipelineInfo;
+        handle->ready_.store(true, std::memory_order_release);
+        callbacks.swap(handle->callbacks_);
+        pendingCount_--;
+        // 在锁内通知，否则析构函数返回后readyCond_可能已失效
+        readyCond_.notify_all();
+    }
+
+    // 之后不再访问this
+    if (callback) callback(pipelineInfo);
+    for (auto iter = callbacks.begin(); iter != callbacks.end(); iter++) {
+        (*iter)(pipelineInfo);
+    }
+}
+
+void PipelineRegistry::beginFrame() {
+    std::unique_lock<std::mutex> locker(mutex_);
+    frameNumber_++;
+
+    // 从表尾淘汰，直到不超出预算；最近framesInFlight_帧用过的管线可能还在GPU上执行，停止淘汰
+    // 编译中的管线也不能淘汰
+    while (lruList_.size() > budget_) {
+        Entry &entry = lruList_.back();
+        if (!entry.handle_->isReady() || entry.lastUsedFrame_ + framesInFlight_ > frameNumber_) break;
+        destroyPipeline(entry.handle_->pipelineInfo_);
+        eraseEntry(std::prev(lruList_.end()));
+        lruList_.pop_back();
+        evictCount_++;
+    }
+}
+
+void PipelineRegistry::eraseEntry(std::list<Entry>::iterator entry) {
+    auto range = entries_.equal_range(entry->key_);
+    for (auto iter = range.first; iter != range.second; iter++) {
+        if (iter->second == entry) {
+            entries_.erase(iter);
+            return;
+        }
+    }
+}
+
+uint32_t PipelineRegistry::getPipelineCount() {
+    std::unique_lock<std::mutex> locker(mutex_);
+    return lruList_.size();
+}
+
+uint32_t PipelineRegistry::getPendingCount() {
+    std::unique_lock<std::mutex> locker(mutex_);
+    return pendingCount_;
+}
+
+void PipelineRegistry::destroyPipeline(const VulkanPipelineInfo &pipelineInfo) {
+    vkDestroyPipeline(device_, pipelineInfo.pipeline_, nullptr);
+    vkDestroyPipelineLayout(device_, pipelineInfo.layout_, nullptr);
+}
+
+void PipelineRegistry::dump() {
+    std::unique_lock<std::mutex> locker(mutex_);
+    LOGI("pipeline registry: %d / %d pipelines, %d pending, hit %d, miss %d, evict %d",
+         (int) lruList_.size(), budget_, pendingCount_, (int) hitCount_, (int) missCount_, (int) evictCount_);
+    for (auto iter = lruList_.begin(); iter != lruList_.end(); iter++) {
+        LOGI("\t[%llx] %s %s blend %d, last used %d%s", (unsigned long long) iter->key_,
+             iter->desc_.vertexShader_, iter->desc_.fragmentShader_, iter->desc_.blendMode_,
+             (int) iter->lastUsedFrame_, iter->handle_->isReady() ? "" : " (compiling)");
+    }
+}
@@ -0,0 +1,96 @@
+//
+// Created by richardwu on 11/1/24.
+//
+
+#ifndef PRF_PIPELINEREGISTRY_H
+#define PRF_PIPELINEREGISTRY_H
+
+#include <vulkan_wrapper.h>
+#include "utils.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// 按照desc创建管线（通过共享的VkPipelineCache），由调用者提供，使注册表不依赖于着色器的加载方式
+typedef std::function<void(const VulkanPipelineDesc &desc, VulkanPipelineInfo *pipelineInfo)> PipelineFactory;
+
+// 管线编译完成时在工作线程上调用
+typedef std::function<void(const VulkanPipelineInfo &pipelineInfo)> PipelineReadyCallback;
+
+// 一次管线编译请求的状态，由注册表与请求者共享
+struct PipelineRequest {
+    std::atomic<bool> ready_; // 编译完成后置为true（release），此后pipelineInfo_不再改变
+    VulkanPipelineInfo pipelineInfo_;
+    std::vector<PipelineReadyCallback> callbacks_; // 编译中登记的回调，由注册表加锁访问
+
+    bool isReady() const { return ready_.load(std::memory_order_acquire); }
+};
+typedef std::shared_ptr<PipelineRequest> PipelineHandle;
+
+/*
+ * 管线注册表：以管线状态（着色器、顶点布局、混合方式、图元拓扑、采样数、render pass）的哈希为键，
+ * 按需创建管线，超过预算时淘汰最久未使用（LRU）的管线
+ * 仍可能被在途帧使用的管线不会被淘汰
+ * 管线可以在后台线程池中异步编译（共享同一个VkPipelineCache），渲染线程轮询句柄，未就绪时跳过相关绘制
+ */
+class PipelineRegistry
+{
+public:
+    PipelineRegistry(VkDevice device, const PipelineFactory &factory, ThreadPool *threadPool,
+                     uint32_t budget, uint32_t framesInFlight);
+    ~PipelineRegistry(); // 等待编译中的管线完成，销毁所有管线
+
+    static uint64_t hashDesc(const VulkanPipelineDesc &desc); // 64位FNV-1a哈希
+
+    VulkanPipelineInfo get(const VulkanPipelineDesc &desc); // 取得（必要时同步创建）管线，并标记为本帧使用
+    // 取得管线的句柄，未创建时提交到线程池异步编译，立即返回；同样标记为本帧使用
+    // callback在管线就绪时调用一次（已就绪则立即在当前线程调用）
+    PipelineHandle getAsync(const VulkanPipelineDesc &desc, const PipelineReadyCallback &callback = nullptr);
+    void beginFrame(); // 每帧开始时调用（该帧的fence已signal），淘汰超出预算的管线
+
+    uint32_t getPipelineCount();
+    uint32_t getPendingCount(); // 编译中的管线数
+    void dump(); // 以log的形式打印 for debug
+
+private:
+    struct Entry {
+        uint64_t key_;
+        VulkanPipelineDesc desc_; // 用于确认哈希命中不是碰撞
+        PipelineHandle handle_;
+        uint64_t lastUsedFrame_;
+    };
+
+    VkDevice device_;
+    PipelineFactory factory_;
+    ThreadPool *threadPool_;
+    uint32_t budget_;
+    uint32_t framesInFlight_;
+    uint64_t frameNumber_;
+
+    std::mutex mutex_; // 保护下面的lruList_、entries_与pendingCount_
+    std::condition_variable readyCond_; // 有管线编译完成
+    uint32_t pendingCount_;
+
+    std::list<Entry> lruList_; // 表头为最近使用
+    // 同一个哈希值下可能有多个desc不同的管线（哈希碰撞），它们各自独立地参与LRU淘汰
+    std::unordered_multimap<uint64_t, std::list<Entry>::iterator> entries_;
+
+    uint64_t hitCount_;
+    uint64_t missCount_;
+    uint64_t evictCount_;
+
+    PipelineHandle request(const VulkanPipelineDesc &desc, const PipelineReadyCallback &callback, bool async);
+    void compile(const VulkanPipelineDesc &desc, PipelineHandle handle, const PipelineReadyCallback &callback);
+    void eraseEntry(std::list<Entry>::iterator entry); // 从entries_中移除lruList_中的该项
+    static bool isSameDesc(const VulkanPipelineDesc &a, const VulkanPipelineDesc &b);
+    void destroyPipeline(const VulkanPipelineInfo &pipelineInfo);
+};
+
+#endif //PRF_PIPELINEREGISTRY_H
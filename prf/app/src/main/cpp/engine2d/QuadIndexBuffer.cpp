@@ -0,0 +1,86 @@
+//
+// Created by richardwu on 11/13/24.
+//
+
+#include "QuadIndexBuffer.h"
+#include "../vulkan/utils.h"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+static const uint32_t QUAD_INDICES[6] = {0, 1, 2, 2, 3, 0};
+
+template <typename T>
+static void fillQuadIndices(T *indices, uint32_t quadCount) {
+    for (uint32_t q = 0; q < quadCount; q++) {
+        for (uint32_t i = 0; i < 6; i++) {
+            indices[6 * q + i] = (T) (4 * q + QUAD_INDICES[i]);
+        }
+    }
+}
+
+QuadIndexBuffer::QuadIndexBuffer(StaticBufferUploader *uploader, uint32_t maxQuads) {
+    uploader_ = uploader;
+    maxQuads_ = std::max(maxQuads, 1u);
+    uint16Quads_ = std::min(maxQuads_, (uint32_t) MAX_UINT16_QUADS); // 按值传入，不ODR-use类内的常量
+    ready_ = false;
+
+    // uint16_t部分在前（长度为12字节的整数倍，uint32_t部分自然4字节对齐）
+    VkDeviceSize uint16Size = uint16Quads_ * 6 * sizeof(uint16_t);
+    VkDeviceSize uint32Size = maxQuads_ > MAX_UINT16_QUADS ? maxQuads_ * 6 * sizeof(uint32_t) : 0;
+    uint32Offset_ = uint32Size ? uint16Size : 0;
+
+    std::vector<char> data(uint16Size + uint32Size);
+    fillQuadIndices((uint16_t *) data.data(), uint16Quads_);
+    if (uint32Size) fillQuadIndices((uint32_t *) (data.data() + uint32Offset_), maxQuads_);
+
+    bool created = uploader_->createStaticBuffer(data.data(), data.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                                 &buffer_);
+    assert(created);
+    (void) created;
+    LOGI("quad index buffer: %u quads, %llu bytes, uint32 indices above %u quads", maxQuads_,
+         (unsigned long long) data.size(), uint32Size ? uint16Quads_ : maxQuads_);
+}
+
+QuadIndexBuffer::~QuadIndexBuffer() {
+    uploader_->destroyStaticBuffer(buffer_);
+}
+
+bool QuadIndexBuffer::isReady() {
+    if (!ready_) ready_ = uploader_->isReady(buffer_);
+    return ready_;
+}
+
+void QuadIndexBuffer::bindSingleQuad(VkCommandBuffer cmdBuffer) {
+    vkCmdBindIndexBuffer(cmdBuffer, buffer_.buffer_, 0, VK_INDEX_TYPE_UINT16);
+}
+
+uint32_t QuadIndexBuffer::draw(VkCommandBuffer cmdBuffer, uint32_t firstQuad, uint32_t quadCount) {
+    uint32_t drawCount = 0;
+    VkIndexType boundType = VK_INDEX_TYPE_MAX_ENUM;
+    while (quadCount > 0) {
+        // 索引总是从0开始，以vertexOffset移到本段的第一个顶点
+        VkIndexType indexType = getIndexType(quadCount);
+        uint32_t count = std::min(quadCount, indexType == VK_INDEX_TYPE_UINT32 ? maxQuads_ : uint16Quads_);
+        if (indexType != boundType) {
+            vkCmdBindIndexBuffer(cmdBuffer, buffer_.buffer_,
+                                 indexType == VK_INDEX_TYPE_UINT32 ? uint32Offset_ : 0, indexType);
+            boundType = indexType;
+        }
+        vkCmdDrawIndexed(cmdBuffer, 6 * count, 1, 0, (int32_t) (4 * firstQuad), 0);
+        firstQuad += count;
+        quadCount -= count;
+        drawCount++;
+    }
+    return drawCount;
+}
+
+uint32_t QuadIndexBuffer::getMaxQuads() {
+    return maxQuads_;
+}
+
+VkIndexType QuadIndexBuffer::getIndexType(uint32_t quadCount) {
+    // 没有uint32_t部分时按uint16_t的容量分段
+    return quadCount > uint16Quads_ && uint32Offset_ != 0 ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+}
@@ -0,0 +1,44 @@
+//
+// Created by richardwu on 11/13/24.
+//
+
+#ifndef PRF_QUADINDEXBUFFER_H
+#define PRF_QUADINDEXBUFFER_H
+
+#include <vulkan_wrapper.h>
+#include "StaticBufferUploader.h"
+
+/*
+ * 所有以四边形为单位绘制的图元共享的索引缓冲：第q个四边形的索引为4q + {0, 1, 2, 2, 3, 0}
+ * 初始化时生成一次，经StaticBufferUploader复制到显存，之后每帧不再上传索引
+ * uint16_t的部分覆盖前MAX_UINT16_QUADS个四边形；maxQuads超出时另有一段uint32_t的索引，
+ * 更大的批次自动使用32位索引一次画出，超出maxQuads的部分再以vertexOffset分段
+ * 只能在渲染线程上创建与销毁，draw()可在多个线程中同时调用
+ */
+class QuadIndexBuffer
+{
+public:
+    static const uint32_t MAX_UINT16_QUADS = 65536 / 4; // 顶点下标不超过0xFFFF
+
+    QuadIndexBuffer(StaticBufferUploader *uploader, uint32_t maxQuads);
+    ~QuadIndexBuffer(); // 调用者保证该缓冲已不被在途帧使用
+
+    bool isReady(); // 复制完成之前绘制应被跳过
+    // 单个四边形的索引（与第0个四边形相同），供实例化的绘制使用
+    void bindSingleQuad(VkCommandBuffer cmdBuffer);
+    // 绘制顶点缓冲中第firstQuad个起的quadCount个四边形（每个4个顶点），返回vkCmdDrawIndexed的次数
+    uint32_t draw(VkCommandBuffer cmdBuffer, uint32_t firstQuad, uint32_t quadCount);
+
+    uint32_t getMaxQuads();
+    VkIndexType getIndexType(uint32_t quadCount); // 一个批次的四边形数对应的索引类型
+
+private:
+    StaticBufferUploader *uploader_;
+    uint32_t maxQuads_;
+    uint32_t uint16Quads_; // uint16_t部分的四边形数
+    VkDeviceSize uint32Offset_; // uint32_t部分的起始位置，没有时为0
+    VulkanStaticBuffer buffer_;
+    bool ready_;
+};
+
+#endif //PRF_QUADINDEXBUFFER_H
@@ -0,0 +1,76 @@
+//
+// Created by richardwu on 10/26/24.
+//
+
+#include "RingBuffer.h"
+#include "../vulkan/utils.h"
+
+RingBuffer::RingBuffer(VkDevice device, MemoryArena *memoryArena, VkBufferUsageFlags usage,
+                       uint32_t regionCount, VkDeviceSize regionSize) {
+    device_ = device;
+    memoryArena_ = memoryArena;
+    regionCount_ = regionCount;
+    regionSize_ = regionSize;
+
+    heads_.reset(new std::atomic<VkDeviceSize>[regionCount]);
+    for (uint32_t i = 0; i < regionCount; i++) {
+        heads_[i].store(0);
+    }
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = regionSize * regionCount;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    CALL_VK(vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer_));
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device_, buffer_, &memRequirements);
+
+    // 内存池中的HOST_VISIBLE块是持久映射的，之后不再需要vkMapMemory
+    bool allocated = memoryArena_->alloc(memRequirements,
+                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                         &memory_);
+    assert(allocated);
+    (void) allocated;
+
+    CALL_VK(vkBindBufferMemory(device_, buffer_, memory_.memory_, memory_.offset_));
+}
+
+RingBuffer::~RingBuffer() {
+    vkDestroyBuffer(device_, buffer_, nullptr);
+    memoryArena_->free(memory_);
+}
+
+void RingBuffer::resetRegion(uint32_t frameIndex) {
+    assert(frameIndex < regionCount_);
+    heads_[frameIndex].store(0, std::memory_order_relaxed);
+}
+
+bool RingBuffer::alloc(uint32_t frameIndex, VkDeviceSize size, VkDeviceSize alignment,
+                       VulkanTransientAllocation *allocation) {
+    assert(frameIndex < regionCount_);
+    if (alignment == 0) alignment = 1;
+
+    // 指针递增（CAS保证多个录制线程可以同时分配）
+    std::atomic<VkDeviceSize> &head = heads_[frameIndex];
+    VkDeviceSize begin = head.load(std::memory_order_relaxed);
+    VkDeviceSize aligned;
+    do {
+        aligned = (begin + alignment - 1) / alignment * alignment;
+        if (aligned + size > regionSize_) {
+            return false;
+        }
+    } while (!head.compare_exchange_weak(begin, aligned + size, std::memory_order_relaxed));
+
+    VkDeviceSize offset = regionSize_ * frameIndex + aligned;
+    allocation->buffer_ = buffer_;
+    allocation->offset_ = offset;
+    allocation->mapped_ = (char *) memory_.mapped_ + offset;
+    return true;
+}
+
+VkDeviceSize RingBuffer::getUsedBytes(uint32_t frameIndex) {
+    assert(frameIndex < regionCount_);
+    return heads_[frameIndex].load(std::memory_order_relaxed);
+}
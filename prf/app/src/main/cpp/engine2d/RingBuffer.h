@@ -0,0 +1,52 @@
+//
+// Created by richardwu on 10/26/24.
+//
+
+#ifndef PRF_RINGBUFFER_H
+#define PRF_RINGBUFFER_H
+
+#include <vulkan_wrapper.h>
+#include "MemoryArena.h"
+
+#include <atomic>
+#include <memory>
+
+// 一次临时分配的结果，只在申请它的那一帧内有效
+struct VulkanTransientAllocation {
+    VkBuffer buffer_; // 整个环形缓冲共用同一个VkBuffer
+    VkDeviceSize offset_; // 绑定时使用的偏移
+    void *mapped_; // 可直接写入的CPU地址
+};
+
+/*
+ * 每帧的临时几何数据（顶点、索引等只活一帧的数据）使用的环形缓冲
+ * 一个持久映射的HOST_VISIBLE VkBuffer被均分为regionCount个区域，每个轮转的帧占一个
+ * 分配只是区域内的指针递增；该帧的fence signal之后，整个区域一次性回收
+ */
+class RingBuffer
+{
+public:
+    RingBuffer(VkDevice device, MemoryArena *memoryArena, VkBufferUsageFlags usage,
+               uint32_t regionCount, VkDeviceSize regionSize);
+    ~RingBuffer(); // 释放VkBuffer，并将内存归还memoryArena
+
+    void resetRegion(uint32_t frameIndex); // 该帧的fence已signal，回收其区域内的所有分配
+    // 在帧frameIndex的区域中分配size字节；区域已满时返回false，由调用者回退到BufferManager
+    bool alloc(uint32_t frameIndex, VkDeviceSize size, VkDeviceSize alignment,
+               VulkanTransientAllocation *allocation);
+
+    VkDeviceSize getUsedBytes(uint32_t frameIndex); // 该帧区域已使用的字节数
+
+private:
+    VkDevice device_;
+    MemoryArena *memoryArena_;
+
+    VkBuffer buffer_;
+    VulkanMemoryAllocation memory_;
+
+    uint32_t regionCount_;
+    VkDeviceSize regionSize_;
+    std::unique_ptr<std::atomic<VkDeviceSize>[]> heads_; // 每个区域当前的分配位置（区域内偏移），可被多个线程同时递增
+};
+
+#endif //PRF_RINGBUFFER_H
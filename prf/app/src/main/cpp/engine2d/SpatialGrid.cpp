@@ -0,0 +1,242 @@
+//
+// Created by richardwu on 11/13/24.
+//
+
+#include "SpatialGrid.h"
+#include "../vulkan/utils.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+constexpr float SpatialGrid::DEFAULT_CELL_SIZE;
+
+// w、h为负时矩形在(x, y)的左边、上边；登记与查询之前都先规范化，之后的比较只处理非负的尺寸
+static SpatialRect normalize(const SpatialRect &rect) {
+    return SpatialRect{std::min(rect.x_, rect.x_ + rect.w_), std::min(rect.y_, rect.y_ + rect.h_),
+                       std::abs(rect.w_), std::abs(rect.h_)};
+}
+
+static bool intersects(const SpatialRect &a, const SpatialRect &b) {
+    return a.x_ < b.x_ + b.w_ && b.x_ < a.x_ + a.w_ && a.y_ < b.y_ + b.h_ && b.y_ < a.y_ + a.h_;
+}
+
+static bool contains(const SpatialRect &rect, float x, float y) {
+    return x >= rect.x_ && x < rect.x_ + rect.w_ && y >= rect.y_ && y < rect.y_ + rect.h_;
+}
+
+SpatialGrid::SpatialGrid(float cellSize) {
+    cellSize_ = cellSize > 0.0f ? cellSize : DEFAULT_CELL_SIZE;
+    invCellSize_ = 1.0f / cellSize_;
+    itemCount_ = 0;
+    queryStamp_ = 0;
+}
+
+uint32_t SpatialGrid::insert(const SpatialRect &bounds, uint32_t order) {
+    uint32_t id;
+    if (!freeIds_.empty()) {
+        id = freeIds_.back();
+        freeIds_.pop_back();
+    } else {
+        id = items_.size();
+        items_.push_back(Item());
+    }
+    Item &item = items_[id];
+    item.bounds_ = normalize(bounds);
+    item.order_ = order;
+    item.cells_ = getCellRange(item.bounds_);
+    item.alive_ = true;
+    item.large_ = isLarge(item.cells_);
+    item.queryStamp_ = 0;
+    link(id);
+    itemCount_++;
+    return id;
+}
+
+void SpatialGrid::move(uint32_t id, const SpatialRect &bounds) {
+    assert(id < items_.size() && items_[id].alive_);
+    Item &item = items_[id];
+    item.bounds_ = normalize(bounds);
+    CellRange range = getCellRange(item.bounds_);
+    // 仍在同样的格子中时不需要重新登记（大部分的小幅移动）
+    if (range.x0_ == item.cells_.x0_ && range.y0_ == item.cells_.y0_ &&
+        range.x1_ == item.cells_.x1_ && range.y1_ == item.cells_.y1_) {
+        return;
+    }
+    unlink(id);
+    item.cells_ = range;
+    item.large_ = isLarge(range);
+    link(id);
+}
+
+void SpatialGrid::remove(uint32_t id) {
+    assert(id < items_.size() && items_[id].alive_);
+    unlink(id);
+    items_[id].alive_ = false;
+    freeIds_.push_back(id);
+    itemCount_--;
+}
+
+void SpatialGrid::clear() {
+    items_.clear();
+    freeIds_.clear();
+    cells_.clear();
+    largeItems_.clear();
+    itemCount_ = 0;
+}
+
+const SpatialRect &SpatialGrid::getBounds(uint32_t id) {
+    return items_[id].bounds_;
+}
+
+uint32_t SpatialGrid::getOrder(uint32_t id) {
+    return items_[id].order_;
+}
+
+uint32_t SpatialGrid::getItemCount() {
+    return itemCount_;
+}
+
+void SpatialGrid::query(const SpatialRect &rect, std::vector<uint32_t> *ids) {
+    size_t begin = ids->size();
+    collect(rect, nextQueryStamp(), ids);
+    // 同一条目可能来自多个格子，格子的遍历顺序也与绘制顺序无关，按order恢复提交的顺序
+    std::sort(ids->begin() + begin, ids->end(), [this](uint32_t a, uint32_t b) {
+        return items_[a].order_ < items_[b].order_;
+    });
+}
+
+void SpatialGrid::queryRects(const SpatialRect *rects, uint32_t count, std::vector<uint32_t> *ids,
+                             std::vector<uint32_t> *offsets) {
+    ids->clear();
+    offsets->resize(count + 1);
+    for (uint32_t i = 0; i < count; i++) {
+        (*offsets)[i] = ids->size();
+        collect(rects[i], nextQueryStamp(), ids);
+    }
+    (*offsets)[count] = ids->size();
+}
+
+void SpatialGrid::hitTestPoints(const float *x, const float *y, uint32_t count, uint32_t *hits) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t best = INVALID_ID;
+        auto consider = [&](uint32_t id) {
+            const Item &item = items_[id];
+            if (contains(item.bounds_, x[i], y[i]) && (best == INVALID_ID || item.order_ > items_[best].order_)) {
+                best = id;
+            }
+        };
+        // 点只落在一个格子中，不需要去重
+        auto iter = cells_.find(cellKey(toCell(x[i]), toCell(y[i])));
+        if (iter != cells_.end()) {
+            for (auto id: iter->second) consider(id);
+        }
+        for (auto id: largeItems_) consider(id);
+        hits[i] = best;
+    }
+}
+
+void SpatialGrid::dump() {
+    size_t maxCellItems = 0, cellItems = 0;
+    for (auto iter = cells_.begin(); iter != cells_.end(); iter++) {
+        maxCellItems = std::max(maxCellItems, iter->second.size());
+        cellItems += iter->second.size();
+    }
+    LOGI("SpatialGrid: %u items (%zu large), cell size %.1f, %zu cells, %.2f items/cell (max %zu)",
+         itemCount_, largeItems_.size(), cellSize_, cells_.size(),
+         cells_.empty() ? 0.0 : (double) cellItems / cells_.size(), maxCellItems);
+}
+
+uint64_t SpatialGrid::cellKey(int32_t x, int32_t y) {
+    return ((uint64_t) (uint32_t) x << 32) | (uint32_t) y;
+}
+
+int32_t SpatialGrid::toCell(float value) {
+    // 限制在int32_t的范围内，极远的坐标落在边缘的格子中
+    float cell = std::floor(value * invCellSize_);
+    return (int32_t) std::min(std::max(cell, -1073741824.0f), 1073741824.0f);
+}
+
+SpatialGrid::CellRange SpatialGrid::getCellRange(const SpatialRect &bounds) {
+    return CellRange{toCell(bounds.x_), toCell(bounds.y_), toCell(bounds.x_ + bounds.w_),
+                     toCell(bounds.y_ + bounds.h_)};
+}
+
+bool SpatialGrid::isLarge(const CellRange &range) {
+    int64_t cells = ((int64_t) range.x1_ - range.x0_ + 1) * ((int64_t) range.y1_ - range.y0_ + 1);
+    return cells > MAX_ITEM_CELLS;
+}
+
+void SpatialGrid::link(uint32_t id) {
+    const Item &item = items_[id];
+    if (item.large_) {
+        largeItems_.push_back(id);
+        return;
+    }
+    for (int32_t y = item.cells_.y0_; y <= item.cells_.y1_; y++) {
+        for (int32_t x = item.cells_.x0_; x <= item.cells_.x1_; x++) {
+            cells_[cellKey(x, y)].push_back(id);
+        }
+    }
+}
+
+void SpatialGrid::unlink(uint32_t id) {
+    const Item &item = items_[id];
+    // 顺序无关，与最后一项交换后删除
+    auto erase = [id](std::vector<uint32_t> &list) {
+        auto iter = std::find(list.begin(), list.end(), id);
+        if (iter == list.end()) return;
+        *iter = list.back();
+        list.pop_back();
+    };
+    if (item.large_) {
+        erase(largeItems_);
+        return;
+    }
+    for (int32_t y = item.cells_.y0_; y <= item.cells_.y1_; y++) {
+        for (int32_t x = item.cells_.x0_; x <= item.cells_.x1_; x++) {
+            auto iter = cells_.find(cellKey(x, y));
+            if (iter == cells_.end()) continue;
+            erase(iter->second); // 空的格子保留（连同容量），条目来回移动时不反复分配
+        }
+    }
+}
+
+uint32_t SpatialGrid::nextQueryStamp() {
+    if (++queryStamp_ == 0) {
+        // 回绕时清除所有标记，0保留为“未加入”
+        for (auto &item: items_) item.queryStamp_ = 0;
+        queryStamp_ = 1;
+    }
+    return queryStamp_;
+}
+
+void SpatialGrid::collect(const SpatialRect &queryRect, uint32_t stamp, std::vector<uint32_t> *ids) {
+    const SpatialRect rect = normalize(queryRect);
+    auto consider = [&](uint32_t id) {
+        Item &item = items_[id];
+        if (item.queryStamp_ == stamp) return;
+        item.queryStamp_ = stamp;
+        if (intersects(item.bounds_, rect)) ids->push_back(id);
+    };
+
+    CellRange range = getCellRange(rect);
+    int64_t rangeCells = ((int64_t) range.x1_ - range.x0_ + 1) * ((int64_t) range.y1_ - range.y0_ + 1);
+    if (rangeCells > (int64_t) cells_.size()) {
+        // 查询范围比已有的格子还多（如缩小到整个场景）：直接遍历已有的格子
+        for (auto iter = cells_.begin(); iter != cells_.end(); iter++) {
+            int32_t x = (int32_t) (uint32_t) (iter->first >> 32), y = (int32_t) (uint32_t) iter->first;
+            if (x < range.x0_ || x > range.x1_ || y < range.y0_ || y > range.y1_) continue;
+            for (auto id: iter->second) consider(id);
+        }
+    } else {
+        for (int32_t y = range.y0_; y <= range.y1_; y++) {
+            for (int32_t x = range.x0_; x <= range.x1_; x++) {
+                auto iter = cells_.find(cellKey(x, y));
+                if (iter == cells_.end()) continue;
+                for (auto id: iter->second) consider(id);
+            }
+        }
+    }
+    for (auto id: largeItems_) consider(id);
+}
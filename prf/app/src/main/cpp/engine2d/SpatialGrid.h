@@ -0,0 +1,88 @@
+//
+// Created by richardwu on 11/13/24.
+//
+
+#ifndef PRF_SPATIALGRID_H
+#define PRF_SPATIALGRID_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// 轴对齐的矩形，像素坐标；w、h为负时矩形在(x, y)的左边、上边
+struct SpatialRect {
+    float x_, y_, w_, h_;
+};
+
+/*
+ * 场景条目的空间索引：均匀网格，格子以坐标哈希存放，场景范围不受限制
+ * 每个条目登记在它覆盖的所有格子中；覆盖的格子过多的大条目单独存放，每次查询都检查
+ * 插入、移动、删除都是增量的（移动后覆盖的格子不变时只更新范围）
+ * 每帧以视口（与裁剪矩形的交集）查询可见的条目，屏幕外的条目不会被提交、上传与录制；
+ * 同样的索引也用于批量的点选与矩形选取
+ * 只能在一个线程上使用
+ */
+class SpatialGrid
+{
+public:
+    static const uint32_t INVALID_ID = 0xFFFFFFFF;
+    static constexpr float DEFAULT_CELL_SIZE = 128.0f;
+    static const uint32_t MAX_ITEM_CELLS = 64; // 覆盖的格子超过这么多时作为大条目
+
+    explicit SpatialGrid(float cellSize = DEFAULT_CELL_SIZE);
+
+    // order为绘制顺序（大的在上），查询结果按它排序，点选时取最大的；返回条目的编号（删除后会被复用）
+    uint32_t insert(const SpatialRect &bounds, uint32_t order);
+    void move(uint32_t id, const SpatialRect &bounds);
+    void remove(uint32_t id);
+    void clear();
+
+    const SpatialRect &getBounds(uint32_t id); // 规范化后的范围（w、h不为负）
+    uint32_t getOrder(uint32_t id);
+    uint32_t getItemCount();
+
+    // 与rect相交的条目按order递增追加到ids中
+    void query(const SpatialRect &rect, std::vector<uint32_t> *ids);
+    // 批量矩形选取：第i个矩形的结果为ids[offsets[i], offsets[i + 1])（每段内顺序不定），offsets共count + 1项
+    void queryRects(const SpatialRect *rects, uint32_t count, std::vector<uint32_t> *ids,
+                    std::vector<uint32_t> *offsets);
+    // 批量点选：hits[i]为包含第i个点的条目中order最大的一个，没有时为INVALID_ID
+    void hitTestPoints(const float *x, const float *y, uint32_t count, uint32_t *hits);
+
+    void dump(); // 以log的形式打印 for debug
+
+private:
+    struct CellRange {
+        int32_t x0_, y0_, x1_, y1_; // 包含两端
+    };
+
+    struct Item {
+        SpatialRect bounds_; // 已规范化
+        uint32_t order_;
+        CellRange cells_;
+        bool alive_;
+        bool large_; // 登记在largeItems_中，而不是格子里
+        uint32_t queryStamp_; // 本次查询已经加入过结果
+    };
+
+    float cellSize_;
+    float invCellSize_;
+    std::vector<Item> items_; // 按编号索引
+    std::vector<uint32_t> freeIds_;
+    uint32_t itemCount_;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> cells_; // 格子坐标 -> 条目编号
+    std::vector<uint32_t> largeItems_;
+    uint32_t queryStamp_;
+
+    static uint64_t cellKey(int32_t x, int32_t y);
+    int32_t toCell(float value);
+    CellRange getCellRange(const SpatialRect &bounds); // bounds已规范化
+    bool isLarge(const CellRange &range);
+    void link(uint32_t id); // 按items_[id]的cells_登记
+    void unlink(uint32_t id);
+    uint32_t nextQueryStamp();
+    // 与rect相交、尚未加入的条目追加到ids中（不排序）
+    void collect(const SpatialRect &queryRect, uint32_t stamp, std::vector<uint32_t> *ids);
+};
+
+#endif //PRF_SPATIALGRID_H
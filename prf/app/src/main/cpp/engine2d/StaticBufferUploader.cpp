@@ -0,0 +1,261 @@
+//
+// Created by richardwu on 11/10/24.
+//
+
+#include "StaticBufferUploader.h"
+#include "../vulkan/utils.h"
+
+#include <cstring>
+
+StaticBufferUploader::StaticBufferUploader(VkDevice device, MemoryArena *memoryArena,
+                                           uint32_t graphicsQueueFamilyIndex, uint32_t transferQueueFamilyIndex,
+                                           VkQueue transferQueue) {
+    device_ = device;
+    memoryArena_ = memoryArena;
+    queueFamilyIndices_[0] = graphicsQueueFamilyIndex;
+    queueFamilyIndices_[1] = transferQueueFamilyIndex;
+    transferQueue_ = transferQueue;
+    nextBatchId_ = 1;
+    recording_ = false;
+    current_.id_ = 0;
+    current_.cmdBuffer_ = VK_NULL_HANDLE;
+    current_.fence_ = VK_NULL_HANDLE;
+
+    // 每批一个指令缓冲，完成后单独重置复用
+    VkCommandPoolCreateInfo cmdPoolCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+            .queueFamilyIndex = transferQueueFamilyIndex,
+    };
+    CALL_VK(vkCreateCommandPool(device_, &cmdPoolCreateInfo, nullptr, &cmdPool_));
+    LOGI("static buffer uploader: %s transfer queue family %d",
+         hasDedicatedTransferQueue() ? "dedicated" : "shared", transferQueueFamilyIndex);
+}
+
+StaticBufferUploader::~StaticBufferUploader() {
+    submit();
+    for (auto iter = pending_.begin(); iter != pending_.end(); iter++) {
+        CALL_VK(vkWaitForFences(device_, 1, &iter->fence_, VK_TRUE, UINT64_MAX));
+        retire(*iter);
+    }
+    pending_.clear();
+
+    for (auto iter = freeFences_.begin(); iter != freeFences_.end(); iter++) {
+        vkDestroyFence(device_, *iter, nullptr);
+    }
+    // 销毁指令池时其中的指令缓冲一并释放
+    vkDestroyCommandPool(device_, cmdPool_, nullptr);
+}
+
+bool StaticBufferUploader::hasDedicatedTransferQueue() {
+    return queueFamilyIndices_[0] != queueFamilyIndices_[1];
+}
+
+const uint32_t *StaticBufferUploader::getQueueFamilyIndices() {
+    return queueFamilyIndices_;
+}
+
+bool StaticBufferUploader::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                                        bool shared, VkBuffer *buffer, VulkanMemoryAllocation *memory) {
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    // 由传输队列写入、图形队列读取，两个队列族不同时同时属于两者，省去所有权转移的barrier
+    if (shared && hasDedicatedTransferQueue()) {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = 2;
+        bufferInfo.pQueueFamilyIndices = queueFamilyIndices_;
+    } else {
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+
+    CALL_VK(vkCreateBuffer(device_, &bufferInfo, nullptr, buffer));
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device_, *buffer, &memRequirements);
+    if (!memoryArena_->alloc(memRequirements, properties, memory)) {
+        vkDestroyBuffer(device_, *buffer, nullptr);
+        return false;
+    }
+    CALL_VK(vkBindBufferMemory(device_, *buffer, memory->memory_, memory->offset_));
+    return true;
+}
+
+bool StaticBufferUploader::createStaticBuffer(const void *data, VkDeviceSize size, VkBufferUsageFlags usage,
+                                              VulkanStaticBuffer *staticBuffer) {
+    // 目标缓冲：DEVICE_LOCAL，CPU不可见
+    if (!createBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true,
+                      &staticBuffer->buffer_, &staticBuffer->memory_)) {
+        LOGE("static buffer uploader: out of device local memory for %d bytes", (int) size);
+        return false;
+    }
+    staticBuffer->size_ = size;
+
+    // staging缓冲：只在传输队列上使用，写入一次，复制完成后归还
+    StagingBuffer staging;
+    if (!createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, false,
+                      &staging.buffer_, &staging.memory_)) {
+        LOGE("static buffer uploader: out of staging memory for %d bytes", (int) size);
+        destroyStaticBuffer(*staticBuffer);
+        return false;
+    }
+    memcpy(staging.memory_.mapped_, data, size);
+
+    if (!recording_) beginBatch();
+    VkBufferCopy region{
+            .srcOffset = 0,
+            .dstOffset = 0,
+            .size = size,
+    };
+    vkCmdCopyBuffer(current_.cmdBuffer_, staging.buffer_, staticBuffer->buffer_, 1, &region);
+    current_.stagingBuffers_.push_back(staging);
+    staticBuffer->uploadId_ = current_.id_;
+    return true;
+}
+
+VkCommandBuffer StaticBufferUploader::getCommandBuffer(uint64_t *uploadId) {
+    if (!recording_) beginBatch();
+    *uploadId = current_.id_;
+    return current_.cmdBuffer_;
+}
+
+void StaticBufferUploader::addStagingBuffer(VkBuffer buffer, const VulkanMemoryAllocation &memory) {
+    assert(recording_);
+    current_.stagingBuffers_.push_back(StagingBuffer{buffer, memory});
+}
+
+void StaticBufferUploader::destroyStaticBuffer(const VulkanStaticBuffer &staticBuffer) {
+    vkDestroyBuffer(device_, staticBuffer.buffer_, nullptr);
+    memoryArena_->free(staticBuffer.memory_);
+}
+
+void StaticBufferUploader::beginBatch() {
+    current_.id_ = nextBatchId_++;
+    current_.stagingBuffers_.clear();
+
+    if (freeCmdBuffers_.empty()) {
+        VkCommandBufferAllocateInfo cmdBufferCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .pNext = nullptr,
+                .commandPool = cmdPool_,
+                .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                .commandBufferCount = 1,
+        };
+        CALL_VK(vkAllocateCommandBuffers(device_, &cmdBufferCreateInfo, &current_.cmdBuffer_));
+    } else {
+        current_.cmdBuffer_ = freeCmdBuffers_.back();
+        freeCmdBuffers_.pop_back();
+        CALL_VK(vkResetCommandBuffer(current_.cmdBuffer_, 0));
+    }
+
+    VkCommandBufferBeginInfo cmdBufferBeginInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .pNext = nullptr,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            .pInheritanceInfo = nullptr,
+    };
+    CALL_VK(vkBeginCommandBuffer(current_.cmdBuffer_, &cmdBufferBeginInfo));
+    recording_ = true;
+}
+
+void StaticBufferUploader::submit() {
+    if (!recording_) return;
+
+    // 与图形队列是同一个队列族时，之后的提交在同一队列上按顺序开始，这里保证复制的写入对顶点、索引读取可见
+    // 独立的传输队列族不支持VERTEX_INPUT阶段，可见性由fence完成后图形队列才使用来保证
+    if (!hasDedicatedTransferQueue()) {
+        VkMemoryBarrier barrier{
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .pNext = nullptr,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT,
+        };
+        vkCmdPipelineBarrier(current_.cmdBuffer_, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    CALL_VK(vkEndCommandBuffer(current_.cmdBuffer_));
+
+    if (freeFences_.empty()) {
+        VkFenceCreateInfo fenceCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+        };
+        CALL_VK(vkCreateFence(device_, &fenceCreateInfo, nullptr, &current_.fence_));
+    } else {
+        current_.fence_ = freeFences_.back();
+        freeFences_.pop_back();
+        CALL_VK(vkResetFences(device_, 1, &current_.fence_));
+    }
+
+    VkSubmitInfo submitInfo = {.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = nullptr,
+            .waitSemaphoreCount = 0,
+            .pWaitSemaphores = nullptr,
+            .pWaitDstStageMask = nullptr,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &current_.cmdBuffer_,
+            .signalSemaphoreCount = 0,
+            .pSignalSemaphores = nullptr};
+    CALL_VK(vkQueueSubmit(transferQueue_, 1, &submitInfo, current_.fence_));
+
+    pending_.push_back(current_);
+    current_.stagingBuffers_.clear();
+    recording_ = false;
+}
+
+bool StaticBufferUploader::isReady(const VulkanStaticBuffer &staticBuffer) {
+    return isReady(staticBuffer.uploadId_);
+}
+
+bool StaticBufferUploader::isReady(uint64_t uploadId) {
+    if (recording_ && uploadId == current_.id_) {
+        submit();
+        return false;
+    }
+    poll();
+    for (auto iter = pending_.begin(); iter != pending_.end(); iter++) {
+        if (iter->id_ == uploadId) return false;
+    }
+    return true;
+}
+
+void StaticBufferUploader::wait(const VulkanStaticBuffer &staticBuffer) {
+    if (recording_ && staticBuffer.uploadId_ == current_.id_) {
+        submit();
+    }
+    for (auto iter = pending_.begin(); iter != pending_.end(); iter++) {
+        if (iter->id_ == staticBuffer.uploadId_) {
+            CALL_VK(vkWaitForFences(device_, 1, &iter->fence_, VK_TRUE, UINT64_MAX));
+            break;
+        }
+    }
+    poll();
+}
+
+void StaticBufferUploader::poll() {
+    for (auto iter = pending_.begin(); iter != pending_.end();) {
+        if (vkGetFenceStatus(device_, iter->fence_) == VK_SUCCESS) {
+            retire(*iter);
+            iter = pending_.erase(iter);
+        } else {
+            iter++;
+        }
+    }
+}
+
+uint32_t StaticBufferUploader::getPendingCount() {
+    return pending_.size();
+}
+
+void StaticBufferUploader::retire(Batch &batch) {
+    for (auto iter = batch.stagingBuffers_.begin(); iter != batch.stagingBuffers_.end(); iter++) {
+        vkDestroyBuffer(device_, iter->buffer_, nullptr);
+        memoryArena_->free(iter->memory_);
+    }
+    batch.stagingBuffers_.clear();
+    freeCmdBuffers_.push_back(batch.cmdBuffer_);
+    freeFences_.push_back(batch.fence_);
+}
@@ -0,0 +1,90 @@
+//
+// Created by richardwu on 11/10/24.
+//
+
+#ifndef PRF_STATICBUFFERUPLOADER_H
+#define PRF_STATICBUFFERUPLOADER_H
+
+#include <vulkan_wrapper.h>
+#include "MemoryArena.h"
+
+#include <list>
+#include <vector>
+
+// 内容不再变化的几何数据，位于DEVICE_LOCAL内存（CPU不可见）
+struct VulkanStaticBuffer {
+    VkBuffer buffer_;
+    VulkanMemoryAllocation memory_;
+    VkDeviceSize size_;
+    uint64_t uploadId_; // 所属的上传批次，isReady()之后才能在绘制中使用
+};
+
+/*
+ * 静态几何数据的上传
+ * 数据先写入HOST_VISIBLE的staging缓冲，再用vkCmdCopyBuffer复制到DEVICE_LOCAL的缓冲中，之后每帧从显存读取
+ * 复制在传输队列上执行（有独立的传输队列族时使用它，缓冲以CONCURRENT方式在两个队列族间共享），
+ * 每批复制一个fence，完成后回收staging缓冲；图形队列不需要等待队列空闲
+ * 只能在渲染线程上使用（传输队列与图形队列相同时，两者共用同一个VkQueue）
+ */
+class StaticBufferUploader
+{
+public:
+    StaticBufferUploader(VkDevice device, MemoryArena *memoryArena, uint32_t graphicsQueueFamilyIndex,
+                         uint32_t transferQueueFamilyIndex, VkQueue transferQueue);
+    ~StaticBufferUploader(); // 等待未完成的复制，释放staging缓冲、fence与指令池
+
+    // 创建一个DEVICE_LOCAL缓冲，并将data复制进去（记录到当前批次中，submit()之后开始执行）
+    bool createStaticBuffer(const void *data, VkDeviceSize size, VkBufferUsageFlags usage,
+                            VulkanStaticBuffer *staticBuffer);
+    // 调用者保证该缓冲已不被在途帧使用
+    void destroyStaticBuffer(const VulkanStaticBuffer &staticBuffer);
+
+    // 供其他资源（如纹理）的复制使用当前批次：返回录制中的指令缓冲（必要时开始新批次），*uploadId为批次编号
+    VkCommandBuffer getCommandBuffer(uint64_t *uploadId);
+    // 由调用者创建、已写好数据的staging缓冲，在当前批次完成后释放
+    void addStagingBuffer(VkBuffer buffer, const VulkanMemoryAllocation &memory);
+
+    void submit(); // 提交当前批次（没有内容时什么也不做），每帧调用一次即可
+    bool isReady(const VulkanStaticBuffer &staticBuffer); // 不阻塞；批次尚未提交时先提交
+    bool isReady(uint64_t uploadId);
+    void wait(const VulkanStaticBuffer &staticBuffer); // 阻塞直到该缓冲的批次复制完成（只等待它的fence）
+    void poll(); // 回收已完成批次的staging缓冲、fence与指令缓冲
+
+    uint32_t getPendingCount(); // 已提交、尚未完成的批次数
+    bool hasDedicatedTransferQueue();
+    const uint32_t *getQueueFamilyIndices(); // 图形、传输，CONCURRENT共享时使用
+
+private:
+    struct StagingBuffer {
+        VkBuffer buffer_;
+        VulkanMemoryAllocation memory_;
+    };
+
+    // 一次提交
+    struct Batch {
+        uint64_t id_;
+        VkCommandBuffer cmdBuffer_;
+        VkFence fence_;
+        std::vector<StagingBuffer> stagingBuffers_;
+    };
+
+    VkDevice device_;
+    MemoryArena *memoryArena_;
+    uint32_t queueFamilyIndices_[2]; // 图形、传输
+    VkQueue transferQueue_;
+    VkCommandPool cmdPool_;
+
+    uint64_t nextBatchId_;
+    bool recording_; // 当前批次已开始录制
+    Batch current_;
+    std::list<Batch> pending_; // 已提交，按id递增
+    std::vector<VkCommandBuffer> freeCmdBuffers_;
+    std::vector<VkFence> freeFences_;
+
+    bool createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                      bool shared, VkBuffer *buffer, VulkanMemoryAllocation *memory);
+    void beginBatch();
+    void retire(Batch &batch);
+};
+
+#endif //PRF_STATICBUFFERUPLOADER_H
@@ -0,0 +1,607 @@
+//
+// Created by richardwu on 11/12/24.
+//
+
+#include "TextureAtlas.h"
+#include "image_layout.h"
+#include "../vulkan/utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+// 每个精灵四周扩展（复制边缘）的像素数，双线性过滤时不会采样到相邻精灵
+static const uint32_t PADDING = 1;
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    if (alignment <= 1) return value;
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+void SkylinePacker::reset(uint32_t width, uint32_t height) {
+    width_ = width;
+    height_ = height;
+    usedArea_ = 0;
+    skyline_.clear();
+    skyline_.push_back(Segment{0, 0, width});
+}
+
+bool SkylinePacker::fit(size_t index, uint32_t width, uint32_t height, uint32_t *y) {
+    uint32_t x = skyline_[index].x_;
+    if (x + width > width_) return false;
+    // 矩形底部必须高于它跨过的所有线段
+    uint32_t top = 0;
+    uint32_t remaining = width;
+    for (size_t i = index; remaining > 0; i++) {
+        top = std::max(top, skyline_[i].y_);
+        if (top + height > height_) return false;
+        remaining -= std::min(remaining, skyline_[i].width_);
+    }
+    *y = top;
+    return true;
+}
+
+bool SkylinePacker::pack(uint32_t width, uint32_t height, uint32_t *x, uint32_t *y) {
+    size_t bestIndex = skyline_.size();
+    uint32_t bestTop = UINT32_MAX, bestWidth = UINT32_MAX, bestY = 0;
+    for (size_t i = 0; i < skyline_.size(); i++) {
+        uint32_t fitY;
+        if (!fit(i, width, height, &fitY)) continue;
+        // 顶部最低优先，相同时选所在线段最窄的（留下的缝隙最小）
+        if (fitY + height < bestTop || (fitY + height == bestTop && skyline_[i].width_ < bestWidth)) {
+            bestIndex = i;
+            bestTop = fitY + height;
+            bestWidth = skyline_[i].width_;
+            bestY = fitY;
+        }
+    }
+    if (bestIndex == skyline_.size()) return false;
+
+    *x = skyline_[bestIndex].x_;
+    *y = bestY;
+    skyline_.insert(skyline_.begin() + bestIndex, Segment{*x, bestY + height, width});
+
+    // 被新线段覆盖的部分从其后的线段中去掉
+    for (size_t i = bestIndex + 1; i < skyline_.size();) {
+        Segment &prev = skyline_[i - 1];
+        Segment &segment = skyline_[i];
+        uint32_t prevEnd = prev.x_ + prev.width_;
+        if (segment.x_ >= prevEnd) break;
+        uint32_t shrink = prevEnd - segment.x_;
+        if (shrink >= segment.width_) {
+            skyline_.erase(skyline_.begin() + i);
+            continue;
+        }
+        segment.x_ += shrink;
+        segment.width_ -= shrink;
+        break;
+    }
+    // 合并相邻的等高线段
+    for (size_t i = 0; i + 1 < skyline_.size();) {
+        if (skyline_[i].y_ == skyline_[i + 1].y_) {
+            skyline_[i].width_ += skyline_[i + 1].width_;
+            skyline_.erase(skyline_.begin() + i + 1);
+        } else {
+            i++;
+        }
+    }
+    usedArea_ += (uint64_t) width * height;
+    return true;
+}
+
+uint64_t SkylinePacker::getUsedArea() {
+    return usedArea_;
+}
+
+TextureAtlas::TextureAtlas(VkDevice device, VkPhysicalDevice physicalDevice, MemoryArena *memoryArena,
+                           StaticBufferUploader *uploader, uint32_t framesInFlight,
+                           uint32_t pageSize, uint32_t maxPages) {
+    device_ = device;
+    memoryArena_ = memoryArena;
+    uploader_ = uploader;
+    framesInFlight_ = framesInFlight;
+    pageSize_ = pageSize;
+    maxPages_ = maxPages;
+    frameNumber_ = 0;
+    nextPageId_ = 0;
+    evictCount_ = 0;
+    defragmentCount_ = 0;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    bufferImageGranularity_ = properties.limits.bufferImageGranularity;
+
+    // 精灵四周有扩展的像素，线性过滤不会采样到相邻的精灵
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = 0.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_TRANSPARENT_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    CALL_VK(vkCreateSampler(device_, &samplerInfo, nullptr, &sampler_));
+}
+
+TextureAtlas::~TextureAtlas() {
+    for (auto iter = pages_.begin(); iter != pages_.end(); iter++) {
+        destroyPage(iter->second);
+    }
+    pages_.clear();
+    sprites_.clear();
+    waiting_.clear();
+    vkDestroySampler(device_, sampler_, nullptr);
+}
+
+AtlasSpriteHandle TextureAtlas::insert(const std::string &name, const void *rgba, uint32_t width, uint32_t height) {
+    auto iter = sprites_.find(name);
+    if (iter != sprites_.end()) {
+        iter->second->refCount_++;
+        iter->second->lastUsedFrame_ = frameNumber_;
+        return iter->second;
+    }
+
+    const uint32_t paddedWidth = width + 2 * PADDING;
+    const uint32_t paddedHeight = height + 2 * PADDING;
+    if (width == 0 || height == 0 || paddedWidth > pageSize_ || paddedHeight > pageSize_) {
+        LOGE("texture atlas: %s (%dx%d) does not fit in a %d page", name.c_str(), width, height, pageSize_);
+        return nullptr;
+    }
+    uint32_t pageId, x, y;
+    if (!allocate(paddedWidth, paddedHeight, &pageId, &x, &y)) {
+        LOGW("texture atlas: no space for %s (%dx%d)", name.c_str(), width, height);
+        return nullptr;
+    }
+
+    // 在staging缓冲中写入四周扩展了边缘像素的图像
+    VkBuffer stagingBuffer;
+    VulkanMemoryAllocation stagingMemory;
+    if (!createStaging((VkDeviceSize) paddedWidth * paddedHeight * 4, &stagingBuffer, &stagingMemory)) {
+        pages_[pageId].deadArea_ += (uint64_t) paddedWidth * paddedHeight; // 已装入的位置作废
+        return nullptr;
+    }
+    const uint32_t *src = (const uint32_t *) rgba;
+    uint32_t *dst = (uint32_t *) stagingMemory.mapped_;
+    for (uint32_t row = 0; row < paddedHeight; row++) {
+        uint32_t srcRow = std::min(std::max(row, PADDING) - PADDING, height - 1);
+        const uint32_t *srcLine = src + (size_t) srcRow * width;
+        uint32_t *dstLine = dst + (size_t) row * paddedWidth;
+        for (uint32_t i = 0; i < PADDING; i++) {
+            dstLine[i] = srcLine[0];
+            dstLine[PADDING + width + i] = srcLine[width - 1];
+        }
+        memcpy(dstLine + PADDING, srcLine, width * 4);
+    }
+
+    Page &page = pages_[pageId];
+    uint64_t uploadId;
+    VkCommandBuffer cmdBuffer = uploader_->getCommandBuffer(&uploadId);
+    VkBufferImageCopy region = {};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {(int32_t) x, (int32_t) y, 0};
+    region.imageExtent = {paddedWidth, paddedHeight, 1};
+    vkCmdCopyBufferToImage(cmdBuffer, stagingBuffer, page.image_, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+    recordBarrier(cmdBuffer, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    uploader_->addStagingBuffer(stagingBuffer, stagingMemory);
+    page.lastUploadId_ = uploadId;
+
+    AtlasSpriteHandle sprite = std::make_shared<AtlasSprite>();
+    sprite->name_ = name;
+    sprite->refCount_ = 1;
+    sprite->lastUsedFrame_ = frameNumber_;
+    sprite->region_ = makeRegion(pageId, x + PADDING, y + PADDING, width, height);
+    sprite->ready_ = false;
+    sprite->uploadId_ = uploadId;
+    sprite->moving_ = false;
+    sprite->moveUploadId_ = 0;
+    sprites_[name] = sprite;
+    waiting_.push_back(sprite);
+    return sprite;
+}
+
+AtlasSpriteHandle TextureAtlas::find(const std::string &name) {
+    auto iter = sprites_.find(name);
+    if (iter == sprites_.end()) return nullptr;
+    iter->second->refCount_++;
+    iter->second->lastUsedFrame_ = frameNumber_;
+    return iter->second;
+}
+
+void TextureAtlas::release(const AtlasSpriteHandle &sprite) {
+    assert(sprite->refCount_ > 0);
+    sprite->refCount_--;
+}
+
+bool TextureAtlas::getRegion(const AtlasSpriteHandle &sprite, AtlasRegion *region) {
+    if (!sprite->ready_) return false;
+    sprite->lastUsedFrame_ = frameNumber_;
+    *region = sprite->region_;
+    return true;
+}
+
+void TextureAtlas::beginFrame() {
+    frameNumber_++;
+    updateWaiting();
+
+    // 旧页：整理的复制完成后不再有新的绘制使用它，再等在途帧结束后销毁
+    for (auto iter = pages_.begin(); iter != pages_.end();) {
+        Page &page = iter->second;
+        if (page.retired_ && page.retiredFrame_ == UINT64_MAX && uploader_->isReady(page.retireUploadId_)) {
+            page.retiredFrame_ = frameNumber_;
+        }
+        if (page.retired_ && page.retiredFrame_ != UINT64_MAX &&
+            frameNumber_ >= page.retiredFrame_ + framesInFlight_) {
+            destroyPage(page);
+            iter = pages_.erase(iter);
+        } else {
+            iter++;
+        }
+    }
+}
+
+void TextureAtlas::updateWaiting() {
+    // 同一批次的精灵通常相邻，记住上一次查询的结果
+    uint64_t lastId = 0;
+    bool lastReady = false;
+    auto isReady = [this, &lastId, &lastReady](uint64_t uploadId) {
+        if (uploadId != lastId) {
+            lastId = uploadId;
+            lastReady = uploader_->isReady(uploadId);
+        }
+        return lastReady;
+    };
+
+    for (auto iter = waiting_.begin(); iter != waiting_.end();) {
+        AtlasSprite &sprite = **iter;
+        if (!sprite.ready_ && isReady(sprite.uploadId_)) sprite.ready_ = true;
+        if (sprite.moving_ && isReady(sprite.moveUploadId_)) {
+            sprite.region_ = sprite.newRegion_;
+            sprite.moving_ = false;
+        }
+        if (sprite.ready_ && !sprite.moving_) {
+            iter = waiting_.erase(iter);
+        } else {
+            iter++;
+        }
+    }
+}
+
+bool TextureAtlas::allocate(uint32_t width, uint32_t height, uint32_t *pageId, uint32_t *x, uint32_t *y) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        for (auto iter = pages_.begin(); iter != pages_.end(); iter++) {
+            if (iter->second.retired_) continue;
+            if (iter->second.packer_.pack(width, height, x, y)) {
+                *pageId = iter->first;
+                return true;
+            }
+        }
+        if (getLivePageCount() < maxPages_) {
+            if (!createPage(pageId)) return false;
+            return pages_[*pageId].packer_.pack(width, height, x, y);
+        }
+        // 所有页都已满：淘汰后再试一次
+        if (attempt == 0 && !evict()) return false;
+    }
+    return false;
+}
+
+bool TextureAtlas::canDefragment(uint32_t pageId) {
+    auto pageIter = pages_.find(pageId);
+    if (pageIter == pages_.end() || pageIter->second.retired_) return false;
+    // 仍有写入该页的复制未完成（或其中有精灵正在移入）时不整理
+    return uploader_->isReady(pageIter->second.lastUploadId_);
+}
+
+bool TextureAtlas::evict() {
+    updateWaiting();
+
+    // 没有引用的精灵按最久未使用排序
+    std::vector<AtlasSpriteHandle> candidates;
+    for (auto iter = sprites_.begin(); iter != sprites_.end(); iter++) {
+        if (iter->second->refCount_ == 0 && !iter->second->moving_) candidates.push_back(iter->second);
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const AtlasSpriteHandle &a, const AtlasSpriteHandle &b) {
+        return a->lastUsedFrame_ < b->lastUsedFrame_;
+    });
+
+    // 先只累计，不淘汰：按LRU的顺序累计各页将要留下的空洞，第一个达到其面积1/4的页为目标；
+    // 都达不到时取空洞最多的页。只考虑此刻可以整理的页，整理不了的页上的精灵不会被白白淘汰
+    const uint64_t pageArea = (uint64_t) pageSize_ * pageSize_;
+    std::map<uint32_t, uint64_t> deadAreas; // 页编号 -> 淘汰之后的空洞面积
+    std::map<uint32_t, size_t> evictCounts; // 页编号 -> 该页上需要淘汰的候选数（按LRU的前缀）
+    for (auto iter = pages_.begin(); iter != pages_.end(); iter++) {
+        if (canDefragment(iter->first)) deadAreas[iter->first] = iter->second.deadArea_;
+    }
+    uint32_t target = UINT32_MAX;
+    for (auto iter = candidates.begin(); iter != candidates.end() && target == UINT32_MAX; iter++) {
+        const AtlasRegion &region = (*iter)->region_;
+        auto deadArea = deadAreas.find(region.page_);
+        if (deadArea == deadAreas.end()) continue;
+        deadArea->second += (uint64_t) (region.width_ + 2 * PADDING) * (region.height_ + 2 * PADDING);
+        evictCounts[region.page_]++;
+        if (deadArea->second * 4 >= pageArea) target = region.page_;
+    }
+    if (target == UINT32_MAX) {
+        uint64_t maxDeadArea = 0;
+        for (auto iter = deadAreas.begin(); iter != deadAreas.end(); iter++) {
+            if (iter->second > maxDeadArea) {
+                maxDeadArea = iter->second;
+                target = iter->first;
+            }
+        }
+    }
+    if (target == UINT32_MAX) return false;
+
+    // 淘汰目标页上累计过的候选；淘汰的精灵像素保持不动，仍在途的帧可以继续采样，直到旧页被销毁
+    // defragment()以sprites_中余下的精灵为准重新装箱，因此先移出，整理失败时再放回，空间不会因此泄漏
+    size_t evictCount = evictCounts[target];
+    std::vector<AtlasSpriteHandle> evicted;
+    for (auto iter = candidates.begin(); iter != candidates.end() && evictCount > 0; iter++) {
+        if ((*iter)->region_.page_ != target) continue;
+        sprites_.erase((*iter)->name_);
+        evicted.push_back(*iter);
+        evictCount--;
+    }
+    if (!defragment(target)) {
+        for (auto iter = evicted.begin(); iter != evicted.end(); iter++) sprites_[(*iter)->name_] = *iter;
+        return false;
+    }
+
+    // 目标页已整理，淘汰生效
+    Page &page = pages_[target];
+    for (auto iter = evicted.begin(); iter != evicted.end(); iter++) {
+        const AtlasRegion &region = (*iter)->region_;
+        page.deadArea_ += (uint64_t) (region.width_ + 2 * PADDING) * (region.height_ + 2 * PADDING);
+    }
+    evictCount_ += evicted.size();
+    return true;
+}
+
+bool TextureAtlas::defragment(uint32_t pageId) {
+    updateWaiting();
+    if (!canDefragment(pageId)) return false;
+    auto pageIter = pages_.find(pageId);
+
+    // 仍在图集中的精灵，按高度从高到低重新装箱
+    std::vector<AtlasSpriteHandle> live;
+    for (auto iter = sprites_.begin(); iter != sprites_.end(); iter++) {
+        if (iter->second->region_.page_ == pageId) live.push_back(iter->second);
+    }
+    std::sort(live.begin(), live.end(), [](const AtlasSpriteHandle &a, const AtlasSpriteHandle &b) {
+        return a->region_.height_ > b->region_.height_;
+    });
+
+    Page &old = pageIter->second;
+    old.retired_ = true;
+    old.retiredFrame_ = UINT64_MAX;
+    old.retireUploadId_ = old.lastUploadId_;
+    if (live.empty()) {
+        defragmentCount_++;
+        return true;
+    }
+
+    uint32_t newPageId;
+    if (!createPage(&newPageId)) {
+        old.retired_ = false;
+        return false;
+    }
+    Page &page = pages_[newPageId];
+    std::vector<VkImageCopy> copies;
+    std::vector<AtlasRegion> newRegions;
+    for (auto iter = live.begin(); iter != live.end(); iter++) {
+        const AtlasRegion &region = (*iter)->region_;
+        uint32_t x, y;
+        if (!page.packer_.pack(region.width_ + 2 * PADDING, region.height_ + 2 * PADDING, &x, &y)) {
+            // 重新装箱后反而放不下（skyline不保证最优），放弃整理
+            LOGW("texture atlas: failed to repack page %d", pageId);
+            page.retired_ = true;
+            page.retiredFrame_ = UINT64_MAX;
+            page.retireUploadId_ = page.lastUploadId_;
+            old.retired_ = false;
+            return false;
+        }
+        VkImageCopy copy = {};
+        copy.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        copy.srcOffset = {(int32_t) (region.x_ - PADDING), (int32_t) (region.y_ - PADDING), 0};
+        copy.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        copy.dstOffset = {(int32_t) x, (int32_t) y, 0};
+        copy.extent = {region.width_ + 2 * PADDING, region.height_ + 2 * PADDING, 1};
+        copies.push_back(copy);
+        newRegions.push_back(makeRegion(newPageId, x + PADDING, y + PADDING, region.width_, region.height_));
+    }
+
+    uint64_t uploadId;
+    VkCommandBuffer cmdBuffer = uploader_->getCommandBuffer(&uploadId);
+    // 之前写入旧页的复制对这里的读取可见
+    recordBarrier(cmdBuffer, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    vkCmdCopyImage(cmdBuffer, old.image_, VK_IMAGE_LAYOUT_GENERAL, page.image_, VK_IMAGE_LAYOUT_GENERAL,
+                   copies.size(), copies.data());
+    recordBarrier(cmdBuffer, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    page.lastUploadId_ = uploadId;
+    old.retireUploadId_ = uploadId;
+
+    // 复制完成前精灵仍从旧页采样
+    for (size_t i = 0; i < live.size(); i++) {
+        live[i]->moving_ = true;
+        live[i]->newRegion_ = newRegions[i];
+        live[i]->moveUploadId_ = uploadId;
+        waiting_.push_back(live[i]);
+    }
+    defragmentCount_++;
+    LOGI("texture atlas: page %d (%d sprites) defragmented into page %d", pageId, (int) live.size(), newPageId);
+    return true;
+}
+
+bool TextureAtlas::createPage(uint32_t *pageId) {
+    Page page;
+    page.image_ = VK_NULL_HANDLE;
+    page.view_ = VK_NULL_HANDLE;
+    page.packer_.reset(pageSize_, pageSize_);
+    page.deadArea_ = 0;
+    page.retired_ = false;
+    page.retireUploadId_ = 0;
+    page.retiredFrame_ = UINT64_MAX;
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.extent = {pageSize_, pageSize_, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (uploader_->hasDedicatedTransferQueue()) {
+        imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        imageInfo.queueFamilyIndexCount = 2;
+        imageInfo.pQueueFamilyIndices = uploader_->getQueueFamilyIndices();
+    } else {
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    CALL_VK(vkCreateImage(device_, &imageInfo, nullptr, &page.image_));
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device_, page.image_, &memRequirements);
+    memRequirements.alignment = std::max(memRequirements.alignment, bufferImageGranularity_);
+    memRequirements.size = alignUp(memRequirements.size, bufferImageGranularity_);
+    if (!memoryArena_->alloc(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &page.memory_)) {
+        LOGE("texture atlas: out of device local memory for a %d page", pageSize_);
+        vkDestroyImage(device_, page.image_, nullptr);
+        return false;
+    }
+    CALL_VK(vkBindImageMemory(device_, page.image_, page.memory_.memory_, page.memory_.offset_));
+
+    VkImageViewCreateInfo viewInfo{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .image = page.image_,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = VK_FORMAT_R8G8B8A8_UNORM,
+            .components = {
+                    .r = VK_COMPONENT_SWIZZLE_R,
+                    .g = VK_COMPONENT_SWIZZLE_G,
+                    .b = VK_COMPONENT_SWIZZLE_B,
+                    .a = VK_COMPONENT_SWIZZLE_A,
+            },
+            .subresourceRange = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+            },
+    };
+    CALL_VK(vkCreateImageView(device_, &viewInfo, nullptr, &page.view_));
+
+    // 页一直处于GENERAL布局：复制与采样都可以使用，之后写入新的区域时不必转换整页的布局
+    VkCommandBuffer cmdBuffer = uploader_->getCommandBuffer(&page.lastUploadId_);
+    setImageLayout(cmdBuffer, page.image_, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                   VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    *pageId = nextPageId_++;
+    pages_[*pageId] = page;
+    return true;
+}
+
+void TextureAtlas::destroyPage(Page &page) {
+    vkDestroyImageView(device_, page.view_, nullptr);
+    vkDestroyImage(device_, page.image_, nullptr);
+    memoryArena_->free(page.memory_);
+}
+
+bool TextureAtlas::createStaging(VkDeviceSize size, VkBuffer *buffer, VulkanMemoryAllocation *memory) {
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    CALL_VK(vkCreateBuffer(device_, &bufferInfo, nullptr, buffer));
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device_, *buffer, &memRequirements);
+    if (!memoryArena_->alloc(memRequirements,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, memory)) {
+        LOGE("texture atlas: out of staging memory for %d bytes", (int) size);
+        vkDestroyBuffer(device_, *buffer, nullptr);
+        return false;
+    }
+    CALL_VK(vkBindBufferMemory(device_, *buffer, memory->memory_, memory->offset_));
+    return true;
+}
+
+void TextureAtlas::recordBarrier(VkCommandBuffer cmdBuffer, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage) {
+    // 独立的传输队列不支持片元着色器阶段，对图形队列的可见性由fence完成后才采样来保证
+    if (uploader_->hasDedicatedTransferQueue() && dstStage != VK_PIPELINE_STAGE_TRANSFER_BIT) return;
+    VkMemoryBarrier barrier{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = dstAccess,
+    };
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+AtlasRegion TextureAtlas::makeRegion(uint32_t pageId, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    AtlasRegion region;
+    region.page_ = pageId;
+    region.x_ = x;
+    region.y_ = y;
+    region.width_ = width;
+    region.height_ = height;
+    region.u0_ = (float) x / pageSize_;
+    region.v0_ = (float) y / pageSize_;
+    region.u1_ = (float) (x + width) / pageSize_;
+    region.v1_ = (float) (y + height) / pageSize_;
+    return region;
+}
+
+VkImageView TextureAtlas::getPageView(uint32_t page) {
+    auto iter = pages_.find(page);
+    return iter == pages_.end() ? VK_NULL_HANDLE : iter->second.view_;
+}
+
+VkSampler TextureAtlas::getSampler() {
+    return sampler_;
+}
+
+uint32_t TextureAtlas::getLivePageCount() {
+    uint32_t count = 0;
+    for (auto iter = pages_.begin(); iter != pages_.end(); iter++) {
+        if (!iter->second.retired_) count++;
+    }
+    return count;
+}
+
+uint32_t TextureAtlas::getPageCount() {
+    return getLivePageCount();
+}
+
+uint32_t TextureAtlas::getSpriteCount() {
+    return sprites_.size();
+}
+
+void TextureAtlas::dump() {
+    LOGI("texture atlas: %d sprites, %d pages of %d, %d waiting, %d evicted, %d defragmented",
+         getSpriteCount(), getLivePageCount(), pageSize_, (int) waiting_.size(), (int) evictCount_,
+         (int) defragmentCount_);
+    const double pageArea = (double) pageSize_ * pageSize_;
+    for (auto iter = pages_.begin(); iter != pages_.end(); iter++) {
+        Page &page = iter->second;
+        LOGI("\tpage %d: %.1f%% packed, %.1f%% dead%s", iter->first, page.packer_.getUsedArea() * 100.0 / pageArea,
+             page.deadArea_ * 100.0 / pageArea, page.retired_ ? ", retired" : "");
+    }
+}
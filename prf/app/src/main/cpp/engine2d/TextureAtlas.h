@@ -0,0 +1,141 @@
+//
+// Created by richardwu on 11/12/24.
+//
+
+#ifndef PRF_TEXTUREATLAS_H
+#define PRF_TEXTUREATLAS_H
+
+#include <vulkan_wrapper.h>
+#include "MemoryArena.h"
+#include "StaticBufferUploader.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * skyline装箱（bottom-left）：以一条由若干水平线段组成的“天际线”描述已占用区域的上边界，
+ * 新矩形放在使其顶部最低的位置（相同时选所在线段最窄的），之后抬高所覆盖的线段
+ * 只支持插入，移除后的空洞由TextureAtlas的整理回收
+ */
+class SkylinePacker
+{
+public:
+    void reset(uint32_t width, uint32_t height);
+    bool pack(uint32_t width, uint32_t height, uint32_t *x, uint32_t *y); // 放不下时返回false
+    uint64_t getUsedArea(); // 已装入的矩形面积之和
+
+private:
+    struct Segment {
+        uint32_t x_, y_, width_;
+    };
+
+    uint32_t width_, height_;
+    uint64_t usedArea_;
+    std::vector<Segment> skyline_; // 按x_递增，覆盖[0, width_)
+
+    bool fit(size_t index, uint32_t width, uint32_t height, uint32_t *y);
+};
+
+// 一个精灵在图集中的位置
+struct AtlasRegion {
+    uint32_t page_; // 页的编号，getPageView()使用
+    float u0_, v0_, u1_, v1_; // 归一化的纹理坐标（不含边缘的扩展像素）
+    uint32_t x_, y_, width_, height_; // 页内像素坐标（不含边缘的扩展像素）
+};
+
+struct AtlasSprite {
+    std::string name_;
+    uint32_t refCount_; // 为0时仍留在图集中，空间不足时按LRU淘汰
+    uint64_t lastUsedFrame_;
+    AtlasRegion region_; // ready_之后可用
+    bool ready_;
+    uint64_t uploadId_; // 写入region_的上传批次
+    // 整理中：新页中的位置，复制完成后替换region_
+    bool moving_;
+    AtlasRegion newRegion_;
+    uint64_t moveUploadId_;
+};
+typedef std::shared_ptr<AtlasSprite> AtlasSpriteHandle;
+
+/*
+ * 运行时图集：把大量小图（RGBA8）装进少数几张大的VkImage页中，绘制时同一页上的精灵可以合并为一次绘制，
+ * 不必每张小图绑定一次纹理
+ * 插入是增量的：像素写入staging缓冲，经StaticBufferUploader的批次复制到页中对应的位置，渲染线程不等待；
+ * 页的数量达到上限时淘汰最久未使用、且没有引用的精灵，淘汰留下的空洞较多时整理该页
+ * （把仍在使用的精灵重新装箱，以vkCmdCopyImage复制到一张新页，完成后旧页在在途帧结束后销毁）
+ * 页始终处于GENERAL布局，写入新区域时不需要对正被采样的整页做布局转换；所有页共用一个线性过滤的采样器
+ * 只能在渲染线程上使用
+ */
+class TextureAtlas
+{
+public:
+    static const uint32_t DEFAULT_PAGE_SIZE = 1024;
+    static const uint32_t DEFAULT_MAX_PAGES = 4;
+
+    TextureAtlas(VkDevice device, VkPhysicalDevice physicalDevice, MemoryArena *memoryArena,
+                 StaticBufferUploader *uploader, uint32_t framesInFlight,
+                 uint32_t pageSize = DEFAULT_PAGE_SIZE, uint32_t maxPages = DEFAULT_MAX_PAGES);
+    ~TextureAtlas(); // 调用者保证设备已空闲
+
+    // 以name为键插入一张小图，已存在时只增加引用计数；图集已满时返回nullptr
+    AtlasSpriteHandle insert(const std::string &name, const void *rgba, uint32_t width, uint32_t height);
+    AtlasSpriteHandle find(const std::string &name); // 取得已有的精灵（引用计数+1），没有时返回nullptr
+    void release(const AtlasSpriteHandle &sprite); // 引用计数-1
+    // 取得本帧绘制使用的位置，并标记为本帧使用；复制尚未完成时返回false，相应的绘制应被跳过
+    bool getRegion(const AtlasSpriteHandle &sprite, AtlasRegion *region);
+
+    void beginFrame(); // 每帧开始时调用（该帧的fence已signal）：更新就绪的精灵，销毁到期的旧页
+    bool defragment(uint32_t page); // 整理一页，需要一张空闲的页（可超出上限一张）
+
+    VkImageView getPageView(uint32_t page);
+    VkSampler getSampler(); // 采样页时使用，描述符中的布局为VK_IMAGE_LAYOUT_GENERAL
+    uint32_t getPageCount();
+    uint32_t getSpriteCount();
+    void dump(); // 以log的形式打印 for debug
+
+private:
+    struct Page {
+        VkImage image_;
+        VulkanMemoryAllocation memory_;
+        VkImageView view_;
+        SkylinePacker packer_;
+        uint64_t deadArea_; // 被淘汰的精灵留下的面积（含扩展像素），整理后回收
+        uint64_t lastUploadId_; // 最近一次写入该页的上传批次
+        bool retired_; // 已整理到新页，等待在途帧结束后销毁
+        uint64_t retireUploadId_;
+        uint64_t retiredFrame_;
+    };
+
+    VkDevice device_;
+    MemoryArena *memoryArena_;
+    StaticBufferUploader *uploader_;
+    uint32_t framesInFlight_;
+    uint32_t pageSize_;
+    uint32_t maxPages_;
+    VkDeviceSize bufferImageGranularity_;
+    uint64_t frameNumber_;
+    uint32_t nextPageId_;
+    VkSampler sampler_;
+
+    std::map<uint32_t, Page> pages_; // 页编号 -> 页（含等待销毁的旧页）
+    std::unordered_map<std::string, AtlasSpriteHandle> sprites_;
+    std::vector<AtlasSpriteHandle> waiting_; // 复制尚未完成（新插入或整理中）的精灵
+    uint64_t evictCount_;
+    uint64_t defragmentCount_;
+
+    uint32_t getLivePageCount();
+    bool createPage(uint32_t *pageId);
+    void destroyPage(Page &page);
+    bool allocate(uint32_t width, uint32_t height, uint32_t *pageId, uint32_t *x, uint32_t *y);
+    bool canDefragment(uint32_t pageId); // 该页存在、未被整理过，且写入它的复制都已完成
+    bool evict(); // 选定一个可以整理的页，淘汰其上没有引用的精灵并整理该页，有空间腾出时返回true
+    void updateWaiting(); // 复制完成的精灵开始使用新的位置
+    bool createStaging(VkDeviceSize size, VkBuffer *buffer, VulkanMemoryAllocation *memory);
+    AtlasRegion makeRegion(uint32_t pageId, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+    void recordBarrier(VkCommandBuffer cmdBuffer, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
+};
+
+#endif //PRF_TEXTUREATLAS_H
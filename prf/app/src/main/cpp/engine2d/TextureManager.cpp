@@ -0,0 +1,405 @@
+//
+// Created by richardwu on 11/11/24.
+//
+
+#include "TextureManager.h"
+#include "Trace.h"
+#include "image_layout.h"
+#include "../vulkan/utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+// 只从内存中解码（文件由AssetReader读取）
+#define STBI_NO_STDIO
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    if (alignment <= 1) return value;
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+TextureManager::TextureManager(VkDevice device, VkPhysicalDevice physicalDevice, MemoryArena *memoryArena,
+                               StaticBufferUploader *uploader, ThreadPool *threadPool,
+                               const AssetReader &assetReader, uint32_t framesInFlight) {
+    device_ = device;
+    memoryArena_ = memoryArena;
+    uploader_ = uploader;
+    threadPool_ = threadPool;
+    assetReader_ = assetReader;
+    framesInFlight_ = framesInFlight;
+    frameNumber_ = 0;
+    decodingCount_ = 0;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    bufferImageGranularity_ = properties.limits.bufferImageGranularity;
+}
+
+TextureManager::~TextureManager() {
+    // 工作线程持有this，先等待所有解码结束
+    {
+        std::unique_lock<std::mutex> locker(mutex_);
+        decodedCond_.wait(locker, [this] { return decodingCount_ == 0; });
+    }
+    for (auto iter = decoded_.begin(); iter != decoded_.end(); iter++) {
+        freeStaging(**iter);
+    }
+    decoded_.clear();
+
+    // 调用者保证设备已空闲（vkDeviceWaitIdle），复制与绘制都已结束
+    for (auto iter = textures_.begin(); iter != textures_.end(); iter++) {
+        destroyTexture(*iter->second);
+    }
+    textures_.clear();
+    for (auto iter = retired_.begin(); iter != retired_.end(); iter++) {
+        destroyTexture(**iter);
+    }
+    retired_.clear();
+    uploading_.clear();
+    for (auto iter = samplers_.begin(); iter != samplers_.end(); iter++) {
+        vkDestroySampler(device_, iter->second.sampler_, nullptr);
+    }
+    samplers_.clear();
+}
+
+TextureHandle TextureManager::acquire(const std::string &path, VkFilter filter) {
+    std::string key = std::to_string((int) filter) + ":" + path;
+    auto iter = textures_.find(key);
+    if (iter != textures_.end()) {
+        iter->second->refCount_++;
+        return iter->second;
+    }
+
+    TextureHandle texture = std::make_shared<Texture>();
+    texture->path_ = path;
+    texture->filter_ = filter;
+    texture->state_ = TEXTURE_STATE_DECODING;
+    texture->refCount_ = 1;
+    texture->width_ = 0;
+    texture->height_ = 0;
+    texture->image_ = VK_NULL_HANDLE;
+    texture->view_ = VK_NULL_HANDLE;
+    texture->sampler_ = acquireSampler(filter);
+    texture->stagingBuffer_ = VK_NULL_HANDLE;
+    texture->decodeOk_ = false;
+    texture->uploadId_ = 0;
+    texture->releasedFrame_ = 0;
+    textures_[key] = texture;
+
+    {
+        std::unique_lock<std::mutex> locker(mutex_);
+        decodingCount_++;
+    }
+    threadPool_->post([this, texture]() { decode(texture); });
+    return texture;
+}
+
+void TextureManager::release(const TextureHandle &texture) {
+    assert(texture->refCount_ > 0);
+    if (--texture->refCount_ > 0) return;
+
+    textures_.erase(std::to_string((int) texture->filter_) + ":" + texture->path_);
+    texture->releasedFrame_ = frameNumber_;
+    retired_.push_back(texture);
+}
+
+void TextureManager::decode(TextureHandle texture) {
+    TRACE_SCOPE("decode texture");
+    std::vector<char> content;
+    int width = 0, height = 0, components = 0;
+    stbi_uc *pixels = nullptr;
+    if (assetReader_(texture->path_.c_str(), &content)) {
+        // 统一解码为RGBA8，与VK_FORMAT_R8G8B8A8_UNORM对应
+        pixels = stbi_load_from_memory((const stbi_uc *) content.data(), content.size(),
+                                       &width, &height, &components, 4);
+    }
+
+    bool ok = false;
+    if (pixels == nullptr) {
+        LOGE("texture manager: failed to load %s (%s)", texture->path_.c_str(),
+             content.empty() ? "not found" : stbi_failure_reason());
+    } else {
+        // staging缓冲在工作线程上创建（MemoryArena加锁），解码结果也在这里写入其映射的内存，渲染线程只录制复制
+        VkDeviceSize size = (VkDeviceSize) width * height * 4;
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        CALL_VK(vkCreateBuffer(device_, &bufferInfo, nullptr, &texture->stagingBuffer_));
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(device_, texture->stagingBuffer_, &memRequirements);
+        if (memoryArena_->alloc(memRequirements,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                &texture->stagingMemory_)) {
+            CALL_VK(vkBindBufferMemory(device_, texture->stagingBuffer_, texture->stagingMemory_.memory_,
+                                       texture->stagingMemory_.offset_));
+            memcpy(texture->stagingMemory_.mapped_, pixels, size);
+            texture->width_ = width;
+            texture->height_ = height;
+            ok = true;
+        } else {
+            LOGE("texture manager: out of staging memory for %s (%dx%d)", texture->path_.c_str(), width, height);
+            vkDestroyBuffer(device_, texture->stagingBuffer_, nullptr);
+            texture->stagingBuffer_ = VK_NULL_HANDLE;
+        }
+        stbi_image_free(pixels);
+    }
+
+    {
+        std::unique_lock<std::mutex> locker(mutex_);
+        texture->decodeOk_ = ok;
+        decoded_.push_back(texture);
+        decodingCount_--;
+    }
+    decodedCond_.notify_all();
+}
+
+void TextureManager::beginFrame() {
+    frameNumber_++;
+
+    // 解码完成的纹理：创建图像并录制复制，复制随uploader的批次提交
+    std::vector<TextureHandle> decoded;
+    {
+        std::unique_lock<std::mutex> locker(mutex_);
+        decoded.swap(decoded_);
+    }
+    for (auto iter = decoded.begin(); iter != decoded.end(); iter++) {
+        Texture &texture = **iter;
+        if (!texture.decodeOk_) {
+            texture.state_ = TEXTURE_STATE_FAILED;
+            continue;
+        }
+        // 解码期间已被释放
+        if (texture.refCount_ == 0 || !createImage(texture)) {
+            freeStaging(texture);
+            texture.state_ = TEXTURE_STATE_FAILED;
+            continue;
+        }
+        recordUpload(texture);
+        texture.state_ = TEXTURE_STATE_UPLOADING;
+        uploading_.push_back(*iter);
+    }
+
+    // 复制完成的纹理可以开始采样
+    for (auto iter = uploading_.begin(); iter != uploading_.end();) {
+        if (uploader_->isReady((*iter)->uploadId_)) {
+            (*iter)->state_ = TEXTURE_STATE_READY;
+            iter = uploading_.erase(iter);
+        } else {
+            iter++;
+        }
+    }
+
+    // 引用计数归零、且不再被在途帧与复制使用的纹理
+    for (auto iter = retired_.begin(); iter != retired_.end();) {
+        Texture &texture = **iter;
+        bool busy = texture.state_ == TEXTURE_STATE_DECODING || texture.state_ == TEXTURE_STATE_UPLOADING;
+        if (!busy && frameNumber_ >= texture.releasedFrame_ + framesInFlight_) {
+            destroyTexture(texture);
+            iter = retired_.erase(iter);
+        } else {
+            iter++;
+        }
+    }
+}
+
+bool TextureManager::createImage(Texture &texture) {
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.extent = {texture.width_, texture.height_, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    // 与静态缓冲相同，有独立的传输队列时在两个队列族间CONCURRENT共享，省去所有权转移
+    if (uploader_->hasDedicatedTransferQueue()) {
+        imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        imageInfo.queueFamilyIndexCount = 2;
+        imageInfo.pQueueFamilyIndices = uploader_->getQueueFamilyIndices();
+    } else {
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    CALL_VK(vkCreateImage(device_, &imageInfo, nullptr, &texture.image_));
+
+    // OPTIMAL的图像与线性的缓冲共用DEVICE_LOCAL块，起点与大小都对齐到bufferImageGranularity，避免两者落在同一页内
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device_, texture.image_, &memRequirements);
+    memRequirements.alignment = std::max(memRequirements.alignment, bufferImageGranularity_);
+    memRequirements.size = alignUp(memRequirements.size, bufferImageGranularity_);
+    if (!memoryArena_->alloc(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture.memory_)) {
+        LOGE("texture manager: out of device local memory for %s", texture.path_.c_str());
+        vkDestroyImage(device_, texture.image_, nullptr);
+        texture.image_ = VK_NULL_HANDLE;
+        return false;
+    }
+    CALL_VK(vkBindImageMemory(device_, texture.image_, texture.memory_.memory_, texture.memory_.offset_));
+
+    VkImageViewCreateInfo viewInfo{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .image = texture.image_,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = VK_FORMAT_R8G8B8A8_UNORM,
+            .components = {
+                    .r = VK_COMPONENT_SWIZZLE_R,
+                    .g = VK_COMPONENT_SWIZZLE_G,
+                    .b = VK_COMPONENT_SWIZZLE_B,
+                    .a = VK_COMPONENT_SWIZZLE_A,
+            },
+            .subresourceRange = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+            },
+    };
+    CALL_VK(vkCreateImageView(device_, &viewInfo, nullptr, &texture.view_));
+    return true;
+}
+
+void TextureManager::recordUpload(Texture &texture) {
+    VkCommandBuffer cmdBuffer = uploader_->getCommandBuffer(&texture.uploadId_);
+
+    setImageLayout(cmdBuffer, texture.image_, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkBufferImageCopy region = {};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0; // 紧密排列
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {texture.width_, texture.height_, 1};
+    vkCmdCopyBufferToImage(cmdBuffer, texture.stagingBuffer_, texture.image_,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    if (uploader_->hasDedicatedTransferQueue()) {
+        // 传输队列不支持片元着色器阶段与SHADER_READ访问，只做布局转换；fence完成后图形队列才会采样
+        VkImageMemoryBarrier barrier = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .pNext = nullptr,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = 0,
+                .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = texture.image_,
+                .subresourceRange = {
+                        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                        .baseMipLevel = 0,
+                        .levelCount = 1,
+                        .baseArrayLayer = 0,
+                        .layerCount = 1,
+                },
+        };
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+    } else {
+        setImageLayout(cmdBuffer, texture.image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+
+    // staging缓冲交给uploader，所属批次完成后释放
+    uploader_->addStagingBuffer(texture.stagingBuffer_, texture.stagingMemory_);
+    texture.stagingBuffer_ = VK_NULL_HANDLE;
+}
+
+VkSampler TextureManager::acquireSampler(VkFilter filter) {
+    auto iter = samplers_.find(filter);
+    if (iter != samplers_.end()) {
+        iter->second.refCount_++;
+        return iter->second.sampler_;
+    }
+
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = filter;
+    samplerInfo.minFilter = filter;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = 0.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_TRANSPARENT_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+
+    Sampler sampler;
+    CALL_VK(vkCreateSampler(device_, &samplerInfo, nullptr, &sampler.sampler_));
+    sampler.refCount_ = 1;
+    samplers_[filter] = sampler;
+    return sampler.sampler_;
+}
+
+void TextureManager::releaseSampler(VkFilter filter) {
+    auto iter = samplers_.find(filter);
+    assert(iter != samplers_.end());
+    if (--iter->second.refCount_ > 0) return;
+    vkDestroySampler(device_, iter->second.sampler_, nullptr);
+    samplers_.erase(iter);
+}
+
+void TextureManager::destroyTexture(Texture &texture) {
+    freeStaging(texture);
+    if (texture.view_ != VK_NULL_HANDLE) {
+        vkDestroyImageView(device_, texture.view_, nullptr);
+        texture.view_ = VK_NULL_HANDLE;
+    }
+    if (texture.image_ != VK_NULL_HANDLE) {
+        vkDestroyImage(device_, texture.image_, nullptr);
+        memoryArena_->free(texture.memory_);
+        texture.image_ = VK_NULL_HANDLE;
+    }
+    if (texture.sampler_ != VK_NULL_HANDLE) {
+        releaseSampler(texture.filter_);
+        texture.sampler_ = VK_NULL_HANDLE;
+    }
+}
+
+void TextureManager::freeStaging(Texture &texture) {
+    if (texture.stagingBuffer_ == VK_NULL_HANDLE) return;
+    vkDestroyBuffer(device_, texture.stagingBuffer_, nullptr);
+    memoryArena_->free(texture.stagingMemory_);
+    texture.stagingBuffer_ = VK_NULL_HANDLE;
+}
+
+uint32_t TextureManager::getTextureCount() {
+    return textures_.size();
+}
+
+uint32_t TextureManager::getPendingCount() {
+    std::unique_lock<std::mutex> locker(mutex_);
+    return decodingCount_ + decoded_.size() + uploading_.size();
+}
+
+void TextureManager::dump() {
+    LOGI("texture manager: %d textures, %d pending, %d retired, %d samplers", getTextureCount(),
+         getPendingCount(), (int) retired_.size(), (int) samplers_.size());
+    for (auto iter = textures_.begin(); iter != textures_.end(); iter++) {
+        const Texture &texture = *iter->second;
+        // 解码中的纹理尺寸仍由工作线程写入，不读取
+        if (texture.state_ == TEXTURE_STATE_DECODING) {
+            LOGI("\t%s: decoding, %d refs", texture.path_.c_str(), texture.refCount_);
+        } else {
+            LOGI("\t%s: %dx%d, state %d, %d refs", texture.path_.c_str(), texture.width_, texture.height_,
+                 texture.state_, texture.refCount_);
+        }
+    }
+}
@@ -0,0 +1,113 @@
+//
+// Created by richardwu on 11/11/24.
+//
+
+#ifndef PRF_TEXTUREMANAGER_H
+#define PRF_TEXTUREMANAGER_H
+
+#include <vulkan_wrapper.h>
+#include "MemoryArena.h"
+#include "StaticBufferUploader.h"
+#include "ThreadPool.h"
+#include "asset.h"
+
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum TextureState {
+    TEXTURE_STATE_DECODING = 0, // 在工作线程上读取、解码
+    TEXTURE_STATE_DECODED, // 像素已在staging缓冲中，等待渲染线程录制复制
+    TEXTURE_STATE_UPLOADING, // 复制已录制，等待所属批次的fence
+    TEXTURE_STATE_READY, // 可以在绘制中采样
+    TEXTURE_STATE_FAILED, // 读取或解码失败
+};
+
+// 一张纹理，格式为R8G8B8A8_UNORM，单个mip level
+struct Texture {
+    std::string path_;
+    VkFilter filter_;
+    TextureState state_; // 只在渲染线程上读写
+    uint32_t refCount_;
+
+    uint32_t width_, height_;
+    VkImage image_;
+    VulkanMemoryAllocation memory_;
+    VkImageView view_;
+    VkSampler sampler_; // 同一filter的纹理共用
+
+    // 解码结果，由工作线程写入，经decoded_队列交给渲染线程
+    VkBuffer stagingBuffer_;
+    VulkanMemoryAllocation stagingMemory_;
+    bool decodeOk_;
+
+    uint64_t uploadId_; // 复制所在的上传批次
+    uint64_t releasedFrame_; // 引用计数归零的帧
+
+    bool isReady() const { return state_ == TEXTURE_STATE_READY; }
+};
+typedef std::shared_ptr<Texture> TextureHandle;
+
+/*
+ * 纹理管理：以路径为键，按引用计数管理VkImage、VkImageView与VkSampler的生命周期
+ * acquire()立即返回句柄，读取与stb_image解码在线程池中进行，解码结果写入持久映射的staging缓冲；
+ * 渲染线程每帧在beginFrame()中为解码完的纹理录制vkCmdCopyBufferToImage（经StaticBufferUploader的批次），
+ * fence完成后纹理变为READY，渲染线程在任何一步都不等待
+ * 引用计数归零的纹理在在途帧结束后才销毁；除工作线程的解码外，所有方法只能在渲染线程上调用
+ */
+class TextureManager
+{
+public:
+    TextureManager(VkDevice device, VkPhysicalDevice physicalDevice, MemoryArena *memoryArena,
+                   StaticBufferUploader *uploader, ThreadPool *threadPool, const AssetReader &assetReader,
+                   uint32_t framesInFlight);
+    ~TextureManager(); // 等待解码中的纹理，销毁所有纹理与采样器
+
+    // 引用计数+1，第一次请求时提交解码，立即返回
+    TextureHandle acquire(const std::string &path, VkFilter filter = VK_FILTER_LINEAR);
+    void release(const TextureHandle &texture); // 引用计数-1，归零后在途帧结束时销毁
+    void beginFrame(); // 每帧开始时调用（该帧的fence已signal）：录制复制、更新状态、销毁到期的纹理
+
+    uint32_t getTextureCount(); // 被引用的纹理数
+    uint32_t getPendingCount(); // 解码或上传中的纹理数
+    void dump(); // 以log的形式打印 for debug
+
+private:
+    struct Sampler {
+        VkSampler sampler_;
+        uint32_t refCount_; // 使用它的纹理数（含等待销毁的）
+    };
+
+    VkDevice device_;
+    MemoryArena *memoryArena_;
+    StaticBufferUploader *uploader_;
+    ThreadPool *threadPool_;
+    AssetReader assetReader_;
+    uint32_t framesInFlight_;
+    uint64_t frameNumber_;
+    VkDeviceSize bufferImageGranularity_;
+
+    std::unordered_map<std::string, TextureHandle> textures_; // 被引用的纹理，键为路径与filter
+    std::list<TextureHandle> uploading_; // 复制已录制、尚未完成
+    std::list<TextureHandle> retired_; // 引用计数归零，等待在途帧结束
+    std::unordered_map<int, Sampler> samplers_; // 按VkFilter
+
+    std::mutex mutex_; // 保护下面的decoded_与decodingCount_
+    std::condition_variable decodedCond_;
+    std::vector<TextureHandle> decoded_; // 解码结束（含失败），等待渲染线程处理
+    uint32_t decodingCount_;
+
+    void decode(TextureHandle texture); // 在工作线程上执行
+    bool createImage(Texture &texture);
+    void recordUpload(Texture &texture);
+    VkSampler acquireSampler(VkFilter filter);
+    void releaseSampler(VkFilter filter);
+    void destroyTexture(Texture &texture);
+    void freeStaging(Texture &texture);
+};
+
+#endif //PRF_TEXTUREMANAGER_H
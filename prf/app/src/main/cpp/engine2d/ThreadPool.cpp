@@ -0,0 +1,61 @@
+//
+// Created by richardwu on 11/3/24.
+//
+
+#include "ThreadPool.h"
+#include "Trace.h"
+#include "../vulkan/utils.h"
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+    exit_ = false;
+    if (threadCount == 0) threadCount = 1;
+    for (uint32_t i = 0; i < threadCount; i++) {
+        threads_.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+    LOGI("thread pool: %d threads", threadCount);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::unique_lock<std::mutex> locker(mutex_);
+        exit_ = true;
+    }
+    taskCond_.notify_all();
+    for (auto iter = threads_.begin(); iter != threads_.end(); iter++) {
+        iter->join();
+    }
+}
+
+void ThreadPool::post(const Task &task) {
+    {
+        std::unique_lock<std::mutex> locker(mutex_);
+        tasks_.push_back(task);
+    }
+    taskCond_.notify_one();
+}
+
+uint32_t ThreadPool::getThreadCount() {
+    return threads_.size();
+}
+
+uint32_t ThreadPool::getPendingCount() {
+    std::unique_lock<std::mutex> locker(mutex_);
+    return tasks_.size();
+}
+
+void ThreadPool::workerLoop() {
+    TraceSetThreadName("thread pool worker");
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> locker(mutex_);
+            taskCond_.wait(locker, [this] { return exit_ || !tasks_.empty(); });
+            // 退出前先把队列中的任务做完
+            if (tasks_.empty()) return;
+            task = tasks_.front();
+            tasks_.pop_front();
+        }
+        TRACE_SCOPE("ThreadPool task");
+        task();
+    }
+}
@@ -0,0 +1,42 @@
+//
+// Created by richardwu on 11/3/24.
+//
+
+#ifndef PRF_THREADPOOL_H
+#define PRF_THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::function<void()> Task;
+
+/*
+ * 后台线程池：任务按提交顺序被空闲的工作线程取走执行
+ * 用于管线编译等耗时、且不需要在当前帧内完成的工作
+ */
+class ThreadPool
+{
+public:
+    explicit ThreadPool(uint32_t threadCount);
+    ~ThreadPool(); // 执行完队列中剩余的任务后结束所有工作线程
+
+    void post(const Task &task); // 提交一个任务，立即返回
+    uint32_t getThreadCount();
+    uint32_t getPendingCount(); // 排队中（尚未开始执行）的任务数
+
+private:
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_; // 保护下面的任务队列
+    std::condition_variable taskCond_;
+    std::deque<Task> tasks_;
+    bool exit_;
+
+    void workerLoop();
+};
+
+#endif //PRF_THREADPOOL_H
@@ -0,0 +1,147 @@
+//
+// Created by richardwu on 11/8/24.
+//
+
+#include "Trace.h"
+#include "../log.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> traceEnabled(false);
+thread_local TraceThreadBuffer *traceThreadBuffer = nullptr;
+static thread_local const char *traceThreadName = nullptr; // 缓冲创建之前设置的线程名
+
+// 所有线程的缓冲，只在注册与导出时加锁
+static std::mutex traceMutex;
+static std::vector<TraceThreadBuffer *> traceBuffers;
+
+TraceThreadBuffer *traceRegisterThread() {
+    TraceThreadBuffer *buffer = new TraceThreadBuffer();
+    buffer->threadName_ = traceThreadName;
+    buffer->head_.store(0, std::memory_order_relaxed);
+    buffer->flushed_.store(0, std::memory_order_relaxed);
+    {
+        std::unique_lock<std::mutex> locker(traceMutex);
+        buffer->threadId_ = traceBuffers.size() + 1;
+        traceBuffers.push_back(buffer);
+    }
+    traceThreadBuffer = buffer;
+    return buffer;
+}
+
+void TraceSetEnabled(bool enabled) {
+    traceEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool TraceIsEnabled() {
+    return traceEnabled.load(std::memory_order_relaxed);
+}
+
+void TraceSetThreadName(const char *name) {
+    // 不在这里创建缓冲，从不打点的线程不占用内存
+    traceThreadName = name;
+    if (traceThreadBuffer) {
+        std::unique_lock<std::mutex> locker(traceMutex);
+        traceThreadBuffer->threadName_ = name;
+    }
+}
+
+// 取出缓冲中[flushed_, head_)内仍未被覆盖的事件
+static void collectEvents(TraceThreadBuffer *buffer, bool clear, std::vector<TraceEvent> *events) {
+    const uint64_t capacity = TraceThreadBuffer::CAPACITY;
+    uint64_t head = buffer->head_.load(std::memory_order_acquire);
+    uint64_t begin = std::max(buffer->flushed_.load(std::memory_order_relaxed),
+                              head > capacity ? head - capacity : 0);
+    events->clear();
+    for (uint64_t i = begin; i < head; i++) {
+        // 拷贝期间所属线程可能已经写到了下一圈：序号不是第i个事件写完后的值，或拷贝前后不同，即已被覆盖
+        const TraceSlot &slot = buffer->slots_[i & (capacity - 1)];
+        uint64_t seq = slot.seq_.load(std::memory_order_acquire);
+        if (seq != i * 2 + 2) continue;
+        TraceEvent event;
+        event.time_ = slot.time_.load(std::memory_order_relaxed);
+        event.name_ = slot.name_.load(std::memory_order_relaxed);
+        event.value_ = slot.value_.load(std::memory_order_relaxed);
+        event.type_ = slot.type_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq_.load(std::memory_order_relaxed) != seq) continue;
+        events->push_back(event);
+    }
+    if (clear) buffer->flushed_.store(head, std::memory_order_relaxed);
+}
+
+// 写一个JSON字符串（含引号），转义引号、反斜杠与控制字符
+static void writeJsonString(FILE *file, const char *text) {
+    fputc('"', file);
+    for (const unsigned char *c = (const unsigned char *) text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', file);
+            fputc(*c, file);
+        } else if (*c < 0x20) {
+            fprintf(file, "\\u%04x", *c);
+        } else {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+// traceNow()的一个单位对应的微秒数
+static double traceTickToUs() {
+#if defined(__aarch64__)
+    uint64_t frequency;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+    return 1e6 / frequency;
+#else
+    return 1e-3;
+#endif
+}
+
+bool TraceWriteChromeJson(const std::string &path, bool clear) {
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) {
+        LOGE("trace: cannot open %s", path.c_str());
+        return false;
+    }
+
+    std::unique_lock<std::mutex> locker(traceMutex);
+    const double tickToUs = traceTickToUs();
+    std::vector<TraceEvent> events;
+    uint64_t eventCount = 0;
+    bool first = true;
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (auto iter = traceBuffers.begin(); iter != traceBuffers.end(); iter++) {
+        TraceThreadBuffer *buffer = *iter;
+        if (buffer->threadName_) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                    first ? "" : ",\n", buffer->threadId_);
+            writeJsonString(file, buffer->threadName_);
+            fprintf(file, "}}");
+            first = false;
+        }
+
+        collectEvents(buffer, clear, &events);
+        for (auto event = events.begin(); event != events.end(); event++) {
+            // ts以微秒为单位；名字可能含有引号等字符，转义后写入
+            fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+            writeJsonString(file, event->name_);
+            fprintf(file, ",\"ph\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%.3f",
+                    event->type_ == TRACE_EVENT_BEGIN ? "B" : event->type_ == TRACE_EVENT_END ? "E" : "C",
+                    buffer->threadId_, event->time_ * tickToUs);
+            if (event->type_ == TRACE_EVENT_COUNTER) {
+                fprintf(file, ",\"args\":{\"value\":%lld}", (long long) event->value_);
+            }
+            fprintf(file, "}");
+            first = false;
+        }
+        eventCount += events.size();
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    LOGI("trace: wrote %d events of %d threads to %s", (int) eventCount, (int) traceBuffers.size(), path.c_str());
+    return true;
+}
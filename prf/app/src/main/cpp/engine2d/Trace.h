@@ -0,0 +1,121 @@
+//
+// Created by richardwu on 11/8/24.
+//
+
+#ifndef PRF_TRACE_H
+#define PRF_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/*
+ * 热路径上的低开销打点
+ * 每个线程第一次打点时获得自己的环形事件缓冲，之后写入只是一次时钟读取与几次store，不加锁
+ * 每个槽位带一个序号（seqlock）：写入前置为奇数，写完置为偶数；导出时序号前后不变且为该事件应有的值才采用，
+ * 在弱内存序的CPU（ARM）上也不会读到写了一半或已被下一圈覆盖的事件
+ * 缓冲写满后覆盖最早的事件；导出时按需转为Chrome trace-event JSON（chrome://tracing与Perfetto UI均可打开）
+ * 关闭时（默认）每个打点只有一次relaxed load
+ */
+
+enum TraceEventType {
+    TRACE_EVENT_BEGIN = 0, // 区间开始
+    TRACE_EVENT_END, // 区间结束
+    TRACE_EVENT_COUNTER, // 计数器的当前值
+};
+
+struct TraceEvent {
+    uint64_t time_; // traceNow()的返回值
+    const char *name_; // 需为静态字符串，导出时才读取
+    int64_t value_; // 只用于计数器
+    uint32_t type_;
+};
+
+// 环形缓冲中的一个槽位，各字段与序号一样为atomic（relaxed的读写在ARM上即普通的ldr/str）
+// 第i个事件（head_为i时写入）写入期间seq_为2i + 1，写完后为2i + 2；初始的0不对应任何事件
+struct TraceSlot {
+    std::atomic<uint64_t> seq_;
+    std::atomic<uint64_t> time_;
+    std::atomic<const char *> name_;
+    std::atomic<int64_t> value_;
+    std::atomic<uint32_t> type_;
+};
+
+// 每个线程一个，单写者（所属线程）单读者（导出）
+struct TraceThreadBuffer {
+    static const uint32_t CAPACITY = 16384; // 2的整次幂，每个线程640KB
+
+    uint32_t threadId_; // 按注册顺序编号
+    const char *threadName_;
+    std::atomic<uint64_t> head_; // 已写入的事件总数，只由所属线程递增
+    std::atomic<uint64_t> flushed_; // 导出并清除时记下的head_，之前的事件不再导出
+    TraceSlot slots_[CAPACITY];
+};
+
+extern std::atomic<bool> traceEnabled;
+extern thread_local TraceThreadBuffer *traceThreadBuffer;
+
+// 打点用的时钟：arm64上直接读通用定时器（不经过clock_gettime，只需几纳秒），导出时按其频率换算；其他平台为steady_clock的纳秒
+inline uint64_t traceNow() {
+#if defined(__aarch64__)
+    uint64_t ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+TraceThreadBuffer *traceRegisterThread(); // 为当前线程创建缓冲（每个线程只发生一次，之后保留到进程结束）
+
+inline void traceEmit(TraceEventType type, const char *name, int64_t value) {
+    if (!traceEnabled.load(std::memory_order_relaxed)) return;
+    TraceThreadBuffer *buffer = traceThreadBuffer ? traceThreadBuffer : traceRegisterThread();
+    uint64_t head = buffer->head_.load(std::memory_order_relaxed);
+    TraceSlot &slot = buffer->slots_[head & (TraceThreadBuffer::CAPACITY - 1)];
+    // 序号先置为奇数，release fence保证导出线程看到之后的任一字段时也能看到奇数的序号
+    slot.seq_.store(head * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.time_.store(traceNow(), std::memory_order_relaxed);
+    slot.name_.store(name, std::memory_order_relaxed);
+    slot.value_.store(value, std::memory_order_relaxed);
+    slot.type_.store(type, std::memory_order_relaxed);
+    slot.seq_.store(head * 2 + 2, std::memory_order_release);
+    buffer->head_.store(head + 1, std::memory_order_release);
+}
+
+// 作用域内的区间：构造时开始，析构时结束（顺序执行的几段用TRACE_BEGIN/TRACE_END）
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name) : name_(name) {
+        active_ = traceEnabled.load(std::memory_order_relaxed);
+        if (active_) traceEmit(TRACE_EVENT_BEGIN, name_, 0);
+    }
+    ~TraceScope() {
+        if (active_) traceEmit(TRACE_EVENT_END, name_, 0);
+    }
+
+private:
+    const char *name_;
+    bool active_; // 开始时已开启才记录结束，避免中途开关造成不成对的事件
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_BEGIN(name) traceEmit(TRACE_EVENT_BEGIN, name, 0)
+#define TRACE_END(name) traceEmit(TRACE_EVENT_END, name, 0)
+#define TRACE_COUNTER(name, value) traceEmit(TRACE_EVENT_COUNTER, name, (int64_t) (value))
+
+void TraceSetEnabled(bool enabled);
+bool TraceIsEnabled();
+void TraceSetThreadName(const char *name); // 当前线程在导出时显示的名字（需为静态字符串）
+
+// 将所有线程缓冲中的事件写为Chrome trace-event JSON，clear为true时之后的导出不再包含这些事件
+// 可以在其他线程仍在打点时调用，导出期间被覆盖的事件会被丢弃
+bool TraceWriteChromeJson(const std::string &path, bool clear = true);
+
+#endif //PRF_TRACE_H
@@ -0,0 +1,51 @@
+//
+// Created by richardwu on 11/5/24.
+//
+
+#ifndef PRF_ASSET_H
+#define PRF_ASSET_H
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifdef __ANDROID__
+#include <game-activity/native_app_glue/android_native_app_glue.h>
+#endif
+
+// 读取assets中的一个文件（如"shaders/rect.vert.spv"），失败时返回false
+typedef std::function<bool(const char *filePath, std::vector<char> *content)> AssetReader;
+
+#ifdef __ANDROID__
+// 从APK的assets中读取（AAssetManager可以被多个线程同时使用）
+static inline AssetReader getAssetReader(android_app *androidAppCtx) {
+    AAssetManager *assetManager = androidAppCtx->activity->assetManager;
+    return [assetManager](const char *filePath, std::vector<char> *content) {
+        AAsset *file = AAssetManager_open(assetManager, filePath, AASSET_MODE_BUFFER);
+        if (file == nullptr) return false;
+        content->resize(AAsset_getLength(file));
+        bool ok = AAsset_read(file, content->data(), content->size()) == (int) content->size();
+        AAsset_close(file);
+        return ok;
+    };
+}
+#endif
+
+// 从磁盘上的目录中读取（headless后端使用，assets在构建时输出到该目录下）
+static inline AssetReader getAssetReader(const std::string &assetDir) {
+    return [assetDir](const char *filePath, std::vector<char> *content) {
+        std::string path = assetDir + "/" + filePath;
+        FILE *file = fopen(path.c_str(), "rb");
+        if (file == nullptr) return false;
+        fseek(file, 0, SEEK_END);
+        long fileLength = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        content->resize(fileLength > 0 ? fileLength : 0);
+        bool ok = fileLength > 0 && fread(content->data(), 1, fileLength, file) == (size_t) fileLength;
+        fclose(file);
+        return ok;
+    };
+}
+
+#endif //PRF_ASSET_H
@@ -0,0 +1,219 @@
+//
+// Created by richardwu on 11/13/24.
+//
+
+#include "geometry_kernels.h"
+
+#include <cstring>
+
+// 乘加不能被编译器合并为FMA（clang默认在表达式内合并，GCC编译C++时默认任意合并），
+// 否则标量与SIMD路径在有FMA的目标上（arm64、-march=haswell等）舍入不同
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#if !defined(ENGINE2D_SCALAR_KERNELS) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define KERNELS_NEON 1
+#include <arm_neon.h>
+#elif !defined(ENGINE2D_SCALAR_KERNELS) && (defined(__SSE2__) || defined(_M_X64))
+#define KERNELS_SSE2 1
+#include <emmintrin.h>
+#if defined(__SSSE3__)
+#define KERNELS_SSSE3 1
+#include <tmmintrin.h>
+#endif
+#endif
+
+// 标量路径，同时处理SIMD路径余下的元素
+
+static inline void storeVertex(char *dst, float a, float b, float c, float d, uint32_t color) {
+    float values[4] = {a, b, c, d};
+    memcpy(dst, values, sizeof(values));
+    memcpy(dst + 16, &color, sizeof(color));
+}
+
+static void interleaveRectsScalar(const float *x, const float *y, const float *w, const float *h,
+                                  const uint32_t *rgba, uint32_t begin, uint32_t count, char *out) {
+    for (uint32_t i = begin; i < count; i++) {
+        storeVertex(out + i * 20, x[i], y[i], w[i], h[i], __builtin_bswap32(rgba[i])); // 小端
+    }
+}
+
+static void expandSpritesScalar(const SpriteBatchSoA &b, uint32_t begin, uint32_t count, const Affine2D &m,
+                                SpriteVertex *out) {
+    for (uint32_t i = begin; i < count; i++) {
+        const float cornerX[4] = {b.x_[i], b.x_[i] + b.w_[i], b.x_[i] + b.w_[i], b.x_[i]};
+        const float cornerY[4] = {b.y_[i], b.y_[i], b.y_[i] + b.h_[i], b.y_[i] + b.h_[i]};
+        const float u[4] = {b.u0_[i], b.u1_[i], b.u1_[i], b.u0_[i]};
+        const float v[4] = {b.v0_[i], b.v0_[i], b.v1_[i], b.v1_[i]};
+        uint32_t color = __builtin_bswap32(b.rgba_[i]);
+        for (uint32_t k = 0; k < 4; k++) {
+            storeVertex((char *) &out[4 * i + k], m.a_ * cornerX[k] + m.c_ * cornerY[k] + m.tx_,
+                        m.b_ * cornerX[k] + m.d_ * cornerY[k] + m.ty_, u[k], v[k], color);
+        }
+    }
+}
+
+#if KERNELS_NEON
+
+static inline uint32x4_t packColor4(const uint32_t *rgba) {
+    // 每个32位元素内字节逆序
+    return vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8((const uint8_t *) rgba)));
+}
+
+// 4个元素的a、b、c、d与颜色，转置后写入dst、dst+stride、...，每个20字节
+static inline void store4(float32x4_t a, float32x4_t b, float32x4_t c, float32x4_t d, uint32x4_t color,
+                          char *dst, size_t stride) {
+    float32x4x2_t ab = vzipq_f32(a, b); // a0 b0 a1 b1 | a2 b2 a3 b3
+    float32x4x2_t cd = vzipq_f32(c, d);
+    vst1q_f32((float *) dst, vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0])));
+    vst1q_f32((float *) (dst + stride), vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0])));
+    vst1q_f32((float *) (dst + 2 * stride), vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1])));
+    vst1q_f32((float *) (dst + 3 * stride), vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1])));
+    vst1q_lane_u32((uint32_t *) (dst + 16), color, 0);
+    vst1q_lane_u32((uint32_t *) (dst + stride + 16), color, 1);
+    vst1q_lane_u32((uint32_t *) (dst + 2 * stride + 16), color, 2);
+    vst1q_lane_u32((uint32_t *) (dst + 3 * stride + 16), color, 3);
+}
+
+void interleaveRects(const float *x, const float *y, const float *w, const float *h, const uint32_t *rgba,
+                     uint32_t count, void *out) {
+    char *dst = (char *) out;
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        store4(vld1q_f32(x + i), vld1q_f32(y + i), vld1q_f32(w + i), vld1q_f32(h + i), packColor4(rgba + i),
+               dst + i * 20, 20);
+    }
+    interleaveRectsScalar(x, y, w, h, rgba, i, count, dst);
+}
+
+void expandSprites(const SpriteBatchSoA &b, uint32_t count, const Affine2D &m, SpriteVertex *out) {
+    const float32x4_t tx = vdupq_n_f32(m.tx_), ty = vdupq_n_f32(m.ty_);
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t x0 = vld1q_f32(b.x_ + i), y0 = vld1q_f32(b.y_ + i);
+        float32x4_t x1 = vaddq_f32(x0, vld1q_f32(b.w_ + i)), y1 = vaddq_f32(y0, vld1q_f32(b.h_ + i));
+        float32x4_t u0 = vld1q_f32(b.u0_ + i), v0 = vld1q_f32(b.v0_ + i);
+        float32x4_t u1 = vld1q_f32(b.u1_ + i), v1 = vld1q_f32(b.v1_ + i);
+        uint32x4_t color = packColor4(b.rgba_ + i);
+
+        const float32x4_t cornerX[4] = {x0, x1, x1, x0};
+        const float32x4_t cornerY[4] = {y0, y0, y1, y1};
+        const float32x4_t u[4] = {u0, u1, u1, u0};
+        const float32x4_t v[4] = {v0, v0, v1, v1};
+        for (uint32_t k = 0; k < 4; k++) {
+            // 与标量的a*x + c*y + tx同样的顺序：先各自相乘，再依次相加（vmlaq会先加tx，arm64上还会合并为FMA）
+            float32x4_t px = vaddq_f32(vaddq_f32(vmulq_n_f32(cornerX[k], m.a_), vmulq_n_f32(cornerY[k], m.c_)), tx);
+            float32x4_t py = vaddq_f32(vaddq_f32(vmulq_n_f32(cornerX[k], m.b_), vmulq_n_f32(cornerY[k], m.d_)), ty);
+            // 第k个角：4个精灵的顶点相隔4个SpriteVertex
+            store4(px, py, u[k], v[k], color, (char *) &out[4 * i + k], 4 * sizeof(SpriteVertex));
+        }
+    }
+    expandSpritesScalar(b, i, count, m, out);
+}
+
+const char *getGeometryKernelIsa() {
+    return "neon";
+}
+
+#elif KERNELS_SSE2
+
+static inline __m128i packColor4(const uint32_t *rgba) {
+    __m128i c = _mm_loadu_si128((const __m128i *) rgba);
+#if KERNELS_SSSE3
+    const __m128i mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    return _mm_shuffle_epi8(c, mask);
+#else
+    // 没有pshufb时以移位拼出每个32位元素的字节逆序
+    const __m128i byteMask = _mm_set1_epi32(0x00FF00FF);
+    __m128i swapped16 = _mm_or_si128(_mm_slli_epi32(c, 16), _mm_srli_epi32(c, 16)); // 交换高低16位
+    return _mm_or_si128(_mm_and_si128(_mm_srli_epi32(swapped16, 8), byteMask),
+                        _mm_slli_epi32(_mm_and_si128(swapped16, byteMask), 8)); // 交换每16位中的两个字节
+#endif
+}
+
+static inline void store4(__m128 a, __m128 b, __m128 c, __m128 d, __m128i color, char *dst, size_t stride) {
+    _MM_TRANSPOSE4_PS(a, b, c, d); // a、b、c、d变为4个元素各自的(a, b, c, d)
+    _mm_storeu_ps((float *) dst, a);
+    _mm_storeu_ps((float *) (dst + stride), b);
+    _mm_storeu_ps((float *) (dst + 2 * stride), c);
+    _mm_storeu_ps((float *) (dst + 3 * stride), d);
+    uint32_t colors[4];
+    _mm_storeu_si128((__m128i *) colors, color);
+    memcpy(dst + 16, &colors[0], 4);
+    memcpy(dst + stride + 16, &colors[1], 4);
+    memcpy(dst + 2 * stride + 16, &colors[2], 4);
+    memcpy(dst + 3 * stride + 16, &colors[3], 4);
+}
+
+void interleaveRects(const float *x, const float *y, const float *w, const float *h, const uint32_t *rgba,
+                     uint32_t count, void *out) {
+    char *dst = (char *) out;
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        store4(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i), _mm_loadu_ps(w + i), _mm_loadu_ps(h + i),
+               packColor4(rgba + i), dst + i * 20, 20);
+    }
+    interleaveRectsScalar(x, y, w, h, rgba, i, count, dst);
+}
+
+void expandSprites(const SpriteBatchSoA &b, uint32_t count, const Affine2D &m, SpriteVertex *out) {
+    const __m128 ma = _mm_set1_ps(m.a_), mb = _mm_set1_ps(m.b_), mc = _mm_set1_ps(m.c_), md = _mm_set1_ps(m.d_);
+    const __m128 tx = _mm_set1_ps(m.tx_), ty = _mm_set1_ps(m.ty_);
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 x0 = _mm_loadu_ps(b.x_ + i), y0 = _mm_loadu_ps(b.y_ + i);
+        __m128 x1 = _mm_add_ps(x0, _mm_loadu_ps(b.w_ + i)), y1 = _mm_add_ps(y0, _mm_loadu_ps(b.h_ + i));
+        __m128 u0 = _mm_loadu_ps(b.u0_ + i), v0 = _mm_loadu_ps(b.v0_ + i);
+        __m128 u1 = _mm_loadu_ps(b.u1_ + i), v1 = _mm_loadu_ps(b.v1_ + i);
+        __m128i color = packColor4(b.rgba_ + i);
+
+        const __m128 cornerX[4] = {x0, x1, x1, x0};
+        const __m128 cornerY[4] = {y0, y0, y1, y1};
+        const __m128 u[4] = {u0, u1, u1, u0};
+        const __m128 v[4] = {v0, v0, v1, v1};
+        for (uint32_t k = 0; k < 4; k++) {
+            __m128 px = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ma, cornerX[k]), _mm_mul_ps(mc, cornerY[k])), tx);
+            __m128 py = _mm_add_ps(_mm_add_ps(_mm_mul_ps(mb, cornerX[k]), _mm_mul_ps(md, cornerY[k])), ty);
+            // 第k个角：4个精灵的顶点相隔4个SpriteVertex
+            store4(px, py, u[k], v[k], color, (char *) &out[4 * i + k], 4 * sizeof(SpriteVertex));
+        }
+    }
+    expandSpritesScalar(b, i, count, m, out);
+}
+
+const char *getGeometryKernelIsa() {
+#if KERNELS_SSSE3
+    return "ssse3";
+#else
+    return "sse2";
+#endif
+}
+
+#else
+
+void interleaveRects(const float *x, const float *y, const float *w, const float *h, const uint32_t *rgba,
+                     uint32_t count, void *out) {
+    interleaveRectsScalar(x, y, w, h, rgba, 0, count, (char *) out);
+}
+
+void expandSprites(const SpriteBatchSoA &b, uint32_t count, const Affine2D &m, SpriteVertex *out) {
+    expandSpritesScalar(b, 0, count, m, out);
+}
+
+const char *getGeometryKernelIsa() {
+    return "scalar";
+}
+
+#endif
+
+void interleaveRectsReference(const float *x, const float *y, const float *w, const float *h, const uint32_t *rgba,
+                              uint32_t count, void *out) {
+    interleaveRectsScalar(x, y, w, h, rgba, 0, count, (char *) out);
+}
+
+void expandSpritesReference(const SpriteBatchSoA &batch, uint32_t count, const Affine2D &m, SpriteVertex *out) {
+    expandSpritesScalar(batch, 0, count, m, out);
+}
@@ -0,0 +1,55 @@
+//
+// Created by richardwu on 11/13/24.
+//
+
+#ifndef PRF_GEOMETRY_KERNELS_H
+#define PRF_GEOMETRY_KERNELS_H
+
+#include <cstdint>
+
+/*
+ * 批量几何数据的生成：输入为结构体数组（SoA，每个属性一个连续数组），
+ * 一次遍历完成颜色打包、仿射变换与交错（interleave），直接写入映射的上传内存
+ * arm64-v8a/armeabi-v7a上使用NEON，x86/x86_64上使用SSE2（有SSSE3时颜色打包用pshufb），其余为标量实现
+ * 每次处理4个元素，余下的不足4个走标量路径；输出不要求对齐（4字节对齐即可）
+ * SIMD路径与标量实现的运算顺序相同（先乘后加，不合并为FMA），结果逐位一致，由benchmark/geometry_kernels_check校验
+ * 定义ENGINE2D_SCALAR_KERNELS可强制使用标量实现，用于对比
+ */
+
+// 2D仿射变换：x' = a*x + c*y + tx，y' = b*x + d*y + ty
+struct Affine2D {
+    float a_, b_, c_, d_, tx_, ty_;
+};
+
+static inline Affine2D affineIdentity() {
+    return Affine2D{1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f};
+}
+
+// 精灵的顶点：像素坐标、图集中的纹理坐标、R8G8B8A8_UNORM颜色
+struct SpriteVertex {
+    float x_, y_, u_, v_;
+    uint32_t color_;
+};
+
+// 一批精灵（SoA），位置与尺寸为变换前的像素坐标，uv取自AtlasRegion
+struct SpriteBatchSoA {
+    const float *x_, *y_, *w_, *h_;
+    const float *u0_, *v0_, *u1_, *v1_;
+    const uint32_t *rgba_; // 0xRRGGBBAA
+};
+
+// 矩形实例的交错：每个实例20字节，依次为x、y、w、h（float）与打包后的颜色（与RectInstance的布局相同）
+void interleaveRects(const float *x, const float *y, const float *w, const float *h, const uint32_t *rgba,
+                     uint32_t count, void *out);
+
+// 每个精灵展开为4个顶点（左上、右上、右下、左下，与单位四边形的索引0,1,2,2,3,0对应），顶点位置经过m变换
+void expandSprites(const SpriteBatchSoA &batch, uint32_t count, const Affine2D &m, SpriteVertex *out);
+
+const char *getGeometryKernelIsa(); // "neon"、"ssse3"、"sse2"或"scalar"
+
+// 标量实现，不论编译时选择了哪种ISA，用于校验上面的SIMD路径
+void interleaveRectsReference(const float *x, const float *y, const float *w, const float *h, const uint32_t *rgba,
+                              uint32_t count, void *out);
+void expandSpritesReference(const SpriteBatchSoA &batch, uint32_t count, const Affine2D &m, SpriteVertex *out);
+
+#endif //PRF_GEOMETRY_KERNELS_H
@@ -11,10 +11,10 @@
  * setImageLayout():
  *    Helper function to transition color buffer layout
  */
-void setImageLayout(VkCommandBuffer cmdBuffer, VkImage image,
-                    VkImageLayout oldImageLayout, VkImageLayout newImageLayout,
-                    VkPipelineStageFlags srcStages,
-                    VkPipelineStageFlags destStages) {
+inline void setImageLayout(VkCommandBuffer cmdBuffer, VkImage image,
+                           VkImageLayout oldImageLayout, VkImageLayout newImageLayout,
+                           VkPipelineStageFlags srcStages,
+                           VkPipelineStageFlags destStages) {
     VkImageMemoryBarrier imageMemoryBarrier = {
             .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
             .pNext = nullptr,
@@ -5,58 +5,104 @@
 #ifndef PRF_PIPELINE_H
 #define PRF_PIPELINE_H
 
-#include <game-activity/native_app_glue/android_native_app_glue.h>
 #include <vulkan_wrapper.h>
 #include "../vulkan/utils.h"
+#include "utils.h"
+#include "asset.h"
 
-static VkShaderModule loadShaderFromFile(android_app *androidAppCtx, VkDevice device, const char *filePath) {
-    // Read the file
-    assert(androidAppCtx);
-    AAsset *file = AAssetManager_open(androidAppCtx->activity->assetManager,
-                                      filePath, AASSET_MODE_BUFFER);
-    size_t fileLength = AAsset_getLength(file);
-
-    char *fileContent = new char[fileLength];
+#include <vector>
 
-    AAsset_read(file, fileContent, fileLength);
-    AAsset_close(file);
+static VkShaderModule loadShaderFromFile(const AssetReader &assetReader, VkDevice device, const char *filePath) {
+    // Read the file
+    std::vector<char> fileContent;
+    if (!assetReader(filePath, &fileContent)) {
+        LOGE("shader: failed to read %s", filePath);
+        assert(false);
+    }
 
     VkShaderModuleCreateInfo shaderModuleCreateInfo{
             .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
             .pNext = nullptr,
             .flags = 0,
-            .codeSize = fileLength,
-            .pCode = (const uint32_t *) fileContent,
+            .codeSize = fileContent.size(),
+            .pCode = (const uint32_t *) fileContent.data(),
     };
 
     VkShaderModule shader;
 
     CALL_VK(vkCreateShaderModule(device, &shaderModuleCreateInfo, nullptr, &shader));
 
-    delete[] fileContent;
-
     return shader;
 }
 
-// 创建Graphics Pipeline（使用pipelineCache）
-void createGraphicsPipeline(android_app *androidAppCtx, VkDevice device, VkExtent2D extent2D,
-                                VkRenderPass renderPass, VkPipelineCache pipelineCache,
-                                VulkanPipelineInfo *pipelineInfo) {
+// 按照混合方式填写颜色混合状态
+static void getBlendAttachmentState(BlendMode blendMode, VkPipelineColorBlendAttachmentState *attachmentState) {
+    attachmentState->blendEnable = blendMode == BLEND_MODE_OPAQUE ? VK_FALSE : VK_TRUE;
+    attachmentState->colorBlendOp = VK_BLEND_OP_ADD;
+    attachmentState->alphaBlendOp = VK_BLEND_OP_ADD;
+    attachmentState->srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    attachmentState->dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    switch (blendMode) {
+        case BLEND_MODE_ADDITIVE:
+            attachmentState->srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+            attachmentState->dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            attachmentState->dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            break;
+        case BLEND_MODE_MULTIPLY:
+            attachmentState->srcColorBlendFactor = VK_BLEND_FACTOR_DST_COLOR;
+            attachmentState->dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+            break;
+        default:
+            attachmentState->srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+            attachmentState->dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            break;
+    }
+    attachmentState->colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+}
+
+// 设置动态的viewport与scissor（secondary command buffer不继承primary中的动态状态，需要各自设置）
+static void setViewportAndScissor(VkCommandBuffer cmdBuffer, VkExtent2D extent2D) {
+    VkViewport viewport{
+            .x = 0,
+            .y = 0,
+            .width = (float) extent2D.width,
+            .height = (float) extent2D.height,
+            .minDepth = 0.0f,
+            .maxDepth = 1.0f,
+    };
+    VkRect2D scissor = {
+            .offset {.x = 0, .y = 0,},
+            .extent = extent2D,
+    };
+    vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+}
+
+// 创建Graphics Pipeline（使用pipelineCache），着色器、顶点布局、混合方式等均由desc描述
+// viewport与scissor为动态状态，管线与交换链的尺寸无关，窗口尺寸变化时不需要重建
+void createGraphicsPipeline(const AssetReader &assetReader, VkDevice device, VkPipelineCache pipelineCache,
+                                const VulkanPipelineDesc &desc, VulkanPipelineInfo *pipelineInfo) {
     memset(pipelineInfo, 0, sizeof(VulkanPipelineInfo));
     // 管线布局（即定义uniform变量）
+    VkPushConstantRange pushConstantRange{
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .offset = 0,
+            .size = desc.pushConstantSize_,
+    };
     VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{
             .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
             .pNext = nullptr,
-            .setLayoutCount = 0,
-            .pSetLayouts = nullptr,
-            .pushConstantRangeCount = 0,
-            .pPushConstantRanges = nullptr,
+            .setLayoutCount = desc.setLayout_ != VK_NULL_HANDLE ? 1u : 0u,
+            .pSetLayouts = desc.setLayout_ != VK_NULL_HANDLE ? &desc.setLayout_ : nullptr,
+            .pushConstantRangeCount = desc.pushConstantSize_ ? 1u : 0u,
+            .pPushConstantRanges = desc.pushConstantSize_ ? &pushConstantRange : nullptr,
     };
     CALL_VK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo,
                                    nullptr, &pipelineInfo->layout_));
 
-    VkShaderModule vertexShader = loadShaderFromFile(androidAppCtx, device, "shaders/tri.vert.spv");
-    VkShaderModule fragmentShader = loadShaderFromFile(androidAppCtx, device, "shaders/tri.frag.spv");
+    VkShaderModule vertexShader = loadShaderFromFile(assetReader, device, desc.vertexShader_);
+    VkShaderModule fragmentShader = loadShaderFromFile(assetReader, device, desc.fragmentShader_);
 
     // Specify vertex and fragment shader stages
     VkPipelineShaderStageCreateInfo shaderStages[2]{
@@ -79,27 +125,22 @@ void createGraphicsPipeline(android_app *androidAppCtx, VkDevice device, VkExten
                     .pSpecializationInfo = nullptr,
             }};
 
-    VkViewport viewports{
-            .x = 0,
-            .y = 0,
-            .width = (float) extent2D.width,
-            .height = (float) extent2D.height,
-            .minDepth = 0.0f,
-            .maxDepth = 1.0f,
-    };
-
-    VkRect2D scissor = {
-            .offset {.x = 0, .y = 0,},
-            .extent = extent2D,
-    };
-    // Specify viewport info
+    // Specify viewport info（具体的值在录制时通过vkCmdSetViewport/vkCmdSetScissor设置）
     VkPipelineViewportStateCreateInfo viewportInfo{
             .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
             .pNext = nullptr,
             .viewportCount = 1,
-            .pViewports = &viewports,
+            .pViewports = nullptr,
             .scissorCount = 1,
-            .pScissors = &scissor,
+            .pScissors = nullptr,
+    };
+    VkDynamicState dynamicStates[2] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .dynamicStateCount = 2,
+            .pDynamicStates = dynamicStates,
     };
 
     // Specify multisample info
@@ -107,7 +148,7 @@ void createGraphicsPipeline(android_app *androidAppCtx, VkDevice device, VkExten
     VkPipelineMultisampleStateCreateInfo multisampleInfo{
             .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
             .pNext = nullptr,
-            .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+            .rasterizationSamples = desc.sampleCount_,
             .sampleShadingEnable = VK_FALSE,
             .minSampleShading = 0,
             .pSampleMask = &sampleMask,
@@ -116,11 +157,8 @@ void createGraphicsPipeline(android_app *androidAppCtx, VkDevice device, VkExten
     };
 
     // Specify color blend state
-    VkPipelineColorBlendAttachmentState attachmentStates{
-            .blendEnable = VK_FALSE,
-            .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-                              VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
-    };
+    VkPipelineColorBlendAttachmentState attachmentStates;
+    getBlendAttachmentState(desc.blendMode_, &attachmentStates);
     VkPipelineColorBlendStateCreateInfo colorBlendInfo{
             .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
             .pNext = nullptr,
@@ -148,29 +186,18 @@ void createGraphicsPipeline(android_app *androidAppCtx, VkDevice device, VkExten
     VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo{
             .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
             .pNext = nullptr,
-            .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+            .topology = desc.topology_,
             .primitiveRestartEnable = VK_FALSE,
     };
 
     // Specify vertex input state
-    VkVertexInputBindingDescription vertex_input_bindings{
-            .binding = 0,
-            .stride = 2 * sizeof(float), // 二维顶点
-            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
-    };
-    VkVertexInputAttributeDescription vertex_input_attributes[1]{{
-                                                                         .location = 0,
-                                                                         .binding = 0,
-                                                                         .format = VK_FORMAT_R32G32_SFLOAT, // 二维顶点
-                                                                         .offset = 0,
-                                                                 }};
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{
             .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
             .pNext = nullptr,
-            .vertexBindingDescriptionCount = 1,
-            .pVertexBindingDescriptions = &vertex_input_bindings,
-            .vertexAttributeDescriptionCount = 1,
-            .pVertexAttributeDescriptions = vertex_input_attributes,
+            .vertexBindingDescriptionCount = static_cast<uint32_t>(desc.bindings_.size()),
+            .pVertexBindingDescriptions = desc.bindings_.data(),
+            .vertexAttributeDescriptionCount = static_cast<uint32_t>(desc.attributes_.size()),
+            .pVertexAttributeDescriptions = desc.attributes_.data(),
     };
 
     // Create the pipeline
@@ -188,9 +215,9 @@ void createGraphicsPipeline(android_app *androidAppCtx, VkDevice device, VkExten
             .pMultisampleState = &multisampleInfo,
             .pDepthStencilState = nullptr,
             .pColorBlendState = &colorBlendInfo,
-            .pDynamicState = nullptr,
+            .pDynamicState = &dynamicInfo,
             .layout = pipelineInfo->layout_,
-            .renderPass = renderPass,
+            .renderPass = desc.renderPass_,
             .subpass = 0,
             .basePipelineHandle = VK_NULL_HANDLE,
             .basePipelineIndex = 0,
@@ -0,0 +1,78 @@
+//
+// Created by richardwu on 10/29/24.
+//
+
+#ifndef PRF_PROJECTION_H
+#define PRF_PROJECTION_H
+
+#include <vulkan_wrapper.h>
+
+#include <algorithm>
+#include <cmath>
+
+/*
+ * makeProjection():
+ *    像素坐标（原点在左上角，y轴向下）到裁剪空间的正交投影，列主序mat4，作为push constant传给着色器
+ *    extent为用户看到的尺寸；pretransform非IDENTITY时在裁剪空间中再旋转对应的角度（预旋转），
+ *    这样交换链图像保持设备的自然方向，合成器不需要额外的旋转
+ * makeScissor():
+ *    像素坐标中的矩形经同一个投影变换到交换链图像（displaySize）中的scissor，
+ *    边缘取整到最近的像素边界（与按像素中心光栅化一致），并限制在图像之内
+ */
+static inline void makeProjection(VkExtent2D extent, VkSurfaceTransformFlagBitsKHR pretransform,
+                                  float projection[16]) {
+    // 旋转角度的cos与sin（只有0/90/180/270度）
+    float c = 1.0f, s = 0.0f;
+    if (pretransform & VK_SURFACE_TRANSFORM_ROTATE_90_BIT_KHR) {
+        c = 0.0f;
+        s = 1.0f;
+    } else if (pretransform & VK_SURFACE_TRANSFORM_ROTATE_180_BIT_KHR) {
+        c = -1.0f;
+        s = 0.0f;
+    } else if (pretransform & VK_SURFACE_TRANSFORM_ROTATE_270_BIT_KHR) {
+        c = 0.0f;
+        s = -1.0f;
+    }
+    float sx = 2.0f / extent.width;
+    float sy = 2.0f / extent.height; // Vulkan裁剪空间的y轴本身向下
+
+    // rotate(z) * ortho
+    for (int i = 0; i < 16; i++) projection[i] = 0.0f;
+    projection[0] = c * sx;
+    projection[1] = s * sx;
+    projection[4] = -s * sy;
+    projection[5] = c * sy;
+    projection[10] = 1.0f;
+    projection[12] = -c + s;
+    projection[13] = -s - c;
+    projection[15] = 1.0f;
+}
+
+static inline VkRect2D makeScissor(const float projection[16], VkExtent2D displaySize,
+                                   float x, float y, float w, float h) {
+    float x0 = (float) displaySize.width, y0 = (float) displaySize.height, x1 = 0.0f, y1 = 0.0f;
+    const float cornersX[4] = {x, x + w, x + w, x};
+    const float cornersY[4] = {y, y, y + h, y + h};
+    for (int i = 0; i < 4; i++) {
+        // 裁剪空间[-1, 1]到图像的像素
+        float clipX = projection[0] * cornersX[i] + projection[4] * cornersY[i] + projection[12];
+        float clipY = projection[1] * cornersX[i] + projection[5] * cornersY[i] + projection[13];
+        float pixelX = (clipX + 1.0f) * 0.5f * displaySize.width;
+        float pixelY = (clipY + 1.0f) * 0.5f * displaySize.height;
+        x0 = std::min(x0, pixelX);
+        y0 = std::min(y0, pixelY);
+        x1 = std::max(x1, pixelX);
+        y1 = std::max(y1, pixelY);
+    }
+    int32_t left = (int32_t) std::max(std::floor(x0 + 0.5f), 0.0f);
+    int32_t top = (int32_t) std::max(std::floor(y0 + 0.5f), 0.0f);
+    int32_t right = (int32_t) std::min(std::floor(x1 + 0.5f), (float) displaySize.width);
+    int32_t bottom = (int32_t) std::min(std::floor(y1 + 0.5f), (float) displaySize.height);
+    VkRect2D scissor = {
+            .offset {.x = left, .y = top,},
+            .extent {.width = (uint32_t) std::max(right - left, 0), .height = (uint32_t) std::max(bottom - top, 0),},
+    };
+    return scissor;
+}
+
+#endif //PRF_PROJECTION_H
@@ -0,0 +1,211 @@
+//
+// Created by richardwu on 10/29/24.
+//
+
+#include "rect_buffer.h"
+
+#include <algorithm>
+
+static_assert(sizeof(RectInstance) == 20, "RectInstance must match the layout written by interleaveRects()");
+
+// GPU计时中各batch的名字，按BlendMode索引
+static const char *BATCH_SCOPE_NAMES[BLEND_MODE_COUNT] = {
+        "rect batch (opaque)", "rect batch (alpha)", "rect batch (additive)", "rect batch (multiply)"};
+
+// 裁剪矩形的下标占DrawList键中纹理编号的16位
+static const uint32_t MAX_CLIP_RECTS = 1u << 16;
+
+RectBuffer::RectBuffer(StaticBufferUploader *staticBufferUploader, QuadIndexBuffer *quadIndexBuffer,
+                       RingBuffer *transientBuffer, BufferManager *vertexBufferManager, FrameArena *frameArena)
+        : clipRects_(MAX_CLIP_RECTS) {
+    staticBufferUploader_ = staticBufferUploader;
+    quadIndexBuffer_ = quadIndexBuffer;
+    transientBuffer_ = transientBuffer;
+    vertexBufferManager_ = vertexBufferManager;
+    frameArena_ = frameArena;
+    instanceBuffer_ = VK_NULL_HANDLE;
+    instanceOffset_ = 0;
+    blendMode_ = BLEND_MODE_ALPHA;
+    layer_ = 0;
+    blendModeMask_ = 0;
+    culledCount_ = 0;
+
+    // 创建单位四边形的顶点（只在初始化时经staging缓冲复制一次，之后每帧从显存读取）
+    const float quadVertices[] = {0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f};
+    bool created = staticBufferUploader_->createStaticBuffer(
+            quadVertices, sizeof(quadVertices), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &quad_);
+    assert(created);
+    (void) created;
+    quadReady_ = false;
+    LOGI("rect buffer uses %s geometry kernels", getGeometryKernelIsa());
+}
+
+RectBuffer::~RectBuffer() {
+    staticBufferUploader_->destroyStaticBuffer(quad_);
+}
+
+void RectBuffer::setBlendMode(BlendMode blendMode) {
+    blendMode_ = blendMode;
+}
+
+void RectBuffer::setLayer(uint32_t layer) {
+    layer_ = layer;
+}
+
+void RectBuffer::setViewport(float width, float height) {
+    clipRects_.setViewport(width, height);
+}
+
+void RectBuffer::setClipRect(const SpatialRect &clipRect) {
+    clipRects_.setClipRect(clipRect);
+}
+
+void RectBuffer::resetClipRect() {
+    clipRects_.resetClipRect();
+}
+
+void RectBuffer::getCullRect(SpatialRect *cullRect) {
+    *cullRect = clipRects_.getCullRect();
+}
+
+void RectBuffer::drawRect(float x, float y, float w, float h, uint32_t rgba) {
+    // 在可见区域之外：不排序、不上传、不录制
+    if (clipRects_.cull(x, y, w, h)) {
+        culledCount_++;
+        return;
+    }
+
+    // 混合方式即管线的编号；矩形没有纹理，纹理的位置放裁剪矩形的下标
+    drawList_.add(layer_, blendMode_, clipRects_.getClip(), x, y, w, h);
+    blendModeMask_ |= 1u << blendMode_;
+
+    xs_.push_back(x);
+    ys_.push_back(y);
+    ws_.push_back(w);
+    hs_.push_back(h);
+    colors_.push_back(rgba); // 颜色的字节序在upload()中批量转换
+}
+
+uint32_t RectBuffer::getRectCount() {
+    return xs_.size();
+}
+
+uint32_t RectBuffer::getCulledCount() {
+    return culledCount_;
+}
+
+uint32_t RectBuffer::getBlendModeMask() {
+    return blendModeMask_;
+}
+
+uint32_t RectBuffer::getBatchCount() {
+    return batches_.size();
+}
+
+// 按order将src重排到dst
+template <typename T>
+static T *gather(const std::vector<T> &src, const uint32_t *order, T *dst) {
+    for (size_t i = 0; i < src.size(); i++) {
+        dst[i] = src[order[i]];
+    }
+    return dst;
+}
+
+void RectBuffer::upload(uint32_t frameIndex) {
+    // 复制完成之前不阻塞，这几帧的矩形直接跳过
+    if (!quadReady_) quadReady_ = staticBufferUploader_->isReady(quad_) && quadIndexBuffer_->isReady();
+    uint32_t count = getRectCount();
+    if (count == 0) return;
+    VkDeviceSize size = count * sizeof(RectInstance);
+
+    // 排序后相邻的同一混合方式、同一裁剪矩形合并为一个batch
+    bool reordered = drawList_.sort();
+    const uint64_t *keys = drawList_.getKeys();
+    batches_.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        if (i == 0 || !DrawList::isCompatible(keys[i - 1], keys[i])) {
+            batches_.push_back(RectBatch{(BlendMode) DrawList::getKeyPipeline(keys[i]),
+                                         DrawList::getKeyTexture(keys[i]), i});
+        }
+    }
+    const float *xs = xs_.data(), *ys = ys_.data(), *ws = ws_.data(), *hs = hs_.data();
+    const uint32_t *colors = colors_.data();
+    if (reordered) {
+        // 重排后的数组只活到交错写入为止，从本帧的FrameArena中分配
+        const uint32_t *order = drawList_.getOrder();
+        xs = gather(xs_, order, frameArena_->allocArray<float>(frameIndex, count));
+        ys = gather(ys_, order, frameArena_->allocArray<float>(frameIndex, count));
+        ws = gather(ws_, order, frameArena_->allocArray<float>(frameIndex, count));
+        hs = gather(hs_, order, frameArena_->allocArray<float>(frameIndex, count));
+        colors = gather(colors_, order, frameArena_->allocArray<uint32_t>(frameIndex, count));
+    }
+
+    // 交错与颜色打包一次完成，直接写入映射的内存，不经过中间的实例数组
+    VulkanTransientAllocation allocation;
+    if (transientBuffer_->alloc(frameIndex, size, sizeof(float), &allocation)) {
+        interleaveRects(xs, ys, ws, hs, colors, count, allocation.mapped_);
+        instanceBuffer_ = allocation.buffer_;
+        instanceOffset_ = allocation.offset_;
+        return;
+    }
+    LOGW("transient buffer region %d is full, falling back to buffer manager", frameIndex);
+    VulkanBufferInfo bufferInfo = vertexBufferManager_->allocBuffer(frameIndex, size);
+    interleaveRects(xs, ys, ws, hs, colors, count, bufferInfo.memory_.mapped_);
+    instanceBuffer_ = bufferInfo.buffer_;
+    instanceOffset_ = 0;
+}
+
+void RectBuffer::record(VkCommandBuffer cmdBuffer, const VulkanPipelineInfo pipelines[BLEND_MODE_COUNT],
+                        const float projection[16], VkExtent2D displaySize, uint32_t begin, uint32_t end,
+                        GpuProfiler *profiler) {
+    if (begin >= end || !quadReady_) return;
+
+    VkBuffer vertexBuffers[2] = {quad_.buffer_, instanceBuffer_};
+    VkDeviceSize offsets[2] = {0, instanceOffset_};
+    vkCmdBindVertexBuffers(cmdBuffer, 0, 2, vertexBuffers, offsets);
+    quadIndexBuffer_->bindSingleQuad(cmdBuffer);
+
+    // 每个与[begin, end)相交的batch绑定一次管线，再一次绘制其中的实例
+    // firstInstance使多个线程可以各自绘制其中一段
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    uint32_t boundClip = 0; // 调用者设置的scissor为整个图像
+    for (size_t i = 0; i < batches_.size(); i++) {
+        uint32_t batchBegin = std::max(batches_[i].begin_, begin);
+        uint32_t batchEnd = std::min(i + 1 < batches_.size() ? batches_[i + 1].begin_ : getRectCount(), end);
+        if (batchBegin >= batchEnd) continue;
+
+        const VulkanPipelineInfo &pipelineInfo = pipelines[batches_[i].blendMode_];
+        if (pipelineInfo.pipeline_ == VK_NULL_HANDLE) continue;
+        if (pipelineInfo.pipeline_ != boundPipeline) {
+            vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineInfo.pipeline_);
+            vkCmdPushConstants(cmdBuffer, pipelineInfo.layout_, VK_SHADER_STAGE_VERTEX_BIT,
+                               0, 16 * sizeof(float), projection);
+            boundPipeline = pipelineInfo.pipeline_;
+        }
+        if (batches_[i].clip_ != boundClip) {
+            clipRects_.setScissor(cmdBuffer, batches_[i].clip_, projection, displaySize);
+            boundClip = batches_[i].clip_;
+        }
+        uint32_t scope = profiler ? profiler->beginScope(cmdBuffer, BATCH_SCOPE_NAMES[batches_[i].blendMode_])
+                                  : GPU_PROFILER_INVALID_SCOPE;
+        vkCmdDrawIndexed(cmdBuffer, 6, batchEnd - batchBegin, 0, 0, batchBegin);
+        if (profiler) profiler->endScope(cmdBuffer, scope);
+    }
+    // 之后录制的精灵从整个图像开始
+    if (boundClip != 0) clipRects_.setScissor(cmdBuffer, 0, projection, displaySize);
+}
+
+void RectBuffer::clear() {
+    xs_.clear();
+    ys_.clear();
+    ws_.clear();
+    hs_.clear();
+    colors_.clear();
+    drawList_.clear();
+    batches_.clear();
+    blendMode_ = BLEND_MODE_ALPHA;
+    layer_ = 0;
+    blendModeMask_ = 0;
+    clipRects_.clear();
+    culledCount_ = 0;
+}
@@ -8,14 +8,98 @@
 #include "../../vulkan/utils.h"
 #include "../utils.h"
 #include "../BufferManager.h"
+#include "../RingBuffer.h"
+#include "../GpuProfiler.h"
+#include "../StaticBufferUploader.h"
+#include "../QuadIndexBuffer.h"
+#include "../geometry_kernels.h"
+#include "../DrawList.h"
+#include "../SpatialGrid.h"
+#include "../ClipRectTable.h"
+#include "../FrameArena.h"
 
-//void createRectVertexBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VulkanBufferInfo *vertexBufferInfo) {
-//    createVertexBuffer(device, physicalDevice, vertexBufferInfo);
-//}
-//
-//
-//void createRectIndexBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VulkanBufferInfo *indexBufferInfo) {
-//    createIndexBuffer(device, physicalDevice, indexBufferInfo);
-//}
+#include <vector>
+
+// 每个矩形的实例属性（对应rect.vert中location 1、2）
+struct RectInstance {
+    float x_, y_, w_, h_; // 像素坐标
+    uint32_t color_; // R8G8B8A8_UNORM，内存中依次为R、G、B、A
+};
+
+// 排序后连续使用同一混合方式、同一裁剪矩形的一段实例
+struct RectBatch {
+    BlendMode blendMode_;
+    uint32_t clip_; // 本帧裁剪矩形表中的下标，0为不裁剪
+    uint32_t begin_; // 第一个实例的下标，到下一个batch的begin_为止
+};
+
+/*
+ * 实例化的矩形绘制
+ * drawRect()只是向各属性的数组（SoA）追加一项，并以layer、混合方式为键提交到DrawList；
+ * 完全在视口（与裁剪矩形的交集）之外的矩形直接丢弃，不会被上传与录制；
+ * 大场景应以getCullRect()查询SpatialGrid，只提交可见的条目
+ * 裁剪矩形记入本帧的裁剪矩形表（ClipRectTable），其下标作为DrawList键中的纹理编号（矩形没有纹理），
+ * 因而排序时与其他状态一样：重叠的矩形保持顺序，不同裁剪矩形的矩形不合并；录制时每个batch以vkCmdSetScissor裁剪
+ * 每帧upload()一次：排序后（不重叠的矩形可以越过其他混合方式，与同一混合方式的矩形合并）按排序的顺序
+ * 以SIMD交错为实例数据直接写入上传内存，之后同一混合方式、同一裁剪矩形的连续矩形在共享的单位四边形上
+ * 用一次vkCmdDrawIndexed（instanceCount = N）画出
+ */
+class RectBuffer
+{
+public:
+    RectBuffer(StaticBufferUploader *staticBufferUploader, QuadIndexBuffer *quadIndexBuffer,
+               RingBuffer *transientBuffer, BufferManager *vertexBufferManager, FrameArena *frameArena);
+    ~RectBuffer(); // 释放单位四边形的顶点
+
+    void setBlendMode(BlendMode blendMode); // 之后的drawRect使用该混合方式，每帧开始时为BLEND_MODE_ALPHA
+    void setLayer(uint32_t layer); // 之后的drawRect所在的层（0~255，小的先画），每帧开始时为0
+    void setViewport(float width, float height); // 本帧绘制区域的尺寸（逻辑像素），每帧开始时设置
+    void setClipRect(const SpatialRect &clipRect); // 之后的drawRect裁剪到该矩形之内（逻辑像素），完全在外的被丢弃
+    void resetClipRect(); // 之后的drawRect不裁剪，每帧开始时不裁剪
+    void getCullRect(SpatialRect *cullRect); // 视口与裁剪矩形的交集
+    void drawRect(float x, float y, float w, float h, uint32_t rgba); // rgba: 0xRRGGBBAA
+    uint32_t getRectCount();
+    uint32_t getCulledCount(); // 本帧因在视口（与裁剪矩形的交集）之外被丢弃的矩形数
+    uint32_t getBlendModeMask(); // 本帧用到的混合方式，第i位对应BlendMode i
+    uint32_t getBatchCount(); // 排序合并后的batch数，upload()之后可用
+
+    // 排序本帧的矩形，将实例数据写入环形缓冲（环形缓冲已满时回退到vertexBufferManager）
+    void upload(uint32_t frameIndex);
+    // 录制排序后的实例[begin, end)，可在多个线程的secondary command buffer中同时调用
+    // pipelines按BlendMode索引，pipeline_为VK_NULL_HANDLE（如尚在编译）的batch会被跳过
+    // 单位四边形或共享的索引尚未复制到显存时（由upload()检查）整帧跳过
+    // 调用前scissor应为整个displaySize，有裁剪的batch经projection设置scissor，返回前恢复
+    // profiler不为空时每个batch的绘制计一个GPU区间（只用于录制线程上的primary指令缓冲）
+    void record(VkCommandBuffer cmdBuffer, const VulkanPipelineInfo pipelines[BLEND_MODE_COUNT],
+                const float projection[16], VkExtent2D displaySize, uint32_t begin, uint32_t end,
+                GpuProfiler *profiler = nullptr);
+    void clear(); // 清空实例数据，开始下一帧
+
+private:
+    StaticBufferUploader *staticBufferUploader_;
+    QuadIndexBuffer *quadIndexBuffer_;
+    RingBuffer *transientBuffer_;
+    BufferManager *vertexBufferManager_;
+    FrameArena *frameArena_; // upload()中排序后的临时数组
+
+    // 实例数据按属性分开存放，upload()时交错为RectInstance
+    std::vector<float> xs_, ys_, ws_, hs_;
+    std::vector<uint32_t> colors_; // 0xRRGGBBAA，upload()时打包
+    DrawList drawList_;
+    std::vector<RectBatch> batches_; // upload()中由排序后的键生成，按begin_递增
+    BlendMode blendMode_;
+    uint32_t layer_;
+    uint32_t blendModeMask_;
+    ClipRectTable clipRects_;
+    uint32_t culledCount_;
+
+    // 单位四边形的4个顶点（DEVICE_LOCAL），索引取自quadIndexBuffer_
+    VulkanStaticBuffer quad_;
+    bool quadReady_;
+
+    // 本帧实例数据的位置
+    VkBuffer instanceBuffer_;
+    VkDeviceSize instanceOffset_;
+};
 
 #endif //PRF_RECT_BUFFER_H
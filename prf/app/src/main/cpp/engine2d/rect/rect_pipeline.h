@@ -7,12 +7,52 @@
 
 #include "../../vulkan/utils.h"
 #include "../utils.h"
-#include "../pipeline.h"
+#include "rect_buffer.h"
 
-void createRectGraphicsPipeline(android_app *androidAppCtx, VkDevice device, VkExtent2D extent2D,
-                            VkRenderPass renderPass, VkPipelineCache pipelineCache,
-                            VulkanPipelineInfo *pipelineInfo) {
-    createGraphicsPipeline(androidAppCtx, device, extent2D, renderPass, pipelineCache, pipelineInfo);
+#include <cstddef>
+
+// 矩形管线的描述：binding 0为共享的单位四边形（逐顶点），binding 1为每个矩形的属性（逐实例）
+static VulkanPipelineDesc getRectPipelineDesc(VkRenderPass renderPass, BlendMode blendMode = BLEND_MODE_ALPHA) {
+    VulkanPipelineDesc desc;
+    desc.vertexShader_ = "shaders/rect.vert.spv";
+    desc.fragmentShader_ = "shaders/rect.frag.spv";
+    desc.bindings_ = {
+            {
+                    .binding = 0,
+                    .stride = 2 * sizeof(float), // 二维顶点
+                    .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+            },
+            {
+                    .binding = 1,
+                    .stride = sizeof(RectInstance),
+                    .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE,
+            }};
+    desc.attributes_ = {
+            {
+                    .location = 0,
+                    .binding = 0,
+                    .format = VK_FORMAT_R32G32_SFLOAT, // 二维顶点
+                    .offset = 0,
+            },
+            {
+                    .location = 1,
+                    .binding = 1,
+                    .format = VK_FORMAT_R32G32B32A32_SFLOAT, // x, y, w, h
+                    .offset = offsetof(RectInstance, x_),
+            },
+            {
+                    .location = 2,
+                    .binding = 1,
+                    .format = VK_FORMAT_R8G8B8A8_UNORM, // 颜色
+                    .offset = offsetof(RectInstance, color_),
+            }};
+    desc.pushConstantSize_ = 16 * sizeof(float); // mat4 projection
+    desc.setLayout_ = VK_NULL_HANDLE; // 不采样纹理
+    desc.blendMode_ = blendMode;
+    desc.topology_ = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    desc.sampleCount_ = VK_SAMPLE_COUNT_1_BIT;
+    desc.renderPass_ = renderPass;
+    return desc;
 }
 
 #endif //PRF_RECT_PIPELINE_H
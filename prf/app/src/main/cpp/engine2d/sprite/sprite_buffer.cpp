@@ -0,0 +1,371 @@
+//
+// Created by richardwu on 11/14/24.
+//
+
+#include "sprite_buffer.h"
+
+#include <algorithm>
+
+static_assert(sizeof(SpriteVertex) == 20, "SpriteVertex must match the layout written by expandSprites()");
+
+// 每帧最多使用的纹理数（即descriptor set数），超出的精灵被跳过
+static const uint32_t MAX_TEXTURES_PER_FRAME = 256;
+// 纹理表索引的表项数，2的整数次幂，装载率不超过1/2
+static const uint32_t TEXTURE_SLOT_BITS = 9;
+static const uint32_t TEXTURE_SLOT_COUNT = 1u << TEXTURE_SLOT_BITS;
+static_assert(TEXTURE_SLOT_COUNT >= MAX_TEXTURES_PER_FRAME * 2, "texture slots must stay at most half full");
+// DrawList键中的管线编号（16位）：低2位为混合方式，其余为裁剪矩形的下标
+static const uint32_t BLEND_MODE_BITS = 2;
+static const uint32_t MAX_CLIP_RECTS = 1u << (16 - BLEND_MODE_BITS);
+static_assert(BLEND_MODE_COUNT <= (1u << BLEND_MODE_BITS), "blend modes must fit in the low bits of the pipeline");
+
+// GPU计时中各batch的名字，按BlendMode索引
+static const char *BATCH_SCOPE_NAMES[BLEND_MODE_COUNT] = {
+        "sprite batch (opaque)", "sprite batch (alpha)", "sprite batch (additive)", "sprite batch (multiply)"};
+
+SpriteBuffer::SpriteBuffer(VkDevice device, QuadIndexBuffer *quadIndexBuffer, TextureAtlas *textureAtlas,
+                           RingBuffer *transientBuffer, BufferManager *vertexBufferManager, FrameArena *frameArena,
+                           uint32_t framesInFlight)
+        : clipRects_(MAX_CLIP_RECTS) {
+    device_ = device;
+    quadIndexBuffer_ = quadIndexBuffer;
+    textureAtlas_ = textureAtlas;
+    transientBuffer_ = transientBuffer;
+    vertexBufferManager_ = vertexBufferManager;
+    frameArena_ = frameArena;
+    vertexBuffer_ = VK_NULL_HANDLE;
+    vertexOffset_ = 0;
+    blendMode_ = BLEND_MODE_ALPHA;
+    layer_ = 0;
+    blendModeMask_ = 0;
+    skippedCount_ = 0;
+    culledCount_ = 0;
+    textureSlots_.assign(TEXTURE_SLOT_COUNT, TextureSlot{VK_NULL_HANDLE, 0, 0});
+    textureGeneration_ = 1;
+    textures_.reserve(MAX_TEXTURES_PER_FRAME);
+    descriptorSets_.reserve(MAX_TEXTURES_PER_FRAME);
+    imageInfos_.reserve(MAX_TEXTURES_PER_FRAME);
+    writes_.reserve(MAX_TEXTURES_PER_FRAME);
+
+    // set 0只有片元着色器采样的一张纹理
+    VkDescriptorSetLayoutBinding binding{
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .pImmutableSamplers = nullptr,
+    };
+    VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .bindingCount = 1,
+            .pBindings = &binding,
+    };
+    CALL_VK(vkCreateDescriptorSetLayout(device_, &setLayoutCreateInfo, nullptr, &setLayout_));
+    setLayouts_.assign(MAX_TEXTURES_PER_FRAME, setLayout_);
+
+    // 每个在途帧一个pool，不单独释放set，该帧的fence signal之后整体重置
+    VkDescriptorPoolSize poolSize{
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = MAX_TEXTURES_PER_FRAME,
+    };
+    VkDescriptorPoolCreateInfo poolCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .maxSets = MAX_TEXTURES_PER_FRAME,
+            .poolSizeCount = 1,
+            .pPoolSizes = &poolSize,
+    };
+    descriptorPools_.resize(framesInFlight);
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        CALL_VK(vkCreateDescriptorPool(device_, &poolCreateInfo, nullptr, &descriptorPools_[i]));
+    }
+}
+
+SpriteBuffer::~SpriteBuffer() {
+    for (size_t i = 0; i < descriptorPools_.size(); i++) {
+        vkDestroyDescriptorPool(device_, descriptorPools_[i], nullptr);
+    }
+    vkDestroyDescriptorSetLayout(device_, setLayout_, nullptr);
+}
+
+VkDescriptorSetLayout SpriteBuffer::getSetLayout() {
+    return setLayout_;
+}
+
+void SpriteBuffer::beginFrame(uint32_t frameIndex) {
+    CALL_VK(vkResetDescriptorPool(device_, descriptorPools_[frameIndex], 0));
+}
+
+void SpriteBuffer::setBlendMode(BlendMode blendMode) {
+    blendMode_ = blendMode;
+}
+
+void SpriteBuffer::setLayer(uint32_t layer) {
+    layer_ = layer;
+}
+
+void SpriteBuffer::setViewport(float width, float height) {
+    clipRects_.setViewport(width, height);
+}
+
+void SpriteBuffer::setClipRect(const SpatialRect &clipRect) {
+    clipRects_.setClipRect(clipRect);
+}
+
+void SpriteBuffer::resetClipRect() {
+    clipRects_.resetClipRect();
+}
+
+void SpriteBuffer::getCullRect(SpatialRect *cullRect) {
+    *cullRect = clipRects_.getCullRect();
+}
+
+bool SpriteBuffer::getTextureIndex(VkImageView view, VkSampler sampler, VkImageLayout layout, uint32_t *index) {
+    // 乘法哈希取高位，之后线性探测到该view的表项或本帧的空表项
+    uint64_t hash = (uint64_t) view * 0x9E3779B97F4A7C15ull;
+    uint32_t slot = (uint32_t) (hash >> (64 - TEXTURE_SLOT_BITS));
+    while (true) {
+        TextureSlot &entry = textureSlots_[slot];
+        if (entry.generation_ != textureGeneration_) break;
+        if (entry.view_ == view) {
+            *index = entry.index_;
+            return true;
+        }
+        slot = (slot + 1) & (TEXTURE_SLOT_COUNT - 1);
+    }
+    if (textures_.size() >= MAX_TEXTURES_PER_FRAME) return false;
+    *index = textures_.size();
+    textures_.push_back(SpriteTexture{view, sampler, layout});
+    textureSlots_[slot] = TextureSlot{view, textureGeneration_, *index};
+    return true;
+}
+
+void SpriteBuffer::addSprite(uint32_t texture, float x, float y, float w, float h,
+                             float u0, float v0, float u1, float v1, uint32_t rgba) {
+    // 在可见区域之外：不排序、不上传、不录制；w、h为负（镜像）时按实际覆盖的范围
+    if (clipRects_.cull(x, y, w, h)) {
+        culledCount_++;
+        return;
+    }
+
+    // 纹理占用键中的纹理编号，裁剪矩形的下标放在管线编号中混合方式之上
+    drawList_.add(layer_, blendMode_ | (clipRects_.getClip() << BLEND_MODE_BITS), texture, x, y, w, h);
+    blendModeMask_ |= 1u << blendMode_;
+
+    xs_.push_back(x);
+    ys_.push_back(y);
+    ws_.push_back(w);
+    hs_.push_back(h);
+    u0s_.push_back(u0);
+    v0s_.push_back(v0);
+    u1s_.push_back(u1);
+    v1s_.push_back(v1);
+    colors_.push_back(rgba);
+}
+
+void SpriteBuffer::drawTexture(const TextureHandle &texture, float x, float y, float w, float h, uint32_t rgba) {
+    // 解码或上传中的纹理不等待，本帧先跳过
+    uint32_t index;
+    if (!texture || !texture->isReady() ||
+        !getTextureIndex(texture->view_, texture->sampler_, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &index)) {
+        skippedCount_++;
+        return;
+    }
+    addSprite(index, x, y, w, h, 0.0f, 0.0f, 1.0f, 1.0f, rgba);
+}
+
+void SpriteBuffer::drawSprite(const AtlasSpriteHandle &sprite, float x, float y, float w, float h, uint32_t rgba) {
+    // 页始终处于GENERAL布局，同一页上的精灵共用一个descriptor set
+    AtlasRegion region;
+    uint32_t index;
+    if (!sprite || !textureAtlas_->getRegion(sprite, &region) ||
+        !getTextureIndex(textureAtlas_->getPageView(region.page_), textureAtlas_->getSampler(),
+                         VK_IMAGE_LAYOUT_GENERAL, &index)) {
+        skippedCount_++;
+        return;
+    }
+    addSprite(index, x, y, w, h, region.u0_, region.v0_, region.u1_, region.v1_, rgba);
+}
+
+uint32_t SpriteBuffer::getSpriteCount() {
+    return xs_.size();
+}
+
+uint32_t SpriteBuffer::getSkippedCount() {
+    return skippedCount_;
+}
+
+uint32_t SpriteBuffer::getCulledCount() {
+    return culledCount_;
+}
+
+uint32_t SpriteBuffer::getBlendModeMask() {
+    return blendModeMask_;
+}
+
+uint32_t SpriteBuffer::getBatchCount() {
+    return batches_.size();
+}
+
+// 按order将src重排到dst
+template <typename T>
+static T *gather(const std::vector<T> &src, const uint32_t *order, T *dst) {
+    for (size_t i = 0; i < src.size(); i++) {
+        dst[i] = src[order[i]];
+    }
+    return dst;
+}
+
+void SpriteBuffer::upload(uint32_t frameIndex) {
+    uint32_t count = getSpriteCount();
+    if (count == 0) return;
+    VkDeviceSize size = (VkDeviceSize) count * 4 * sizeof(SpriteVertex);
+
+    // 排序后相邻的同一混合方式、同一纹理、同一裁剪矩形合并为一个batch
+    bool reordered = drawList_.sort();
+    const uint64_t *keys = drawList_.getKeys();
+    batches_.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        if (i == 0 || !DrawList::isCompatible(keys[i - 1], keys[i])) {
+            uint32_t pipeline = DrawList::getKeyPipeline(keys[i]);
+            batches_.push_back(SpriteBatch{(BlendMode) (pipeline & ((1u << BLEND_MODE_BITS) - 1)),
+                                           DrawList::getKeyTexture(keys[i]), pipeline >> BLEND_MODE_BITS, i});
+        }
+    }
+    SpriteBatchSoA soa{xs_.data(), ys_.data(), ws_.data(), hs_.data(),
+                       u0s_.data(), v0s_.data(), u1s_.data(), v1s_.data(), colors_.data()};
+    if (reordered) {
+        // 重排后的数组只活到展开为止，从本帧的FrameArena中分配
+        const uint32_t *order = drawList_.getOrder();
+        soa.x_ = gather(xs_, order, frameArena_->allocArray<float>(frameIndex, count));
+        soa.y_ = gather(ys_, order, frameArena_->allocArray<float>(frameIndex, count));
+        soa.w_ = gather(ws_, order, frameArena_->allocArray<float>(frameIndex, count));
+        soa.h_ = gather(hs_, order, frameArena_->allocArray<float>(frameIndex, count));
+        soa.u0_ = gather(u0s_, order, frameArena_->allocArray<float>(frameIndex, count));
+        soa.v0_ = gather(v0s_, order, frameArena_->allocArray<float>(frameIndex, count));
+        soa.u1_ = gather(u1s_, order, frameArena_->allocArray<float>(frameIndex, count));
+        soa.v1_ = gather(v1s_, order, frameArena_->allocArray<float>(frameIndex, count));
+        soa.rgba_ = gather(colors_, order, frameArena_->allocArray<uint32_t>(frameIndex, count));
+    }
+
+    // 展开、变换与颜色打包一次完成，直接写入映射的内存
+    VulkanTransientAllocation allocation;
+    if (transientBuffer_->alloc(frameIndex, size, sizeof(float), &allocation)) {
+        expandSprites(soa, count, affineIdentity(), (SpriteVertex *) allocation.mapped_);
+        vertexBuffer_ = allocation.buffer_;
+        vertexOffset_ = allocation.offset_;
+    } else {
+        LOGW("transient buffer region %d is full, falling back to buffer manager", frameIndex);
+        VulkanBufferInfo bufferInfo = vertexBufferManager_->allocBuffer(frameIndex, size);
+        expandSprites(soa, count, affineIdentity(), (SpriteVertex *) bufferInfo.memory_.mapped_);
+        vertexBuffer_ = bufferInfo.buffer_;
+        vertexOffset_ = 0;
+    }
+
+    // 本帧的每张纹理一个descriptor set，一次分配、一次写入（参数数组的容量已预留，不超过纹理表的上限）
+    const uint32_t textureCount = textures_.size();
+    VkDescriptorSetAllocateInfo allocateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .descriptorPool = descriptorPools_[frameIndex],
+            .descriptorSetCount = textureCount,
+            .pSetLayouts = setLayouts_.data(),
+    };
+    descriptorSets_.resize(textureCount);
+    CALL_VK(vkAllocateDescriptorSets(device_, &allocateInfo, descriptorSets_.data()));
+    imageInfos_.resize(textureCount);
+    writes_.resize(textureCount);
+    for (uint32_t i = 0; i < textureCount; i++) {
+        imageInfos_[i] = VkDescriptorImageInfo{
+                .sampler = textures_[i].sampler_,
+                .imageView = textures_[i].view_,
+                .imageLayout = textures_[i].layout_,
+        };
+        writes_[i] = VkWriteDescriptorSet{
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext = nullptr,
+                .dstSet = descriptorSets_[i],
+                .dstBinding = 0,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .pImageInfo = &imageInfos_[i],
+                .pBufferInfo = nullptr,
+                .pTexelBufferView = nullptr,
+        };
+    }
+    vkUpdateDescriptorSets(device_, textureCount, writes_.data(), 0, nullptr);
+}
+
+void SpriteBuffer::record(VkCommandBuffer cmdBuffer, const VulkanPipelineInfo pipelines[BLEND_MODE_COUNT],
+                          const float projection[16], VkExtent2D displaySize, uint32_t begin, uint32_t end,
+                          GpuProfiler *profiler) {
+    if (begin >= end || !quadIndexBuffer_->isReady()) return;
+
+    vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vertexBuffer_, &vertexOffset_);
+
+    // 每个与[begin, end)相交的batch按需切换管线与纹理，再以共享的四边形索引一次画出其中的精灵
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    VkDescriptorSet boundSet = VK_NULL_HANDLE;
+    uint32_t boundClip = 0; // 调用者设置的scissor为整个图像
+    for (size_t i = 0; i < batches_.size(); i++) {
+        uint32_t batchBegin = std::max(batches_[i].begin_, begin);
+        uint32_t batchEnd = std::min(i + 1 < batches_.size() ? batches_[i + 1].begin_ : getSpriteCount(), end);
+        if (batchBegin >= batchEnd) continue;
+
+        const VulkanPipelineInfo &pipelineInfo = pipelines[batches_[i].blendMode_];
+        if (pipelineInfo.pipeline_ == VK_NULL_HANDLE) continue;
+        if (pipelineInfo.pipeline_ != boundPipeline) {
+            vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineInfo.pipeline_);
+            vkCmdPushConstants(cmdBuffer, pipelineInfo.layout_, VK_SHADER_STAGE_VERTEX_BIT,
+                               0, 16 * sizeof(float), projection);
+            boundPipeline = pipelineInfo.pipeline_;
+            boundSet = VK_NULL_HANDLE; // 各混合方式的管线布局各自创建，切换管线后重新绑定
+        }
+        VkDescriptorSet descriptorSet = descriptorSets_[batches_[i].texture_];
+        if (descriptorSet != boundSet) {
+            vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineInfo.layout_,
+                                    0, 1, &descriptorSet, 0, nullptr);
+            boundSet = descriptorSet;
+        }
+        if (batches_[i].clip_ != boundClip) {
+            clipRects_.setScissor(cmdBuffer, batches_[i].clip_, projection, displaySize);
+            boundClip = batches_[i].clip_;
+        }
+        uint32_t scope = profiler ? profiler->beginScope(cmdBuffer, BATCH_SCOPE_NAMES[batches_[i].blendMode_])
+                                  : GPU_PROFILER_INVALID_SCOPE;
+        quadIndexBuffer_->draw(cmdBuffer, batchBegin, batchEnd - batchBegin);
+        if (profiler) profiler->endScope(cmdBuffer, scope);
+    }
+    if (boundClip != 0) clipRects_.setScissor(cmdBuffer, 0, projection, displaySize);
+}
+
+void SpriteBuffer::clear() {
+    xs_.clear();
+    ys_.clear();
+    ws_.clear();
+    hs_.clear();
+    u0s_.clear();
+    v0s_.clear();
+    u1s_.clear();
+    v1s_.clear();
+    colors_.clear();
+    drawList_.clear();
+    batches_.clear();
+    textures_.clear();
+    // 纹理表的索引整体作废；generation回绕到0时才逐项清空一次
+    if (++textureGeneration_ == 0) {
+        textureSlots_.assign(TEXTURE_SLOT_COUNT, TextureSlot{VK_NULL_HANDLE, 0, 0});
+        textureGeneration_ = 1;
+    }
+    descriptorSets_.clear();
+    blendMode_ = BLEND_MODE_ALPHA;
+    layer_ = 0;
+    blendModeMask_ = 0;
+    clipRects_.clear();
+    skippedCount_ = 0;
+    culledCount_ = 0;
+}
@@ -0,0 +1,138 @@
+//
+// Created by richardwu on 11/14/24.
+//
+
+#ifndef PRF_SPRITE_BUFFER_H
+#define PRF_SPRITE_BUFFER_H
+
+#include "../../vulkan/utils.h"
+#include "../utils.h"
+#include "../BufferManager.h"
+#include "../RingBuffer.h"
+#include "../GpuProfiler.h"
+#include "../QuadIndexBuffer.h"
+#include "../TextureManager.h"
+#include "../TextureAtlas.h"
+#include "../geometry_kernels.h"
+#include "../DrawList.h"
+#include "../SpatialGrid.h"
+#include "../ClipRectTable.h"
+#include "../FrameArena.h"
+
+#include <vector>
+
+// 排序后连续使用同一混合方式、同一纹理、同一裁剪矩形的一段精灵
+struct SpriteBatch {
+    BlendMode blendMode_;
+    uint32_t texture_; // 本帧纹理表中的下标
+    uint32_t clip_; // 本帧裁剪矩形表中的下标，0为不裁剪
+    uint32_t begin_; // 第一个精灵的下标，到下一个batch的begin_为止
+};
+
+/*
+ * 带纹理的精灵绘制
+ * drawTexture()（整张纹理）与drawSprite()（图集中的一块）向各属性的数组（SoA）追加一项，
+ * 并以layer、混合方式与纹理（图集的页）为键提交到DrawList，同一页上的精灵可以合并为一次绘制；
+ * 纹理尚未就绪（解码或上传中）的精灵、完全在视口（与裁剪矩形的交集）之外的精灵直接丢弃
+ * 裁剪矩形与RectBuffer一样记入本帧的裁剪矩形表，纹理编号已占用键中的纹理位，其下标放在管线编号的高位
+ * （低2位为混合方式），排序时不同裁剪矩形的精灵不合并；录制时每个batch以vkCmdSetScissor裁剪
+ * 每帧upload()一次：排序后以expandSprites()把每个精灵展开为4个顶点写入环形缓冲，
+ * 并为本帧用到的每张纹理分配一个descriptor set（每个在途帧一个descriptor pool，随该帧的fence整体重置）；
+ * 之后同一混合方式、同一纹理的连续精灵以共享的四边形索引（QuadIndexBuffer::draw()）一次画出
+ */
+class SpriteBuffer
+{
+public:
+    SpriteBuffer(VkDevice device, QuadIndexBuffer *quadIndexBuffer, TextureAtlas *textureAtlas,
+                 RingBuffer *transientBuffer, BufferManager *vertexBufferManager, FrameArena *frameArena,
+                 uint32_t framesInFlight);
+    ~SpriteBuffer(); // 调用者保证设备已空闲，且使用getSetLayout()的管线已销毁
+
+    VkDescriptorSetLayout getSetLayout(); // 精灵管线的set 0：一个combined image sampler
+
+    void beginFrame(uint32_t frameIndex); // 该帧的fence已signal，重置其descriptor pool
+    void setBlendMode(BlendMode blendMode); // 之后的绘制使用该混合方式，每帧开始时为BLEND_MODE_ALPHA
+    void setLayer(uint32_t layer); // 之后的绘制所在的层（0~255，小的先画），每帧开始时为0
+    void setViewport(float width, float height); // 本帧绘制区域的尺寸（逻辑像素），每帧开始时设置
+    void setClipRect(const SpatialRect &clipRect); // 之后的绘制裁剪到该矩形之内（逻辑像素），完全在外的被丢弃
+    void resetClipRect(); // 之后的绘制不裁剪，每帧开始时不裁剪
+    void getCullRect(SpatialRect *cullRect); // 视口与裁剪矩形的交集
+    // 以整张纹理画一个精灵，颜色与纹理相乘；w、h为负时镜像
+    void drawTexture(const TextureHandle &texture, float x, float y, float w, float h, uint32_t rgba = 0xFFFFFFFF);
+    // 以图集中的一个精灵画一个精灵（同时标记其为本帧使用），复制尚未完成的被跳过
+    void drawSprite(const AtlasSpriteHandle &sprite, float x, float y, float w, float h, uint32_t rgba = 0xFFFFFFFF);
+    uint32_t getSpriteCount();
+    uint32_t getSkippedCount(); // 本帧因纹理未就绪或纹理表已满被跳过的精灵数
+    uint32_t getCulledCount(); // 本帧因在视口（与裁剪矩形的交集）之外被丢弃的精灵数
+    uint32_t getBlendModeMask(); // 本帧用到的混合方式，第i位对应BlendMode i
+    uint32_t getBatchCount(); // 排序合并后的batch数，upload()之后可用
+
+    // 排序本帧的精灵，将顶点写入环形缓冲（已满时回退到vertexBufferManager），并写好各纹理的descriptor set
+    void upload(uint32_t frameIndex);
+    // 录制排序后的精灵[begin, end)，可在多个线程的secondary command buffer中同时调用
+    // pipelines按BlendMode索引，pipeline_为VK_NULL_HANDLE的batch会被跳过；共享的索引尚未复制到显存时整帧跳过
+    // 调用前scissor应为整个displaySize，有裁剪的batch经projection设置scissor，返回前恢复
+    // profiler不为空时每个batch的绘制计一个GPU区间（只用于录制线程上的primary指令缓冲）
+    void record(VkCommandBuffer cmdBuffer, const VulkanPipelineInfo pipelines[BLEND_MODE_COUNT],
+                const float projection[16], VkExtent2D displaySize, uint32_t begin, uint32_t end,
+                GpuProfiler *profiler = nullptr);
+    void clear(); // 清空本帧的精灵与纹理表，开始下一帧
+
+private:
+    // 本帧纹理表中的一项，对应一个descriptor set
+    struct SpriteTexture {
+        VkImageView view_;
+        VkSampler sampler_;
+        VkImageLayout layout_;
+    };
+
+    // 纹理表的索引：以VkImageView为键的开放寻址哈希表（线性探测），容量固定为纹理表上限的2倍
+    // generation_不等于textureGeneration_的表项为空，clear()只递增textureGeneration_，不逐项清空、不释放
+    struct TextureSlot {
+        VkImageView view_;
+        uint32_t generation_;
+        uint32_t index_; // textures_中的下标
+    };
+
+    VkDevice device_;
+    QuadIndexBuffer *quadIndexBuffer_;
+    TextureAtlas *textureAtlas_;
+    RingBuffer *transientBuffer_;
+    BufferManager *vertexBufferManager_;
+    FrameArena *frameArena_; // upload()中排序后的临时数组
+
+    VkDescriptorSetLayout setLayout_;
+    std::vector<VkDescriptorPool> descriptorPools_; // 每个在途帧一个
+
+    // 精灵的属性按属性分开存放，upload()时展开为SpriteVertex
+    std::vector<float> xs_, ys_, ws_, hs_;
+    std::vector<float> u0s_, v0s_, u1s_, v1s_;
+    std::vector<uint32_t> colors_; // 0xRRGGBBAA
+    DrawList drawList_;
+    std::vector<SpriteBatch> batches_; // upload()中由排序后的键生成，按begin_递增
+    std::vector<SpriteTexture> textures_; // 本帧用到的纹理，下标即DrawList中的纹理编号
+    std::vector<TextureSlot> textureSlots_;
+    uint32_t textureGeneration_;
+    std::vector<VkDescriptorSet> descriptorSets_; // 与textures_一一对应，upload()中分配
+    // upload()中分配、写入descriptor set的参数，容量按纹理表的上限预留，每帧不再分配
+    std::vector<VkDescriptorSetLayout> setLayouts_; // 都是setLayout_
+    std::vector<VkDescriptorImageInfo> imageInfos_;
+    std::vector<VkWriteDescriptorSet> writes_;
+    BlendMode blendMode_;
+    uint32_t layer_;
+    uint32_t blendModeMask_;
+    ClipRectTable clipRects_;
+    uint32_t skippedCount_;
+    uint32_t culledCount_;
+
+    // 本帧顶点数据的位置
+    VkBuffer vertexBuffer_;
+    VkDeviceSize vertexOffset_;
+
+    // 取得纹理在本帧纹理表中的下标，纹理表已满时返回false
+    bool getTextureIndex(VkImageView view, VkSampler sampler, VkImageLayout layout, uint32_t *index);
+    void addSprite(uint32_t texture, float x, float y, float w, float h, float u0, float v0, float u1, float v1,
+                   uint32_t rgba);
+};
+
+#endif //PRF_SPRITE_BUFFER_H
@@ -0,0 +1,54 @@
+//
+// Created by richardwu on 11/14/24.
+//
+
+#ifndef PRF_SPRITE_PIPELINE_H
+#define PRF_SPRITE_PIPELINE_H
+
+#include "../../vulkan/utils.h"
+#include "../utils.h"
+#include "sprite_buffer.h"
+
+#include <cstddef>
+
+// 精灵管线的描述：binding 0为展开后的顶点（逐顶点），set 0为采样的纹理（SpriteBuffer::getSetLayout()）
+static VulkanPipelineDesc getSpritePipelineDesc(VkRenderPass renderPass, VkDescriptorSetLayout setLayout,
+                                                BlendMode blendMode = BLEND_MODE_ALPHA) {
+    VulkanPipelineDesc desc;
+    desc.vertexShader_ = "shaders/sprite.vert.spv";
+    desc.fragmentShader_ = "shaders/sprite.frag.spv";
+    desc.bindings_ = {
+            {
+                    .binding = 0,
+                    .stride = sizeof(SpriteVertex),
+                    .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+            }};
+    desc.attributes_ = {
+            {
+                    .location = 0,
+                    .binding = 0,
+                    .format = VK_FORMAT_R32G32_SFLOAT, // 像素坐标
+                    .offset = offsetof(SpriteVertex, x_),
+            },
+            {
+                    .location = 1,
+                    .binding = 0,
+                    .format = VK_FORMAT_R32G32_SFLOAT, // 纹理坐标
+                    .offset = offsetof(SpriteVertex, u_),
+            },
+            {
+                    .location = 2,
+                    .binding = 0,
+                    .format = VK_FORMAT_R8G8B8A8_UNORM, // 颜色
+                    .offset = offsetof(SpriteVertex, color_),
+            }};
+    desc.pushConstantSize_ = 16 * sizeof(float); // mat4 projection
+    desc.setLayout_ = setLayout;
+    desc.blendMode_ = blendMode;
+    desc.topology_ = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    desc.sampleCount_ = VK_SAMPLE_COUNT_1_BIT;
+    desc.renderPass_ = renderPass;
+    return desc;
+}
+
+#endif //PRF_SPRITE_PIPELINE_H
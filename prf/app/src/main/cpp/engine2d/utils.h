@@ -7,10 +7,35 @@
 
 #include <vulkan_wrapper.h>
 
+#include <vector>
+
 // 渲染管线信息
 struct VulkanPipelineInfo {
     VkPipelineLayout layout_;
     VkPipeline pipeline_;
 };
 
+// 颜色混合方式
+enum BlendMode {
+    BLEND_MODE_OPAQUE = 0, // 不混合，直接覆盖
+    BLEND_MODE_ALPHA, // src * a + dst * (1 - a)
+    BLEND_MODE_ADDITIVE, // src * a + dst
+    BLEND_MODE_MULTIPLY, // src * dst
+    BLEND_MODE_COUNT,
+};
+
+// 创建渲染管线所需的描述，同时也是PipelineRegistry中哈希的内容
+struct VulkanPipelineDesc {
+    const char *vertexShader_; // assets中SPIR-V文件的路径
+    const char *fragmentShader_;
+    std::vector<VkVertexInputBindingDescription> bindings_; // 顶点输入布局
+    std::vector<VkVertexInputAttributeDescription> attributes_;
+    uint32_t pushConstantSize_; // 顶点着色器push constant的大小，0表示不使用
+    VkDescriptorSetLayout setLayout_; // set 0的布局（如纹理），VK_NULL_HANDLE表示不使用；由调用者创建，晚于管线销毁
+    BlendMode blendMode_;
+    VkPrimitiveTopology topology_;
+    VkSampleCountFlagBits sampleCount_;
+    VkRenderPass renderPass_;
+};
+
 #endif //PRF_ENGINE2D_UTILS_H
@@ -5,15 +5,27 @@
 #ifndef PRF_LOG_H
 #define PRF_LOG_H
 
+#define KTAG "prf-android"
+
+#ifdef __ANDROID__
 #include <android/log.h>
 
 // Android log function wrappers
-#define KTAG "prf-android"
 #define LOGI(...) \
   ((void)__android_log_print(ANDROID_LOG_INFO, KTAG, __VA_ARGS__))
 #define LOGW(...) \
   ((void)__android_log_print(ANDROID_LOG_WARN, KTAG, __VA_ARGS__))
 #define LOGE(...) \
   ((void)__android_log_print(ANDROID_LOG_ERROR, KTAG, __VA_ARGS__))
+#else
+#include <cstdio>
+
+// headless（Linux）下输出到stderr
+#define PRF_LOG(level, ...) \
+  ((void)(fprintf(stderr, "%s %s: ", level, KTAG), fprintf(stderr, __VA_ARGS__), fputc('\n', stderr)))
+#define LOGI(...) PRF_LOG("I", __VA_ARGS__)
+#define LOGW(...) PRF_LOG("W", __VA_ARGS__)
+#define LOGE(...) PRF_LOG("E", __VA_ARGS__)
+#endif
 
 #endif //PRF_LOG_H
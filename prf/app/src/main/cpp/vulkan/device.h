@@ -11,11 +11,16 @@
 
 #include <vector>
 
-VkDevice getDevice(VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex) {
+// headless为true时渲染到离屏图像，不需要交换链扩展
+// transferQueueFamilyIndex与queueFamilyIndex不同时，额外创建一个传输队列
+VkDevice getDevice(VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex, uint32_t transferQueueFamilyIndex,
+                   bool headless = false) {
 
     // 所需设备扩展
     std::vector<const char *> device_extensions;
-    device_extensions.push_back("VK_KHR_swapchain");
+    if (!headless) {
+        device_extensions.push_back("VK_KHR_swapchain");
+    }
 
     LOGI("device extensions needed:");
     for (const auto &extension: device_extensions) {
@@ -24,20 +29,32 @@ VkDevice getDevice(VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex) {
 
     // Create a logical device (vulkan device)
     float priorities = 1.0f;
-    VkDeviceQueueCreateInfo queueCreateInfo{
+    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+    queueCreateInfos.push_back(VkDeviceQueueCreateInfo{
             .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
             .pNext = nullptr,
             .flags = 0,
             .queueFamilyIndex = queueFamilyIndex,
             .queueCount = 1, // 针对一个队列族我们所需的队列数量
             .pQueuePriorities = &priorities, // 必须显示地赋予队列优先级
-    };
+    });
+    // 同一个队列族不能出现在两个VkDeviceQueueCreateInfo中
+    if (transferQueueFamilyIndex != queueFamilyIndex) {
+        queueCreateInfos.push_back(VkDeviceQueueCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .queueFamilyIndex = transferQueueFamilyIndex,
+                .queueCount = 1,
+                .pQueuePriorities = &priorities,
+        });
+    }
 
     VkDeviceCreateInfo deviceCreateInfo{
             .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
             .pNext = nullptr,
-            .queueCreateInfoCount = 1,
-            .pQueueCreateInfos = &queueCreateInfo,
+            .queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size()),
+            .pQueueCreateInfos = queueCreateInfos.data(),
             .enabledLayerCount = 0,
             .ppEnabledLayerNames = nullptr,
             .enabledExtensionCount = static_cast<uint32_t>(device_extensions.size()),
@@ -11,7 +11,8 @@
 
 #include <vector>
 
-VkInstance getInstance() {
+// headless为true时不需要窗口系统，不开启surface相关的扩展
+VkInstance getInstance(bool headless = false) {
 
     // 应用信息
     VkApplicationInfo appInfo = {
@@ -26,8 +27,10 @@ VkInstance getInstance() {
 
     // 所需扩展
     std::vector<const char *> instance_extensions; // 实例扩展
-    instance_extensions.push_back("VK_KHR_surface");
-    instance_extensions.push_back("VK_KHR_android_surface");
+    if (!headless) {
+        instance_extensions.push_back("VK_KHR_surface");
+        instance_extensions.push_back("VK_KHR_android_surface");
+    }
 
     LOGI("instance extensions needed:");
     for (const auto &extension: instance_extensions) {
@@ -0,0 +1,129 @@
+//
+// Created by richardwu on 11/5/24.
+//
+
+#ifndef PRF_OFFSCREEN_H
+#define PRF_OFFSCREEN_H
+
+#include <vulkan_wrapper.h>
+#include "utils.h"
+#include "../log.h"
+
+// 创建imageCount个离屏的颜色图像及其imageView、FrameBuffer，代替交换链图像
+// 图像可作为TRANSFER_SRC，渲染结果可以拷贝回CPU
+void getOffscreenTargets(VkPhysicalDevice physicalDevice, VkDevice device, VkRenderPass renderPass,
+                         VkFormat format, VkExtent2D extent, uint32_t imageCount,
+                         VulkanOffscreenInfo *offscreen) {
+    offscreen->imageCount_ = imageCount;
+    offscreen->displaySize_ = extent;
+    offscreen->displayFormat_ = format;
+    offscreen->images_.resize(imageCount);
+    offscreen->memories_.resize(imageCount);
+    offscreen->views_.resize(imageCount);
+    offscreen->framebuffers_.resize(imageCount);
+
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+    for (uint32_t i = 0; i < imageCount; i++) {
+        VkImageCreateInfo imageCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .imageType = VK_IMAGE_TYPE_2D,
+                .format = format,
+                .extent = {.width = extent.width, .height = extent.height, .depth = 1},
+                .mipLevels = 1,
+                .arrayLayers = 1,
+                .samples = VK_SAMPLE_COUNT_1_BIT,
+                .tiling = VK_IMAGE_TILING_OPTIMAL,
+                .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                .queueFamilyIndexCount = 0,
+                .pQueueFamilyIndices = nullptr,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+        CALL_VK(vkCreateImage(device, &imageCreateInfo, nullptr, &offscreen->images_[i]));
+
+        // 优先DEVICE_LOCAL，没有的话（部分CPU实现）退而使用任意可用的类型
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(device, offscreen->images_[i], &requirements);
+        uint32_t memoryTypeIndex = memoryProperties.memoryTypeCount;
+        for (uint32_t type = 0; type < memoryProperties.memoryTypeCount; type++) {
+            if (!(requirements.memoryTypeBits & (1u << type))) continue;
+            if (memoryTypeIndex == memoryProperties.memoryTypeCount) memoryTypeIndex = type;
+            if (memoryProperties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
+                memoryTypeIndex = type;
+                break;
+            }
+        }
+        assert(memoryTypeIndex < memoryProperties.memoryTypeCount);
+
+        VkMemoryAllocateInfo allocInfo{
+                .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+                .pNext = nullptr,
+                .allocationSize = requirements.size,
+                .memoryTypeIndex = memoryTypeIndex,
+        };
+        CALL_VK(vkAllocateMemory(device, &allocInfo, nullptr, &offscreen->memories_[i]));
+        CALL_VK(vkBindImageMemory(device, offscreen->images_[i], offscreen->memories_[i], 0));
+
+        VkImageViewCreateInfo viewCreateInfo = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .image = offscreen->images_[i],
+                .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                .format = format,
+                .components =
+                        {
+                                .r = VK_COMPONENT_SWIZZLE_R,
+                                .g = VK_COMPONENT_SWIZZLE_G,
+                                .b = VK_COMPONENT_SWIZZLE_B,
+                                .a = VK_COMPONENT_SWIZZLE_A,
+                        },
+                .subresourceRange =
+                        {
+                                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                                .baseMipLevel = 0,
+                                .levelCount = 1,
+                                .baseArrayLayer = 0,
+                                .layerCount = 1,
+                        },
+        };
+        CALL_VK(vkCreateImageView(device, &viewCreateInfo, nullptr, &offscreen->views_[i]));
+
+        VkFramebufferCreateInfo fbCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+                .pNext = nullptr,
+                .renderPass = renderPass,
+                .attachmentCount = 1,
+                .pAttachments = &offscreen->views_[i],
+                .width = extent.width,
+                .height = extent.height,
+                .layers = 1,
+        };
+        CALL_VK(vkCreateFramebuffer(device, &fbCreateInfo, nullptr, &offscreen->framebuffers_[i]));
+    }
+
+    LOGI("offscreen targets:");
+    LOGI("\tformat: %d", format);
+    LOGI("\textent: w=%d, h=%d", extent.width, extent.height);
+    LOGI("\timageCount: %d", imageCount);
+}
+
+void DeleteOffscreenTargets(VkDevice device, VulkanOffscreenInfo *offscreen) {
+    for (uint32_t i = 0; i < offscreen->imageCount_; i++) {
+        vkDestroyFramebuffer(device, offscreen->framebuffers_[i], nullptr);
+        vkDestroyImageView(device, offscreen->views_[i], nullptr);
+        vkDestroyImage(device, offscreen->images_[i], nullptr);
+        vkFreeMemory(device, offscreen->memories_[i], nullptr);
+    }
+    offscreen->images_.clear();
+    offscreen->memories_.clear();
+    offscreen->views_.clear();
+    offscreen->framebuffers_.clear();
+    offscreen->imageCount_ = 0;
+}
+
+#endif //PRF_OFFSCREEN_H
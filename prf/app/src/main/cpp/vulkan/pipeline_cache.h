@@ -7,14 +7,59 @@
 
 #include <vulkan_wrapper.h>
 #include "utils.h"
+#include "../log.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// 校验磁盘上的cache数据是否由同一设备、同一驱动产生，否则驱动可能拒绝或错误地使用它
+static bool isPipelineCacheCompatible(VkPhysicalDevice physicalDevice, const std::vector<char> &data) {
+    VkPipelineCacheHeaderVersionOne header;
+    if (data.size() < sizeof(header)) return false;
+    memcpy(&header, data.data(), sizeof(header));
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    if (header.headerSize < sizeof(header) || header.headerSize > data.size()) return false;
+    if (header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) return false;
+    if (header.vendorID != properties.vendorID || header.deviceID != properties.deviceID) return false;
+    if (memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) return false;
+    return true;
+}
+
+// 创建管线缓存，若cachePath处有兼容的数据则以其作为初始数据
+// initialDataSize不为空时返回采用的初始数据的字节数（没有或不兼容时为0）
+VkPipelineCache getPipelineCache(VkDevice device, VkPhysicalDevice physicalDevice, const std::string &cachePath,
+                                 size_t *initialDataSize = nullptr) {
+    std::vector<char> data;
+    FILE *file = fopen(cachePath.c_str(), "rb");
+    if (file) {
+        fseek(file, 0, SEEK_END);
+        long fileLength = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        if (fileLength > 0) {
+            data.resize(fileLength);
+            if (fread(data.data(), 1, fileLength, file) != (size_t) fileLength) data.clear();
+        }
+        fclose(file);
+    }
+
+    if (!data.empty() && !isPipelineCacheCompatible(physicalDevice, data)) {
+        LOGW("pipeline cache: %s is stale or from another device, ignored", cachePath.c_str());
+        data.clear();
+    }
+    LOGI("pipeline cache: initial data %d bytes", (int) data.size());
+    if (initialDataSize) *initialDataSize = data.size();
 
-VkPipelineCache getPipelineCache(VkDevice device) {
     VkPipelineCacheCreateInfo pipelineCacheInfo{
             .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
             .pNext = nullptr,
             .flags = 0,  // reserved, must be 0
-            .initialDataSize = 0,
-            .pInitialData = nullptr,
+            .initialDataSize = data.size(),
+            .pInitialData = data.empty() ? nullptr : data.data(),
     };
 
     VkPipelineCache pipelineCache;
@@ -23,4 +68,30 @@ VkPipelineCache getPipelineCache(VkDevice device) {
     return pipelineCache;
 }
 
+// 将管线缓存写入cachePath，返回写入的字节数（失败返回0）
+// 先写临时文件再rename，进程中途被杀也不会留下写了一半的文件
+size_t savePipelineCache(VkDevice device, VkPipelineCache pipelineCache, const std::string &cachePath) {
+    size_t dataSize = 0;
+    CALL_VK(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr));
+    if (dataSize == 0) return 0;
+    std::vector<char> data(dataSize);
+    CALL_VK(vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()));
+
+    std::string tmpPath = cachePath + ".tmp";
+    FILE *file = fopen(tmpPath.c_str(), "wb");
+    if (!file) {
+        LOGW("pipeline cache: cannot open %s", tmpPath.c_str());
+        return 0;
+    }
+    bool written = fwrite(data.data(), 1, dataSize, file) == dataSize;
+    written = (fclose(file) == 0) && written;
+    if (!written || rename(tmpPath.c_str(), cachePath.c_str()) != 0) {
+        LOGW("pipeline cache: failed to write %s", cachePath.c_str());
+        remove(tmpPath.c_str());
+        return 0;
+    }
+    LOGI("pipeline cache: saved %d bytes", (int) dataSize);
+    return dataSize;
+}
+
 #endif //PRF_PIPELINE_CACHE_H
@@ -8,7 +8,9 @@
 #include <vulkan_wrapper.h>
 #include "utils.h"
 
-VkRenderPass getRenderPass(VkDevice device, VkFormat format) {
+// finalLayout：交换链图像为PRESENT_SRC_KHR，离屏图像为TRANSFER_SRC_OPTIMAL（之后可以拷贝出来）
+VkRenderPass getRenderPass(VkDevice device, VkFormat format,
+                           VkImageLayout finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) {
     VkAttachmentDescription attachmentDescriptions{
             .format = format,
             .samples = VK_SAMPLE_COUNT_1_BIT, // 采样数
@@ -18,7 +20,7 @@ VkRenderPass getRenderPass(VkDevice device, VkFormat format) {
             .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
             .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
             .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED, // 不关心之前的图像，因为会清除
-            .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, // 渲染之后的图像会被交换链呈现
+            .finalLayout = finalLayout, // 渲染之后的图像会被交换链呈现（或被拷贝）
     };
 
     VkAttachmentReference colorReference = {
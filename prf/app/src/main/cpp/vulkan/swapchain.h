@@ -12,13 +12,17 @@
 #include <vector>
 
 // 创建交换链
+// 重建时oldSwapchain为旧的交换链，驱动可以复用其资源；调用者在之后负责销毁旧交换链
 void getSwapChain(VkSurfaceKHR surface,
                      VkPhysicalDevice physicalDevice,
                      uint32_t queueFamilyIndex,
                      VkDevice device,
+                     VkSwapchainKHR oldSwapchain,
                      VulkanSwapchainInfo *swapchain) {
 
-    memset(swapchain, 0, sizeof(VulkanSwapchainInfo));
+    // 重建时swapchain中的framebuffer等由调用者先行销毁
+    swapchain->swapchain_ = VK_NULL_HANDLE;
+    swapchain->swapchainLength_ = 0;
 
     // **********************************************************
     // Get the surface capabilities because:
@@ -43,7 +47,16 @@ void getSwapChain(VkSurfaceKHR surface,
     }
     assert(chosenFormat < formatCount);
 
+    // 预旋转：按currentTransform创建交换链，由应用在投影中旋转，省去合成器的一次旋转
+    // currentExtent是旋转后的尺寸，90/270度时交换宽高得到自然方向的尺寸
+    swapchain->pretransform_ = surfaceCapabilities.currentTransform;
+    swapchain->logicalSize_ = surfaceCapabilities.currentExtent;
     swapchain->displaySize_ = surfaceCapabilities.currentExtent;
+    if (surfaceCapabilities.currentTransform & (VK_SURFACE_TRANSFORM_ROTATE_90_BIT_KHR |
+                                                VK_SURFACE_TRANSFORM_ROTATE_270_BIT_KHR)) {
+        swapchain->displaySize_.width = surfaceCapabilities.currentExtent.height;
+        swapchain->displaySize_.height = surfaceCapabilities.currentExtent.width;
+    }
     swapchain->displayFormat_ = formats[chosenFormat].format;
 
     VkSurfaceCapabilitiesKHR surfaceCap;
@@ -61,17 +74,17 @@ void getSwapChain(VkSurfaceKHR surface,
             .minImageCount = surfaceCapabilities.minImageCount,
             .imageFormat = formats[chosenFormat].format,
             .imageColorSpace = formats[chosenFormat].colorSpace,
-            .imageExtent = surfaceCapabilities.currentExtent,
+            .imageExtent = swapchain->displaySize_,
             .imageArrayLayers = 1, // 每个图像所包含的层次，非VR都是1
             .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, // 对图像做什么操作：附上颜色。其他的还有后期处理等
             .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE, // 一张图像同时只能被一个队列族所有，必须要显示改变所有权，性能最佳
             .queueFamilyIndexCount = 1,
             .pQueueFamilyIndices = &queueFamilyIndex,
-            .preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
+            .preTransform = swapchain->pretransform_,
             .compositeAlpha = VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR,
             .presentMode = VK_PRESENT_MODE_FIFO_KHR,
             .clipped = VK_FALSE,
-            .oldSwapchain = VK_NULL_HANDLE,
+            .oldSwapchain = oldSwapchain,
     };
     CALL_VK(vkCreateSwapchainKHR(device, &swapchainCreateInfo, nullptr,
                                  &swapchain->swapchain_));
@@ -85,14 +98,23 @@ void getSwapChain(VkSurfaceKHR surface,
     LOGI("\tformat: %d, %d", formats[chosenFormat].format, formats[chosenFormat].colorSpace);
     LOGI("\tmode: VK_PRESENT_MODE_FIFO_KHR");
     LOGI("\textent: w=%d, h=%d", swapchain->displaySize_.width, swapchain->displaySize_.height);
+    LOGI("\tpretransform: %d", swapchain->pretransform_);
     LOGI("\timageCount: %d", swapchain->swapchainLength_);
 }
 
-void DeleteSwapChain(VkDevice device, VulkanSwapchainInfo *swapchain) {
+// 销毁framebuffer与imageView，保留交换链本身（重建时作为oldSwapchain）
+void DeleteSwapChainFrameBuffers(VkDevice device, VulkanSwapchainInfo *swapchain) {
     for (int i = 0; i < swapchain->swapchainLength_; i++) {
         vkDestroyFramebuffer(device, swapchain->framebuffers_[i], nullptr);
         vkDestroyImageView(device, swapchain->displayViews_[i], nullptr);
     }
+    swapchain->framebuffers_.clear();
+    swapchain->displayViews_.clear();
+    swapchain->displayImages_.clear();
+}
+
+void DeleteSwapChain(VkDevice device, VulkanSwapchainInfo *swapchain) {
+    DeleteSwapChainFrameBuffers(device, swapchain);
     vkDestroySwapchainKHR(device, swapchain->swapchain_, nullptr);
 }
 
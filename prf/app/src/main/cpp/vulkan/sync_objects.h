@@ -8,24 +8,56 @@
 #include <vulkan_wrapper.h>
 #include "utils.h"
 
-void getImageAvailableSemaphore(VkDevice device, VulkanRenderInfo *render) {
+// 每个在途帧一个：获取交换链图像完成后signal，提交时等待
+void getImageAvailableSemaphores(VkDevice device, VulkanRenderInfo *render) {
     VkSemaphoreCreateInfo semaphoreCreateInfo{
             .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
             .pNext = nullptr,
             .flags = 0,
     };
-    CALL_VK(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr,
-                              &render->imageAvailableSemaphore_));
+    render->imageAvailableSemaphores_.resize(render->framesInFlight_);
+    for (uint32_t i = 0; i < render->framesInFlight_; i++) {
+        CALL_VK(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr,
+                                  &render->imageAvailableSemaphores_[i]));
+    }
 }
 
-void getRenderFinishedFence(VkDevice device, VulkanRenderInfo *render) {
+// 每个在途帧一个：渲染完成后signal，呈现时等待（呈现不再需要CPU等待fence）
+void getRenderFinishedSemaphores(VkDevice device, VulkanRenderInfo *render) {
+    VkSemaphoreCreateInfo semaphoreCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+    };
+    render->renderFinishedSemaphores_.resize(render->framesInFlight_);
+    for (uint32_t i = 0; i < render->framesInFlight_; i++) {
+        CALL_VK(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr,
+                                  &render->renderFinishedSemaphores_[i]));
+    }
+}
+
+// 每个在途帧一个：该帧的提交在GPU上执行完成后signal，CPU复用该帧的资源前等待
+void getInFlightFences(VkDevice device, VulkanRenderInfo *render) {
     VkFenceCreateInfo fenceCreateInfo{
             .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
             .pNext = nullptr,
-            .flags = 0,
+            .flags = VK_FENCE_CREATE_SIGNALED_BIT, // 初始为signal状态，第一次等待立即返回
     };
-    CALL_VK(vkCreateFence(device, &fenceCreateInfo, nullptr, &render->renderFinishedFence_));
+    render->inFlightFences_.resize(render->framesInFlight_);
+    for (uint32_t i = 0; i < render->framesInFlight_; i++) {
+        CALL_VK(vkCreateFence(device, &fenceCreateInfo, nullptr, &render->inFlightFences_[i]));
+    }
+}
 
+void DeleteSyncObjects(VkDevice device, VulkanRenderInfo *render) {
+    // headless后端没有交换链，只创建了fence，各自按实际数量销毁
+    for (auto semaphore: render->imageAvailableSemaphores_) vkDestroySemaphore(device, semaphore, nullptr);
+    for (auto semaphore: render->renderFinishedSemaphores_) vkDestroySemaphore(device, semaphore, nullptr);
+    for (auto fence: render->inFlightFences_) vkDestroyFence(device, fence, nullptr);
+    render->imageAvailableSemaphores_.clear();
+    render->renderFinishedSemaphores_.clear();
+    render->inFlightFences_.clear();
+    render->imagesInFlight_.clear();
 }
 
 #endif //PRF_SYNC_OBJECTS_H
@@ -14,9 +14,7 @@
 // Vulkan调用封装
 #define CALL_VK(func)                                                 \
   if (VK_SUCCESS != (func)) {                                         \
-    __android_log_print(ANDROID_LOG_ERROR,                            \
-                        "Vulkan error. File[%s], line[%d]", __FILE__, \
-                        __LINE__);                                    \
+    LOGE("Vulkan error. File[%s], line[%d]", __FILE__, __LINE__);     \
     assert(false);                                                    \
   }
 
@@ -28,9 +26,11 @@ struct VulkanDeviceInfo {
     VkPhysicalDevice physicalDevice_;
     VkDevice device_;
     uint32_t queueFamilyIndex_;
+    uint32_t transferQueueFamilyIndex_; // 没有独立的传输队列族时与queueFamilyIndex_相同
 
     VkSurfaceKHR surface_;
     VkQueue queue_;
+    VkQueue transferQueue_; // 没有独立的传输队列族时与queue_相同
 };
 
 // Vulkan交换链信息
@@ -38,7 +38,9 @@ struct VulkanSwapchainInfo {
     VkSwapchainKHR swapchain_;
     uint32_t swapchainLength_;
 
-    VkExtent2D displaySize_;
+    VkExtent2D displaySize_; // 交换链图像的尺寸（设备自然方向），framebuffer、viewport与scissor使用
+    VkExtent2D logicalSize_; // 用户看到的尺寸（已按pretransform_旋转），场景的像素坐标使用
+    VkSurfaceTransformFlagBitsKHR pretransform_; // 由应用在投影中完成的旋转，合成器不必再做一次
     VkFormat displayFormat_;
 
     // array of frame buffers and views
@@ -47,13 +49,33 @@ struct VulkanSwapchainInfo {
     std::vector<VkFramebuffer> framebuffers_;
 };
 
+// 离屏渲染目标信息（headless后端代替交换链）
+struct VulkanOffscreenInfo {
+    uint32_t imageCount_; // 与在途帧数相同，第i个在途帧总是渲染到第i个图像
+    VkExtent2D displaySize_;
+    VkFormat displayFormat_;
+
+    std::vector<VkImage> images_;
+    std::vector<VkDeviceMemory> memories_; // 每个图像独占一块内存（不与缓冲混在同一块中，避开bufferImageGranularity）
+    std::vector<VkImageView> views_;
+    std::vector<VkFramebuffer> framebuffers_;
+};
+
 // Vulkan RenderPass信息
 struct VulkanRenderInfo {
     VkRenderPass renderPass_;
     VkCommandPool cmdPool_;
-    std::vector<VkCommandBuffer> cmdBuffer_; // 每个帧缓冲有一个VkCommandBuffer（3或4）
-    VkSemaphore imageAvailableSemaphore_;
-    VkFence renderFinishedFence_;
+
+    uint32_t framesInFlight_; // 同时在途（CPU录制与GPU执行重叠）的帧数
+    uint32_t currentFrame_; // 当前帧在[0, framesInFlight_)中的编号
+
+    // 以下每个在途帧各有一份
+    std::vector<VkCommandBuffer> cmdBuffer_;
+    std::vector<VkSemaphore> imageAvailableSemaphores_;
+    std::vector<VkSemaphore> renderFinishedSemaphores_;
+    std::vector<VkFence> inFlightFences_;
+
+    std::vector<VkFence> imagesInFlight_; // 每个交换链图像正被哪个在途帧的fence占用（VK_NULL_HANDLE表示空闲）
     VkPipelineCache pipelineCache_;
 };
 
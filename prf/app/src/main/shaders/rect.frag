@@ -0,0 +1,8 @@
+#version 400
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+layout (location = 0) in vec4 vColor;
+layout (location = 0) out vec4 uFragColor;
+void main() {
+   uFragColor = vColor;
+}
@@ -0,0 +1,17 @@
+#version 400
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+// 共享的单位四边形，[0,1]x[0,1]
+layout (location = 0) in vec2 pos;
+// 每个实例（矩形）的属性
+layout (location = 1) in vec4 rect; // x, y, w, h（像素坐标）
+layout (location = 2) in vec4 color; // RGBA
+// 像素坐标到裁剪空间的变换
+layout (push_constant) uniform PushConstants {
+   mat4 projection;
+} pc;
+layout (location = 0) out vec4 vColor;
+void main() {
+   vColor = color;
+   gl_Position = pc.projection * vec4(rect.xy + pos * rect.zw, 0.0, 1.0);
+}
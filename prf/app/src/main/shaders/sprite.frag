@@ -0,0 +1,10 @@
+#version 400
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+layout (set = 0, binding = 0) uniform sampler2D tex;
+layout (location = 0) in vec2 vUv;
+layout (location = 1) in vec4 vColor;
+layout (location = 0) out vec4 uFragColor;
+void main() {
+   uFragColor = texture(tex, vUv) * vColor;
+}
@@ -0,0 +1,18 @@
+#version 400
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+// 每个精灵展开后的顶点
+layout (location = 0) in vec2 pos; // 像素坐标
+layout (location = 1) in vec2 uv; // 纹理坐标
+layout (location = 2) in vec4 color; // RGBA，与纹理颜色相乘
+// 像素坐标到裁剪空间的变换
+layout (push_constant) uniform PushConstants {
+   mat4 projection;
+} pc;
+layout (location = 0) out vec2 vUv;
+layout (location = 1) out vec4 vColor;
+void main() {
+   vUv = uv;
+   vColor = color;
+   gl_Position = pc.projection * vec4(pos, 0.0, 1.0);
+}